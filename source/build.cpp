@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "build.h"
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <unistd.h>
+#include "main.h"
+
+using Files = std::vector<std::pair<std::string, std::string>>;
+
+// The path a parsed file is known by
+static std::string parsedPath(AbstractSyntaxTree *tree) {
+    for (auto &[path, parsed]: parsed_files)
+        if (parsed == tree)
+            return path;
+
+    throw std::runtime_error("File of an import is not parsed");
+}
+
+// Parsing a file and everything it imports, like the interpreter would. The files are added in the order
+// they are parsed, with their sources, the imports with the files they resolved to.
+static void collectFiles(const std::string &path, bool isMain, Files &files, Files &imports) {
+    for (auto tree: parse_file(path, isMain)) {
+        auto parsed = parsedPath(tree);
+
+        if (!isMain)
+            imports.emplace_back(path.ends_with(".acl") ? path : path + ".acl", parsed);
+
+        auto known = std::any_of(files.begin(), files.end(), [&parsed](auto &file) { return file.first == parsed; });
+
+        if (known)
+            continue;
+
+        files.emplace_back(parsed, parsed_sources.at(parsed));
+
+        // Imports are only allowed at the top of a file
+        for (auto child: tree->children) {
+            auto import = dynamic_cast<ImportStatementNode *>(child);
+
+            if (import != nullptr)
+                collectFiles(import->path, false, files, imports);
+        }
+    }
+}
+
+// A C++ string literal with the text. Octal escapes always have three digits, so they can't run into
+// the next character.
+static std::string literal(const std::string &text) {
+    std::string result = "\"";
+
+    for (unsigned char c: text) {
+        if (c == '\n') {
+            // A line per line of the source, to keep the generated code readable
+            result += "\\n\"\n        \"";
+        } else if (c == '"' || c == '\\') {
+            result += '\\';
+            result += (char) c;
+        } else if (c >= 32 && c < 127 && c != '?') {
+            result += (char) c;
+        } else {
+            char escape[5];
+            std::snprintf(escape, sizeof(escape), "\\%03o", c);
+            result += escape;
+        }
+    }
+
+    return result + "\"";
+}
+
+std::string generateProgram(const Files &files, const Files &imports, const RunOptions &options) {
+    std::ostringstream code;
+
+    code << "// Built by `ACL build` from " << files[0].first << ", don't edit it\n\n";
+    code << "#include \"runtime.h\"\n\n";
+
+    code << "static const EmbeddedFile files[] = {\n";
+
+    for (auto &[path, source]: files)
+        code << "    {" << literal(path) << ",\n        " << literal(source) << "},\n";
+
+    code << "};\n\n";
+
+    // An array can't be empty
+    code << "static const EmbeddedImport imports[] = {\n";
+
+    for (auto &[path, file]: imports)
+        code << "    {" << literal(path) << ", " << literal(file) << "},\n";
+
+    code << "    {nullptr, nullptr},\n";
+    code << "};\n\n";
+
+    code << "int main(int count, char **args) {\n";
+    code << "    RunOptions options;\n";
+    code << "    options.maxStack = " << options.maxStack << ";\n";
+    code << "    options.stats = " << (options.stats ? "true" : "false") << ";\n";
+    code << "    options.optimize = " << (options.optimize ? "true" : "false") << ";\n";
+    code << "    options.jit = " << (options.jit ? "true" : "false") << ";\n";
+    code << "    options.jitDiff = " << (options.jitDiff ? "true" : "false") << ";\n";
+    code << "    options.callThreshold = " << options.callThreshold << ";\n";
+    code << "    options.loopThreshold = " << options.loopThreshold << ";\n\n";
+    code << "    return runEmbedded(count, args, files, " << files.size() << ", imports, " << imports.size()
+         << ", options);\n";
+    code << "}\n";
+
+    return code.str();
+}
+
+// Quoting an argument for the shell
+static std::string quote(const std::string &argument) {
+    std::string result = "'";
+
+    for (auto c: argument) {
+        if (c == '\'')
+            result += "'\\''";
+        else
+            result += c;
+    }
+
+    return result + "'";
+}
+
+int buildProgram(const std::string &file, std::string output, const RunOptions &options) {
+    Files files;
+    Files imports;
+
+    try {
+        collectFiles(file, true, files, imports);
+    } catch (const std::exception &error) {
+        printError(error.what());
+        return 1;
+    }
+
+    if (output.empty())
+        output = std::filesystem::path(file.ends_with(".acl") ? file : file + ".acl").stem();
+
+    // The generated source goes to a file of its own, files next to the output are never touched
+    auto path = (std::filesystem::temp_directory_path() / "acl-build-XXXXXX.cpp").string();
+    auto descriptor = mkstemps(path.data(), 4);
+
+    if (descriptor == -1) {
+        printError("Could not create a file for the generated source in " +
+                   std::filesystem::temp_directory_path().string());
+        return 1;
+    }
+
+    close(descriptor);
+
+    auto generated = path;
+    std::ofstream stream(generated);
+
+    if (!stream.is_open()) {
+        printError("Could not write " + generated);
+        std::filesystem::remove(generated);
+        return 1;
+    }
+
+    stream << generateProgram(files, imports, options);
+    stream.close();
+
+    auto compiler = getenv("CXX") != nullptr ? std::string(getenv("CXX")) : std::string(ACL_CXX_COMPILER);
+    auto command = compiler + " -std=c++17 -O2 -I " + quote(ACL_INCLUDE_DIRECTORY) + " " + quote(generated) +
+                   " " + quote(ACL_RUNTIME_LIBRARY) + " -lpthread -o " + quote(output);
+
+    if (std::system(command.c_str()) != 0) {
+        // The generated source is kept to look into
+        printError("Could not compile " + generated + ": " + command);
+        return 1;
+    }
+
+    std::filesystem::remove(generated);
+
+    return 0;
+}
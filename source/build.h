@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_BUILD_H
+#define ACL_BUILD_H
+
+#include <string>
+#include <vector>
+#include "runtime.h"
+
+// Building a program into an executable with `ACL build`. The imports are resolved now, and the files
+// they resolve to are put into C++ source together with the options, which is compiled with the system
+// C++ compiler and linked against the runtime library. The executable doesn't need any ACL files.
+//
+// The compiler is $CXX, or the one ACL was built with.
+
+// Builds the main file into the output (the name of the file without .acl if it is empty), returns the
+// exit status
+int buildProgram(const std::string &file, std::string output, const RunOptions &options);
+
+// The C++ source of a built program
+std::string generateProgram(const std::vector<std::pair<std::string, std::string>> &files,
+                            const std::vector<std::pair<std::string, std::string>> &imports,
+                            const RunOptions &options);
+
+#endif //ACL_BUILD_H
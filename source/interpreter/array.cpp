@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "array.h"
+
+size_t NumericArray::size() const {
+    return this->elementType == INT64 ? this->ints.size() : this->floats.size();
+}
+
+BasicValue NumericArray::get(size_t index) const {
+    if (this->elementType == INT64)
+        return BasicValue(this->ints[index]);
+
+    return BasicValue(this->floats[index]);
+}
+
+std::vector<double> NumericArray::toFloats() const {
+    if (this->elementType == FLOAT64)
+        return this->floats;
+
+    return {this->ints.begin(), this->ints.end()};
+}
+
+bool ArrayIterator::next(BasicValue &value) {
+    if (this->index >= this->array->size())
+        return false;
+
+    value = this->array->get(this->index++);
+    return true;
+}
+
+std::string arrayToString(NumericArray &array) {
+    std::string result = "array(";
+
+    for (size_t i = 0; i < array.size(); i++) {
+        if (i > 0)
+            result += ", ";
+
+        result += array.get(i).getValue();
+    }
+
+    return result + ")";
+}
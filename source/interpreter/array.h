@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_ARRAY_H
+#define ACL_ARRAY_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "type.h"
+
+// Contiguous buffer of numbers of the same type. Arrays are never modified after
+// they have been created, every builtin returns a new one, so they can be shared.
+class NumericArray {
+public:
+    enum ElementType {
+        INT64,
+        FLOAT64,
+    };
+
+    ElementType elementType;
+
+    // Only the buffer of the element type is used
+    std::vector<int64_t> ints;
+    std::vector<double> floats;
+
+    explicit NumericArray(std::vector<int64_t> values) : elementType(INT64), ints(std::move(values)) {}
+
+    explicit NumericArray(std::vector<double> values) : elementType(FLOAT64), floats(std::move(values)) {}
+
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] BasicValue get(size_t index) const;
+
+    // The elements converted to floats, used when ints and floats are mixed
+    [[nodiscard]] std::vector<double> toFloats() const;
+};
+
+// Iterating over the elements of an array. Used by `for x in array`.
+class ArrayIterator : public ValueIterator {
+    std::shared_ptr<NumericArray> array;
+    size_t index = 0;
+
+public:
+    explicit ArrayIterator(std::shared_ptr<NumericArray> array) : array(std::move(array)) {}
+
+    bool next(BasicValue &value) override;
+};
+
+#endif //ACL_ARRAY_H
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bigint.h"
+#include <algorithm>
+#include <stdexcept>
+
+BigInt::BigInt(int64_t value) {
+    this->negative = value < 0;
+
+    // Going through unsigned, so the negation of the smallest int64 doesn't overflow
+    auto magnitude = this->negative ? 0 - (uint64_t) value : (uint64_t) value;
+
+    while (magnitude != 0) {
+        this->limbs.push_back((uint32_t) magnitude);
+        magnitude >>= 32;
+    }
+}
+
+BigInt BigInt::parse(std::string_view text) {
+    BigInt result;
+    auto negative = !text.empty() && text[0] == '-';
+
+    if (negative)
+        text.remove_prefix(1);
+
+    if (text.empty())
+        throw std::runtime_error("Invalid integer");
+
+    for (auto c: text) {
+        if (c < '0' || c > '9')
+            throw std::runtime_error("Invalid integer: " + std::string(text));
+
+        // result = result * 10 + digit
+        uint64_t carry = c - '0';
+
+        for (auto &limb: result.limbs) {
+            auto value = (uint64_t) limb * 10 + carry;
+            limb = (uint32_t) value;
+            carry = value >> 32;
+        }
+
+        if (carry != 0)
+            result.limbs.push_back((uint32_t) carry);
+    }
+
+    result.negative = negative;
+    result.trim();
+
+    return result;
+}
+
+void BigInt::trim() {
+    while (!this->limbs.empty() && this->limbs.back() == 0)
+        this->limbs.pop_back();
+
+    // There is no negative zero
+    if (this->limbs.empty())
+        this->negative = false;
+}
+
+int BigInt::compareMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+    if (a.size() != b.size())
+        return a.size() < b.size() ? -1 : 1;
+
+    for (auto i = a.size(); i-- > 0;)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+
+    return 0;
+}
+
+std::vector<uint32_t> BigInt::addMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+    std::vector<uint32_t> result;
+    uint64_t carry = 0;
+
+    result.reserve(std::max(a.size(), b.size()) + 1);
+
+    for (size_t i = 0; i < a.size() || i < b.size(); i++) {
+        auto sum = carry + (i < a.size() ? a[i] : 0) + (i < b.size() ? b[i] : 0);
+        result.push_back((uint32_t) sum);
+        carry = sum >> 32;
+    }
+
+    if (carry != 0)
+        result.push_back((uint32_t) carry);
+
+    return result;
+}
+
+std::vector<uint32_t> BigInt::subtractMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b) {
+    std::vector<uint32_t> result;
+    int64_t borrow = 0;
+
+    result.reserve(a.size());
+
+    for (size_t i = 0; i < a.size(); i++) {
+        auto difference = (int64_t) a[i] - borrow - (i < b.size() ? b[i] : 0);
+        borrow = difference < 0;
+        result.push_back((uint32_t) (difference + (borrow << 32)));
+    }
+
+    return result;
+}
+
+void BigInt::divideMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b,
+                             std::vector<uint32_t> &quotient, std::vector<uint32_t> &remainder) {
+    quotient.assign(a.size(), 0);
+    remainder.clear();
+
+    // Dividing by a single limb is the common case, it only needs one pass
+    if (b.size() == 1) {
+        uint64_t rest = 0;
+
+        for (auto i = a.size(); i-- > 0;) {
+            auto value = (rest << 32) | a[i];
+            quotient[i] = (uint32_t) (value / b[0]);
+            rest = value % b[0];
+        }
+
+        if (rest != 0)
+            remainder.push_back((uint32_t) rest);
+
+        return;
+    }
+
+    // Shift and subtract, one bit at a time
+    for (auto bit = a.size() * 32; bit-- > 0;) {
+        // remainder = remainder * 2 + next bit
+        uint32_t carry = (a[bit / 32] >> (bit % 32)) & 1;
+
+        for (auto &limb: remainder) {
+            auto next = limb >> 31;
+            limb = (limb << 1) | carry;
+            carry = next;
+        }
+
+        if (carry != 0)
+            remainder.push_back(carry);
+
+        if (compareMagnitude(remainder, b) >= 0) {
+            remainder = subtractMagnitude(remainder, b);
+
+            while (!remainder.empty() && remainder.back() == 0)
+                remainder.pop_back();
+
+            quotient[bit / 32] |= 1u << (bit % 32);
+        }
+    }
+}
+
+BigInt BigInt::add(const BigInt &other) const {
+    BigInt result;
+
+    if (this->negative == other.negative) {
+        result.limbs = addMagnitude(this->limbs, other.limbs);
+        result.negative = this->negative;
+    } else if (compareMagnitude(this->limbs, other.limbs) >= 0) {
+        result.limbs = subtractMagnitude(this->limbs, other.limbs);
+        result.negative = this->negative;
+    } else {
+        result.limbs = subtractMagnitude(other.limbs, this->limbs);
+        result.negative = other.negative;
+    }
+
+    result.trim();
+    return result;
+}
+
+BigInt BigInt::subtract(const BigInt &other) const {
+    return this->add(other.negate());
+}
+
+BigInt BigInt::multiply(const BigInt &other) const {
+    BigInt result;
+
+    if (this->isZero() || other.isZero())
+        return result;
+
+    result.limbs.assign(this->limbs.size() + other.limbs.size(), 0);
+
+    for (size_t i = 0; i < this->limbs.size(); i++) {
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j < other.limbs.size(); j++) {
+            auto value = (uint64_t) this->limbs[i] * other.limbs[j] + result.limbs[i + j] + carry;
+            result.limbs[i + j] = (uint32_t) value;
+            carry = value >> 32;
+        }
+
+        result.limbs[i + other.limbs.size()] = (uint32_t) carry;
+    }
+
+    result.negative = this->negative != other.negative;
+    result.trim();
+
+    return result;
+}
+
+BigInt BigInt::divide(const BigInt &other) const {
+    if (other.isZero())
+        throw std::runtime_error("Division by zero");
+
+    BigInt result, rest;
+    divideMagnitude(this->limbs, other.limbs, result.limbs, rest.limbs);
+
+    result.negative = this->negative != other.negative;
+    result.trim();
+
+    return result;
+}
+
+BigInt BigInt::remainder(const BigInt &other) const {
+    if (other.isZero())
+        throw std::runtime_error("Division by zero");
+
+    BigInt quotient, result;
+    divideMagnitude(this->limbs, other.limbs, quotient.limbs, result.limbs);
+
+    result.negative = this->negative;
+    result.trim();
+
+    return result;
+}
+
+BigInt BigInt::negate() const {
+    auto result = *this;
+
+    if (!result.isZero())
+        result.negative = !result.negative;
+
+    return result;
+}
+
+int BigInt::compare(const BigInt &other) const {
+    if (this->negative != other.negative)
+        return this->negative ? -1 : 1;
+
+    auto magnitude = compareMagnitude(this->limbs, other.limbs);
+
+    return this->negative ? -magnitude : magnitude;
+}
+
+bool BigInt::isZero() const {
+    return this->limbs.empty();
+}
+
+bool BigInt::fitsInt64() const {
+    if (this->limbs.size() > 2)
+        return false;
+
+    auto magnitude = this->limbs.empty() ? 0 : (uint64_t) this->limbs[0];
+
+    if (this->limbs.size() == 2)
+        magnitude |= (uint64_t) this->limbs[1] << 32;
+
+    // The negative range is one larger
+    return magnitude <= (this->negative ? (uint64_t) INT64_MAX + 1 : (uint64_t) INT64_MAX);
+}
+
+int64_t BigInt::toInt64() const {
+    uint64_t magnitude = 0;
+
+    for (auto i = std::min<size_t>(this->limbs.size(), 2); i-- > 0;)
+        magnitude = (magnitude << 32) | this->limbs[i];
+
+    return (int64_t) (this->negative ? 0 - magnitude : magnitude);
+}
+
+double BigInt::toDouble() const {
+    double result = 0;
+
+    for (auto i = this->limbs.size(); i-- > 0;)
+        result = result * 4294967296.0 + this->limbs[i];
+
+    return this->negative ? -result : result;
+}
+
+std::string BigInt::toString() const {
+    if (this->isZero())
+        return "0";
+
+    // Splitting off nine decimal digits at a time
+    std::vector<uint32_t> rest = this->limbs;
+    std::vector<uint32_t> groups;
+
+    while (!rest.empty()) {
+        uint64_t remainder = 0;
+
+        for (auto i = rest.size(); i-- > 0;) {
+            auto value = (remainder << 32) | rest[i];
+            rest[i] = (uint32_t) (value / 1000000000);
+            remainder = value % 1000000000;
+        }
+
+        while (!rest.empty() && rest.back() == 0)
+            rest.pop_back();
+
+        groups.push_back((uint32_t) remainder);
+    }
+
+    std::string result = this->negative ? "-" : "";
+    result += std::to_string(groups.back());
+
+    for (auto i = groups.size() - 1; i-- > 0;) {
+        auto group = std::to_string(groups[i]);
+        result += std::string(9 - group.size(), '0') + group;
+    }
+
+    return result;
+}
+
+std::string bigIntToString(BigInt &value) {
+    return value.toString();
+}
+
+BasicValue bigIntValue(const BigInt &value) {
+    if (value.fitsInt64())
+        return BasicValue(value.toInt64());
+
+    return BasicValue(std::make_shared<BigInt>(value));
+}
+
+BigInt toBigInt(const BasicValue &value) {
+    if (value.type == BasicValue::Type::BIGINT)
+        return *value.bigValue;
+
+    return BigInt(value.intValue);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_BIGINT_H
+#define ACL_BIGINT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "type.h"
+
+// Integer of arbitrary size. Int arithmetic switches to big integers when a result doesn't fit
+// into 64 bits, and results which fit again become ints, so small numbers never use this.
+class BigInt {
+public:
+    BigInt() = default;
+
+    explicit BigInt(int64_t value);
+
+    // Parsing decimal digits with an optional leading minus
+    static BigInt parse(std::string_view text);
+
+    [[nodiscard]] BigInt add(const BigInt &other) const;
+
+    [[nodiscard]] BigInt subtract(const BigInt &other) const;
+
+    [[nodiscard]] BigInt multiply(const BigInt &other) const;
+
+    // Division rounds towards zero and the remainder has the sign of the dividend, just like for ints
+    [[nodiscard]] BigInt divide(const BigInt &other) const;
+
+    [[nodiscard]] BigInt remainder(const BigInt &other) const;
+
+    [[nodiscard]] BigInt negate() const;
+
+    // -1, 0 or 1
+    [[nodiscard]] int compare(const BigInt &other) const;
+
+    [[nodiscard]] bool isZero() const;
+
+    [[nodiscard]] bool fitsInt64() const;
+
+    [[nodiscard]] int64_t toInt64() const;
+
+    [[nodiscard]] double toDouble() const;
+
+    [[nodiscard]] std::string toString() const;
+
+private:
+    // Magnitude in base 2^32, least significant limb first, without leading zero limbs
+    std::vector<uint32_t> limbs;
+    bool negative = false;
+
+    void trim();
+
+    static int compareMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    static std::vector<uint32_t> addMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    // a - b, a has to be at least as large as b
+    static std::vector<uint32_t> subtractMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b);
+
+    static void divideMagnitude(const std::vector<uint32_t> &a, const std::vector<uint32_t> &b,
+                                std::vector<uint32_t> &quotient, std::vector<uint32_t> &remainder);
+};
+
+// An int if the number fits into 64 bits, a big integer otherwise
+BasicValue bigIntValue(const BigInt &value);
+
+// The number as a big integer, the value has to be an int or a big integer
+BigInt toBigInt(const BasicValue &value);
+
+#endif //ACL_BIGINT_H
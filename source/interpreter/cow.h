@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_COW_H
+#define ACL_COW_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A refcounted buffer shared between copies until one of them is changed (copy-on-write).
+// Copying is just a reference count increment, reading never copies. An empty buffer
+// isn't allocated at all.
+template<typename T>
+class Cow {
+    std::shared_ptr<T> buffer;
+
+public:
+    Cow() = default;
+
+    Cow(T value) : buffer(std::make_shared<T>(std::move(value))) {}
+
+    const T &get() const {
+        static const T empty;
+
+        return this->buffer ? *this->buffer : empty;
+    }
+
+    const T &operator*() const { return this->get(); }
+
+    const T *operator->() const { return &this->get(); }
+
+    // Writable access, copying the buffer first if it is shared with other values
+    T &mutate() {
+        if (!this->buffer)
+            this->buffer = std::make_shared<T>();
+        else if (this->buffer.use_count() > 1)
+            this->buffer = std::make_shared<T>(*this->buffer);
+
+        return *this->buffer;
+    }
+};
+
+// The buffer of a string value. It is shared between copies until one of them is changed,
+// just like Cow. A string can also be a slice of the buffer of another string, which is
+// only copied out once the string is needed as a std::string. The hash is computed once
+// and kept with the string.
+class SharedString {
+    mutable std::shared_ptr<std::string> buffer;
+    mutable size_t offset = 0;
+    mutable size_t length = 0;
+    mutable bool sliced = false;
+    mutable size_t cachedHash = 0;
+    mutable bool hashed = false;
+
+    // Copying a slice out of its parent buffer
+    void flatten() const {
+        if (!this->sliced)
+            return;
+
+        this->buffer = std::make_shared<std::string>(this->view());
+        this->offset = 0;
+        this->sliced = false;
+    }
+
+public:
+    SharedString() = default;
+
+    SharedString(std::string value) : buffer(std::make_shared<std::string>(std::move(value))) {}
+
+    // Sharing an existing buffer, e.g. the one of a string literal, whose hash is already known
+    SharedString(std::shared_ptr<std::string> buffer, size_t hash)
+            : buffer(std::move(buffer)), cachedHash(hash), hashed(true) {}
+
+    [[nodiscard]] std::string_view view() const {
+        if (!this->buffer)
+            return {};
+
+        if (this->sliced)
+            return std::string_view(*this->buffer).substr(this->offset, this->length);
+
+        return *this->buffer;
+    }
+
+    [[nodiscard]] size_t size() const { return this->view().size(); }
+
+    [[nodiscard]] size_t hash() const {
+        if (!this->hashed) {
+            this->cachedHash = std::hash<std::string_view>()(this->view());
+            this->hashed = true;
+        }
+
+        return this->cachedHash;
+    }
+
+    const std::string &get() const {
+        static const std::string empty;
+
+        this->flatten();
+
+        return this->buffer ? *this->buffer : empty;
+    }
+
+    const std::string &operator*() const { return this->get(); }
+
+    const std::string *operator->() const { return &this->get(); }
+
+    // Writable access, copying the buffer first if it is shared with other values
+    std::string &mutate() {
+        this->flatten();
+        this->hashed = false;
+
+        if (!this->buffer)
+            this->buffer = std::make_shared<std::string>();
+        else if (this->buffer.use_count() > 1)
+            this->buffer = std::make_shared<std::string>(*this->buffer);
+
+        return *this->buffer;
+    }
+
+    // The characters from `from` up to (not including) `to`, sharing this buffer
+    [[nodiscard]] SharedString slice(size_t from, size_t to) const {
+        SharedString result;
+        result.buffer = this->buffer;
+        result.offset = this->offset + from;
+        result.length = to - from;
+        result.sliced = true;
+
+        return result;
+    }
+};
+
+#endif //ACL_COW_H
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "file.h"
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+// Size of the read buffer of the line iterator
+const size_t LINE_BUFFER_SIZE = 1 << 20;
+
+// Size of the write buffer of a file handle
+const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+MappedFile::MappedFile(const std::string &path) {
+    this->descriptor = open(path.c_str(), O_RDONLY);
+
+    if (this->descriptor == -1)
+        throw std::runtime_error("Could not open file: " + path);
+
+    struct stat info{};
+
+    if (fstat(this->descriptor, &info) == -1) {
+        close(this->descriptor);
+        throw std::runtime_error("Could not read file: " + path);
+    }
+
+    this->size = info.st_size;
+
+    // Mapping an empty file is not allowed, the view just stays empty
+    if (this->size == 0)
+        return;
+
+    this->data = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->descriptor, 0);
+
+    if (this->data == MAP_FAILED) {
+        close(this->descriptor);
+        throw std::runtime_error("Could not map file: " + path);
+    }
+
+    // The file is read from the front to the back, so the kernel can read ahead
+    madvise(this->data, this->size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+    if (this->data != nullptr && this->data != MAP_FAILED)
+        munmap(this->data, this->size);
+
+    if (this->descriptor != -1)
+        close(this->descriptor);
+}
+
+std::string_view MappedFile::view() const {
+    if (this->data == nullptr)
+        return {};
+
+    return {static_cast<const char *>(this->data), this->size};
+}
+
+LineIterator::LineIterator(const std::string &path) {
+    this->descriptor = open(path.c_str(), O_RDONLY);
+
+    if (this->descriptor == -1)
+        throw std::runtime_error("Could not open file: " + path);
+
+    posix_fadvise(this->descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    this->buffer.resize(LINE_BUFFER_SIZE);
+}
+
+LineIterator::~LineIterator() {
+    if (this->descriptor != -1)
+        close(this->descriptor);
+}
+
+bool LineIterator::fill() {
+    if (this->eof)
+        return false;
+
+    // Moving the rest of the current line to the front
+    auto rest = this->end - this->start;
+    std::memmove(this->buffer.data(), this->buffer.data() + this->start, rest);
+
+    this->start = 0;
+    this->end = rest;
+
+    // The line is longer than the whole buffer
+    if (this->end == this->buffer.size())
+        this->buffer.resize(this->buffer.size() * 2);
+
+    auto count = read(this->descriptor, this->buffer.data() + this->end, this->buffer.size() - this->end);
+
+    if (count < 0)
+        throw std::runtime_error("Could not read file");
+
+    if (count == 0) {
+        this->eof = true;
+        return false;
+    }
+
+    this->end += count;
+    return true;
+}
+
+bool LineIterator::next(BasicValue &value) {
+    size_t searched = this->start;
+
+    while (true) {
+        auto begin = this->buffer.data() + searched;
+        auto newline = static_cast<char *>(std::memchr(begin, '\n', this->end - searched));
+
+        if (newline != nullptr) {
+            auto length = newline - (this->buffer.data() + this->start);
+            auto lineStart = this->buffer.data() + this->start;
+
+            // Windows line endings
+            if (length > 0 && lineStart[length - 1] == '\r')
+                length--;
+
+            value = BasicValue(std::string(lineStart, length));
+            this->start = newline - this->buffer.data() + 1;
+            return true;
+        }
+
+        searched = this->end - this->start;
+
+        if (!this->fill())
+            break;
+    }
+
+    // The last line doesn't have to end with a new line
+    if (this->start == this->end)
+        return false;
+
+    value = BasicValue(std::string(this->buffer.data() + this->start, this->end - this->start));
+    this->start = this->end;
+    return true;
+}
+
+// The handles which are open, so they can be flushed when the program ends
+static std::unordered_set<FileHandle *> openHandles;
+
+FileHandle::FileHandle(const std::string &path, const std::string &mode) : path(path) {
+    int flags;
+
+    if (mode == "w")
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+    else if (mode == "a")
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+    else
+        throw std::runtime_error("Unknown file mode: " + mode + ". Expected \"w\" or \"a\"");
+
+    this->descriptor = ::open(path.c_str(), flags, 0644);
+
+    if (this->descriptor == -1)
+        throw std::runtime_error("Could not open file: " + path);
+
+    this->buffer.resize(WRITE_BUFFER_SIZE);
+    openHandles.insert(this);
+}
+
+FileHandle::~FileHandle() {
+    // Errors can't be reported from a destructor, the data is written as good as possible
+    try {
+        this->close();
+    } catch (const std::runtime_error &) {}
+}
+
+void FileHandle::write(std::string_view data) {
+    if (!this->isOpen())
+        throw std::runtime_error("Cannot write to closed file: " + this->path);
+
+    // Big chunks don't fit into the buffer, so they are written directly
+    if (data.size() > this->buffer.size() - this->used) {
+        this->flush();
+
+        if (data.size() >= this->buffer.size()) {
+            while (!data.empty()) {
+                auto count = ::write(this->descriptor, data.data(), data.size());
+
+                if (count < 0)
+                    throw std::runtime_error("Could not write to file: " + this->path);
+
+                data.remove_prefix(count);
+            }
+
+            return;
+        }
+    }
+
+    std::memcpy(this->buffer.data() + this->used, data.data(), data.size());
+    this->used += data.size();
+}
+
+void FileHandle::flush() {
+    if (!this->isOpen())
+        throw std::runtime_error("Cannot flush closed file: " + this->path);
+
+    size_t written = 0;
+
+    while (written < this->used) {
+        auto count = ::write(this->descriptor, this->buffer.data() + written, this->used - written);
+
+        if (count < 0)
+            throw std::runtime_error("Could not write to file: " + this->path);
+
+        written += count;
+    }
+
+    this->used = 0;
+}
+
+void FileHandle::close() {
+    if (!this->isOpen())
+        return;
+
+    openHandles.erase(this);
+
+    this->flush();
+
+    ::close(this->descriptor);
+    this->descriptor = -1;
+}
+
+bool FileHandle::isOpen() const {
+    return this->descriptor != -1;
+}
+
+void FileHandle::flushAll() {
+    std::string error;
+
+    for (auto handle: openHandles) {
+        try {
+            handle->flush();
+        } catch (const std::runtime_error &exception) {
+            if (error.empty())
+                error = exception.what();
+        }
+    }
+
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_FILE_H
+#define ACL_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "type.h"
+
+// A read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+class MappedFile {
+    int descriptor = -1;
+    void *data = nullptr;
+    size_t size = 0;
+
+public:
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // The content of the file, valid as long as the mapping lives
+    [[nodiscard]] std::string_view view() const;
+};
+
+// Reading a file line by line through a fixed size buffer, so even huge files
+// are processed in bounded memory. Used by `for line in lines("file")`.
+class LineIterator : public ValueIterator {
+    int descriptor = -1;
+    std::vector<char> buffer;
+    size_t start = 0;
+    size_t end = 0;
+    bool eof = false;
+
+    // Refilling the buffer, keeping the unconsumed rest at the front
+    bool fill();
+
+public:
+    explicit LineIterator(const std::string &path);
+
+    ~LineIterator() override;
+
+    bool next(BasicValue &value) override;
+};
+
+// A file opened for writing with a large user space buffer, so writing many small
+// records doesn't need a system call each time. The file is flushed and closed
+// as soon as the last value referencing the handle is gone, or when the program ends.
+class FileHandle {
+    int descriptor = -1;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+public:
+    std::string path;
+
+    // Mode "w" truncates the file, mode "a" appends to it
+    FileHandle(const std::string &path, const std::string &mode);
+
+    ~FileHandle();
+
+    FileHandle(const FileHandle &) = delete;
+
+    FileHandle &operator=(const FileHandle &) = delete;
+
+    void write(std::string_view data);
+
+    void flush();
+
+    void close();
+
+    [[nodiscard]] bool isOpen() const;
+
+    // Flushing every open handle, e.g. those in variables of the file when the program ends. Throws
+    // the first error after trying all of them.
+    static void flushAll();
+};
+
+#endif //ACL_FILE_H
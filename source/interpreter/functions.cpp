@@ -17,7 +17,15 @@
 #include <map>
 #include <istream>
 #include <fstream>
+#include <cstdio>
 #include "functions.h"
+#include "file.h"
+#include "map.h"
+#include "array.h"
+#include "kernels.h"
+#include "vector.h"
+#include <chrono>
+#include "bigint.h"
 
 BasicValue stoi(std::vector<BasicValue> arguments) {
     if (arguments.size() != 1) {
@@ -26,7 +34,12 @@ BasicValue stoi(std::vector<BasicValue> arguments) {
     if (arguments[0].type != BasicValue::Type::STRING) {
         throw std::runtime_error("Invalid argument type");
     }
-    return BasicValue(std::stoi(arguments[0].stringValue));
+    // Numbers too large for 64 bits become big integers
+    try {
+        return BasicValue(std::stoll(*arguments[0].stringValue));
+    } catch (const std::out_of_range &) {
+        return bigIntValue(BigInt::parse(*arguments[0].stringValue));
+    }
 }
 
 BasicValue print(std::vector<BasicValue> arguments) {
@@ -84,6 +97,13 @@ BasicValue exit_(std::vector<BasicValue> arguments) {
     if (!arguments.empty() || arguments.size() > 1)
         throw std::runtime_error("Invalid number of arguments for exit()");
 
+    // The handles the program didn't close would lose their buffers
+    try {
+        FileHandle::flushAll();
+    } catch (const std::runtime_error &error) {
+        std::cerr << error.what() << std::endl;
+    }
+
     exit(arguments.size() == 1 ? arguments[0].intValue : 0);
 }
 
@@ -91,12 +111,24 @@ BasicValue len(std::vector<BasicValue> arguments) {
     if (arguments.size() != 1)
         throw std::runtime_error("len() takes exactly one argument");
 
+    if (arguments[0].type == BasicValue::Type::LIST)
+        return BasicValue(arguments[0].listValue->size());
+
+    if (arguments[0].type == BasicValue::Type::MAP)
+        return BasicValue(arguments[0].mapValue->size());
+
+    if (arguments[0].type == BasicValue::Type::ARRAY)
+        return BasicValue(arguments[0].arrayValue->size());
+
+    if (arguments[0].type == BasicValue::Type::VECTOR)
+        return BasicValue(arguments[0].vectorValue->size());
+
     if (arguments[0].type != BasicValue::Type::STRING)
         throw std::runtime_error(
-                "len() can only be used on strings and lists. Used on: " + std::to_string(arguments[0].type));
+                "len() can only be used on strings, lists and maps. Used on: " + std::to_string(arguments[0].type));
 
     // Returning an integer
-    return BasicValue((int) arguments[0].stringValue.size());
+    return BasicValue(arguments[0].stringValue.size());
 }
 
 BasicValue readFile(std::vector<BasicValue> arguments) {
@@ -107,25 +139,22 @@ BasicValue readFile(std::vector<BasicValue> arguments) {
         throw std::runtime_error(
                 "readFile() can only be used on strings. Used on: " + std::to_string(arguments[0].type));
 
-    // Opening the file
-    std::ifstream file(arguments[0].stringValue);
+    // Mapping the file, so it is copied in one go instead of line by line
+    MappedFile file(*arguments[0].stringValue);
 
-    // Checking if the file is open
-    if (!file.is_open())
-        throw std::runtime_error("Could not open file: " + arguments[0].stringValue);
-
-    // Reading the file
-    std::string result;
-    std::string line;
+    return BasicValue(std::string(file.view()));
+}
 
-    while (std::getline(file, line)) {
-        result += line;
-    }
+BasicValue lines(std::vector<BasicValue> arguments) {
+    if (arguments.size() != 1)
+        throw std::runtime_error("lines() takes exactly one argument");
 
-    // Closing the file
-    file.close();
+    if (arguments[0].type != BasicValue::Type::STRING)
+        throw std::runtime_error(
+                "lines() can only be used on strings. Used on: " + std::to_string(arguments[0].type));
 
-    return BasicValue(result);
+    // The file is read lazily while the for loop is running
+    return BasicValue(std::make_shared<LineIterator>(*arguments[0].stringValue));
 }
 
 BasicValue writeFile(std::vector<BasicValue> arguments) {
@@ -141,14 +170,14 @@ BasicValue writeFile(std::vector<BasicValue> arguments) {
                 "writeFile() can only be used on strings. Used on: " + std::to_string(arguments[1].type));
 
     // Opening the file
-    std::ofstream file(arguments[0].stringValue);
+    std::ofstream file(*arguments[0].stringValue);
 
     // Checking if the file is open
     if (!file.is_open())
-        throw std::runtime_error("Could not open file: " + arguments[0].stringValue);
+        throw std::runtime_error("Could not open file: " + *arguments[0].stringValue);
 
     // Writing the file
-    file << arguments[1].stringValue;
+    file << *arguments[1].stringValue;
 
     // Closing the file
     file.close();
@@ -156,6 +185,72 @@ BasicValue writeFile(std::vector<BasicValue> arguments) {
     return BasicValue();
 }
 
+BasicValue removeFile(std::vector<BasicValue> arguments) {
+    if (arguments.size() != 1)
+        throw std::runtime_error("removeFile() takes exactly one argument");
+
+    if (arguments[0].type != BasicValue::Type::STRING)
+        throw std::runtime_error(
+                "removeFile() can only be used on strings. Used on: " + std::to_string(arguments[0].type));
+
+    // Returns whether there was a file to remove
+    return BasicValue(std::remove(arguments[0].stringValue->c_str()) == 0);
+}
+
+BasicValue open_(std::vector<BasicValue> arguments) {
+    if (arguments.empty() || arguments.size() > 2)
+        throw std::runtime_error("open() takes one or two arguments");
+
+    for (auto &argument: arguments)
+        if (argument.type != BasicValue::Type::STRING)
+            throw std::runtime_error(
+                    "open() can only be used on strings. Used on: " + std::to_string(argument.type));
+
+    auto mode = arguments.size() == 2 ? *arguments[1].stringValue : std::string("w");
+
+    return BasicValue(std::make_shared<FileHandle>(*arguments[0].stringValue, mode));
+}
+
+// Getting the file handle out of the first argument
+FileHandle &getHandle(const std::string &name, std::vector<BasicValue> &arguments) {
+    if (arguments.empty() || arguments[0].type != BasicValue::Type::HANDLE)
+        throw std::runtime_error(name + "() expects a file handle as the first argument");
+
+    return *arguments[0].handleValue;
+}
+
+BasicValue write_(std::vector<BasicValue> arguments) {
+    auto &handle = getHandle("write", arguments);
+
+    // Writing all other arguments, just like print() does
+    for (size_t i = 1; i < arguments.size(); i++) {
+        if (arguments[i].type == BasicValue::Type::STRING)
+            handle.write(*arguments[i].stringValue);
+        else
+            handle.write(arguments[i].getValue());
+    }
+
+    return BasicValue();
+}
+
+BasicValue flush_(std::vector<BasicValue> arguments) {
+    if (arguments.size() != 1)
+        throw std::runtime_error("flush() takes exactly one argument");
+
+    getHandle("flush", arguments).flush();
+
+    return BasicValue();
+}
+
+BasicValue close_(std::vector<BasicValue> arguments) {
+    if (arguments.size() != 1)
+        throw std::runtime_error("close() takes exactly one argument");
+
+    getHandle("close", arguments).close();
+
+    return BasicValue();
+}
+
 BasicValue range(std::vector<BasicValue> arguments) {
     auto start = BasicValue(0);
     auto end = BasicValue(0);
@@ -185,7 +280,7 @@ BasicValue range(std::vector<BasicValue> arguments) {
 
     std::vector<BasicValue> values;
 
-    for (int i = start.intValue; i < end.intValue; i += step.intValue) {
+    for (auto i = start.intValue; i < end.intValue; i += step.intValue) {
         values.emplace_back(i);
     }
 
@@ -199,8 +294,19 @@ BasicValue list(std::vector<BasicValue> arguments) {
     if (arguments.size() == 1) {
         if (arguments[0].type == BasicValue::Type::LIST)
             return arguments[0];
-        else
-            throw std::runtime_error("list() can only be used on lists");
+        else if (arguments[0].type == BasicValue::Type::VECTOR) {
+            std::vector<BasicValue> values;
+            BasicValue value;
+            VectorIterator iterator(arguments[0].vectorValue);
+
+            values.reserve(arguments[0].vectorValue->size());
+
+            while (iterator.next(value))
+                values.push_back(value);
+
+            return BasicValue(values);
+        } else
+            throw std::runtime_error("list() can only be used on lists and vectors");
     }
 
     std::vector<BasicValue> values;
@@ -215,6 +321,516 @@ BasicValue list(std::vector<BasicValue> arguments) {
     return BasicValue(values);
 }
 
+// The list builtins below change their first argument in place. They take the arguments
+// by reference, and the interpreter hands them the stored list instead of a copy (see
+// function_mutates), so growing a list is amortized O(1).
+
+// Getting a writable reference to the list in the first argument
+std::vector<BasicValue> &getList(const std::string &name, std::vector<BasicValue> &arguments, size_t count) {
+    if (arguments.size() != count)
+        throw std::runtime_error(name + "() takes exactly " + std::to_string(count) + " arguments");
+
+    if (arguments[0].type != BasicValue::Type::LIST)
+        throw std::runtime_error(name + "() expects a list as the first argument");
+
+    return arguments[0].listValue.mutate();
+}
+
+// Checking an index into a list or vector, the end is only allowed when inserting or slicing
+size_t getListIndex(const std::string &name, BasicValue &index, size_t size, bool allowEnd) {
+    if (index.type != BasicValue::Type::INT)
+        throw std::runtime_error(name + "() expects an integer index");
+
+    if (index.intValue < 0 || (size_t) index.intValue > size || ((size_t) index.intValue == size && !allowEnd))
+        throw std::runtime_error(name + "(): index out of bounds");
+
+    return index.intValue;
+}
+
+BasicValue append(std::vector<BasicValue> &arguments) {
+    getList("append", arguments, 2).push_back(std::move(arguments[1]));
+
+    return BasicValue();
+}
+
+BasicValue pop(std::vector<BasicValue> &arguments) {
+    // Without an index the last element is removed
+    auto &list = getList("pop", arguments, arguments.size() == 2 ? 2 : 1);
+
+    if (list.empty())
+        throw std::runtime_error("pop() on an empty list");
+
+    auto index = arguments.size() == 2 ? getListIndex("pop", arguments[1], list.size(), false) : list.size() - 1;
+    auto value = std::move(list[index]);
+
+    list.erase(list.begin() + (long) index);
+
+    return value;
+}
+
+BasicValue insert(std::vector<BasicValue> &arguments) {
+    auto &list = getList("insert", arguments, 3);
+    auto index = getListIndex("insert", arguments[1], list.size(), true);
+
+    list.insert(list.begin() + (long) index, std::move(arguments[2]));
+
+    return BasicValue();
+}
+
+BasicValue extend(std::vector<BasicValue> &arguments) {
+    auto &list = getList("extend", arguments, 2);
+
+    if (arguments[1].type != BasicValue::Type::LIST)
+        throw std::runtime_error("extend() expects a list as the second argument");
+
+    auto &other = *arguments[1].listValue;
+
+    list.insert(list.end(), other.begin(), other.end());
+
+    return BasicValue();
+}
+
+BasicValue reserve(std::vector<BasicValue> &arguments) {
+    auto &list = getList("reserve", arguments, 2);
+
+    if (arguments[1].type != BasicValue::Type::INT || arguments[1].intValue < 0)
+        throw std::runtime_error("reserve() expects a positive integer");
+
+    list.reserve(arguments[1].intValue);
+
+    return BasicValue();
+}
+
+// Getting the map out of the first argument
+ValueMap &getMap(const std::string &name, std::vector<BasicValue> &arguments, size_t count) {
+    if (arguments.size() != count)
+        throw std::runtime_error(name + "() takes exactly " + std::to_string(count) + " arguments");
+
+    if (arguments[0].type != BasicValue::Type::MAP)
+        throw std::runtime_error(name + "() expects a map as the first argument");
+
+    return *arguments[0].mapValue;
+}
+
+BasicValue get(std::vector<BasicValue> arguments) {
+    // The optional third argument is returned if the key doesn't exist
+    auto &map = getMap("get", arguments, arguments.size() == 3 ? 3 : 2);
+    auto value = map.find(arguments[1]);
+
+    if (value != nullptr)
+        return *value;
+
+    if (arguments.size() == 3)
+        return arguments[2];
+
+    throw std::runtime_error("Key not found in map: " + arguments[1].getValue());
+}
+
+BasicValue set(std::vector<BasicValue> arguments) {
+    getMap("set", arguments, 3).set(arguments[1], arguments[2]);
+
+    return BasicValue();
+}
+
+BasicValue has(std::vector<BasicValue> arguments) {
+    return BasicValue(getMap("has", arguments, 2).find(arguments[1]) != nullptr);
+}
+
+BasicValue delete_(std::vector<BasicValue> arguments) {
+    return BasicValue(getMap("delete", arguments, 2).remove(arguments[1]));
+}
+
+BasicValue keys(std::vector<BasicValue> arguments) {
+    std::vector<BasicValue> values;
+
+    for (auto &entry: getMap("keys", arguments, 1).getEntries())
+        if (!entry.removed)
+            values.push_back(entry.key);
+
+    return BasicValue(values);
+}
+
+BasicValue values(std::vector<BasicValue> arguments) {
+    std::vector<BasicValue> values;
+
+    for (auto &entry: getMap("values", arguments, 1).getEntries())
+        if (!entry.removed)
+            values.push_back(entry.value);
+
+    return BasicValue(values);
+}
+
+BasicValue vector_(std::vector<BasicValue> arguments) {
+    auto vector = PersistentVector();
+
+    if (arguments.empty())
+        return BasicValue(std::make_shared<PersistentVector>(vector));
+
+    if (arguments.size() != 1 || arguments[0].type != BasicValue::Type::LIST)
+        throw std::runtime_error("vector() takes nothing or a list");
+
+    for (auto &value: *arguments[0].listValue)
+        vector = vector.push(value);
+
+    return BasicValue(std::make_shared<PersistentVector>(vector));
+}
+
+// Getting the vector out of the first argument
+PersistentVector &getVector(const std::string &name, std::vector<BasicValue> &arguments, size_t count) {
+    if (arguments.size() != count)
+        throw std::runtime_error(name + "() takes exactly " + std::to_string(count) + " arguments");
+
+    if (arguments[0].type != BasicValue::Type::VECTOR)
+        throw std::runtime_error(name + "() expects a vector as the first argument");
+
+    return *arguments[0].vectorValue;
+}
+
+BasicValue with(std::vector<BasicValue> arguments) {
+    auto &vector = getVector("with", arguments, 3);
+    auto index = getListIndex("with", arguments[1], vector.size(), false);
+
+    return BasicValue(std::make_shared<PersistentVector>(vector.with(index, arguments[2])));
+}
+
+BasicValue push(std::vector<BasicValue> arguments) {
+    auto &vector = getVector("push", arguments, 2);
+
+    return BasicValue(std::make_shared<PersistentVector>(vector.push(arguments[1])));
+}
+
+BasicValue slice(std::vector<BasicValue> arguments) {
+    if (arguments.size() != 2 && arguments.size() != 3)
+        throw std::runtime_error("slice() takes 2 or 3 arguments");
+
+    // Strings are sliced without copying as well
+    auto isString = arguments[0].type == BasicValue::Type::STRING;
+
+    if (!isString && arguments[0].type != BasicValue::Type::VECTOR)
+        throw std::runtime_error("slice() expects a vector or string as the first argument");
+
+    // Without an end the slice goes up to the end
+    auto size = isString ? arguments[0].stringValue.size() : arguments[0].vectorValue->size();
+    auto from = getListIndex("slice", arguments[1], size, true);
+    auto to = arguments.size() == 3 ? getListIndex("slice", arguments[2], size, true) : size;
+
+    if (from > to)
+        throw std::runtime_error("slice(): start is after the end");
+
+    if (isString)
+        return BasicValue(arguments[0].stringValue.slice(from, to));
+
+    return BasicValue(std::make_shared<PersistentVector>(arguments[0].vectorValue->slice(from, to)));
+}
+
+// Set when the program is loaded, before the interpreter starts
+static const auto programStart = std::chrono::steady_clock::now();
+
+BasicValue time_(std::vector<BasicValue> arguments) {
+    if (!arguments.empty())
+        throw std::runtime_error("time() takes no arguments");
+
+    // Milliseconds since the program started, so the value fits into an int
+    auto elapsed = std::chrono::steady_clock::now() - programStart;
+
+    return BasicValue(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+// An argument of an elementwise builtin, single numbers are repeated to the length of the arrays
+template<typename T>
+class Operand {
+    std::vector<T> storage;
+
+public:
+    const T *data;
+
+    Operand(const BasicValue &value, size_t size) {
+        if (value.type == BasicValue::Type::ARRAY) {
+            if constexpr (std::is_same_v<T, int64_t>) {
+                this->data = value.arrayValue->ints.data();
+                return;
+            } else {
+                if (value.arrayValue->elementType == NumericArray::FLOAT64) {
+                    this->data = value.arrayValue->floats.data();
+                    return;
+                }
+
+                this->storage = value.arrayValue->toFloats();
+            }
+        } else if (value.type == BasicValue::Type::INT) {
+            this->storage.assign(size, (T) value.intValue);
+        } else {
+            this->storage.assign(size, (T) value.floatValue);
+        }
+
+        this->data = this->storage.data();
+    }
+};
+
+// Checking the arguments of an array builtin, returns the length of the arrays
+size_t checkArrayArguments(const std::string &name, std::vector<BasicValue> &arguments, size_t count) {
+    if (arguments.size() != count)
+        throw std::runtime_error(name + "() takes exactly " + std::to_string(count) + " arguments");
+
+    size_t size = 0;
+    bool hasArray = false;
+
+    for (auto &argument: arguments) {
+        if (argument.type == BasicValue::Type::ARRAY) {
+            if (hasArray && argument.arrayValue->size() != size)
+                throw std::runtime_error(name + "() can only be used on arrays of the same length");
+
+            size = argument.arrayValue->size();
+            hasArray = true;
+        } else if (argument.type != BasicValue::Type::INT && argument.type != BasicValue::Type::FLOAT) {
+            throw std::runtime_error(
+                    name + "() can only be used on arrays and numbers. Used on: " + std::to_string(argument.type));
+        }
+    }
+
+    if (!hasArray || arguments[0].type != BasicValue::Type::ARRAY)
+        throw std::runtime_error(name + "() expects an array as the first argument");
+
+    return size;
+}
+
+// If the result of an elementwise builtin has to be a float array
+bool hasFloats(std::vector<BasicValue> &arguments, size_t from) {
+    for (size_t i = from; i < arguments.size(); i++) {
+        auto &argument = arguments[i];
+
+        if (argument.type == BasicValue::Type::FLOAT ||
+            (argument.type == BasicValue::Type::ARRAY && argument.arrayValue->elementType == NumericArray::FLOAT64))
+            return true;
+    }
+
+    return false;
+}
+
+BasicValue array(std::vector<BasicValue> arguments) {
+    // array(size, value) creates an array filled with the value
+    if (arguments.size() == 2) {
+        if (arguments[0].type != BasicValue::Type::INT || arguments[0].intValue < 0)
+            throw std::runtime_error("array() expects a positive size as the first argument");
+
+        if (arguments[1].type == BasicValue::Type::INT)
+            return BasicValue(std::make_shared<NumericArray>(
+                    std::vector<int64_t>(arguments[0].intValue, arguments[1].intValue)));
+
+        if (arguments[1].type == BasicValue::Type::FLOAT)
+            return BasicValue(std::make_shared<NumericArray>(
+                    std::vector<double>(arguments[0].intValue, arguments[1].floatValue)));
+
+        throw std::runtime_error("array() can only be filled with numbers");
+    }
+
+    if (arguments.size() != 1 || arguments[0].type != BasicValue::Type::LIST)
+        throw std::runtime_error("array() takes a list, or a size and a value");
+
+    auto &list = *arguments[0].listValue;
+    bool isFloat = false;
+
+    for (auto &element: list) {
+        if (element.type == BasicValue::Type::FLOAT)
+            isFloat = true;
+        else if (element.type != BasicValue::Type::INT)
+            throw std::runtime_error("array() can only be used on lists of numbers");
+    }
+
+    if (isFloat) {
+        std::vector<double> values;
+        values.reserve(list.size());
+
+        for (auto &element: list)
+            values.push_back(element.type == BasicValue::Type::INT ? element.intValue : element.floatValue);
+
+        return BasicValue(std::make_shared<NumericArray>(std::move(values)));
+    }
+
+    std::vector<int64_t> values;
+    values.reserve(list.size());
+
+    for (auto &element: list)
+        values.push_back(element.intValue);
+
+    return BasicValue(std::make_shared<NumericArray>(std::move(values)));
+}
+
+// Int arrays whose elements don't fit into 64 bits anymore
+static std::runtime_error overflow(const std::string &name) {
+    return std::runtime_error(name + "() overflows the ints of the array, the result doesn't fit into 64 bits");
+}
+
+BasicValue sum(std::vector<BasicValue> arguments) {
+    checkArrayArguments("sum", arguments, 1);
+    auto &array = *arguments[0].arrayValue;
+
+    if (array.elementType == NumericArray::INT64) {
+        int64_t result;
+
+        if (kernels::sum(array.ints.data(), array.ints.size(), result))
+            return BasicValue(result);
+
+        // Like int arithmetic, the sum becomes a big integer when it overflows
+        BigInt total;
+
+        for (auto value: array.ints)
+            total = total.add(BigInt(value));
+
+        return bigIntValue(total);
+    }
+
+    return BasicValue(kernels::sum(array.floats.data(), array.floats.size()));
+}
+
+BasicValue min_(std::vector<BasicValue> arguments) {
+    if (checkArrayArguments("min", arguments, 1) == 0)
+        throw std::runtime_error("min() can't be used on an empty array");
+
+    auto &array = *arguments[0].arrayValue;
+
+    if (array.elementType == NumericArray::INT64)
+        return BasicValue(kernels::min(array.ints.data(), array.ints.size()));
+
+    return BasicValue(kernels::min(array.floats.data(), array.floats.size()));
+}
+
+BasicValue max_(std::vector<BasicValue> arguments) {
+    if (checkArrayArguments("max", arguments, 1) == 0)
+        throw std::runtime_error("max() can't be used on an empty array");
+
+    auto &array = *arguments[0].arrayValue;
+
+    if (array.elementType == NumericArray::INT64)
+        return BasicValue(kernels::max(array.ints.data(), array.ints.size()));
+
+    return BasicValue(kernels::max(array.floats.data(), array.floats.size()));
+}
+
+BasicValue dot(std::vector<BasicValue> arguments) {
+    auto size = checkArrayArguments("dot", arguments, 2);
+
+    if (arguments[1].type != BasicValue::Type::ARRAY)
+        throw std::runtime_error("dot() can only be used on two arrays");
+
+    if (!hasFloats(arguments, 0)) {
+        auto &a = arguments[0].arrayValue->ints, &b = arguments[1].arrayValue->ints;
+        int64_t result;
+
+        if (kernels::dot(a.data(), b.data(), size, result))
+            return BasicValue(result);
+
+        BigInt total;
+
+        for (size_t i = 0; i < size; i++)
+            total = total.add(BigInt(a[i]).multiply(BigInt(b[i])));
+
+        return bigIntValue(total);
+    }
+
+    Operand<double> a(arguments[0], size), b(arguments[1], size);
+
+    return BasicValue(kernels::dot(a.data, b.data, size));
+}
+
+BasicValue scale(std::vector<BasicValue> arguments) {
+    auto size = checkArrayArguments("scale", arguments, 2);
+
+    if (arguments[1].type == BasicValue::Type::ARRAY)
+        throw std::runtime_error("scale() expects a number as the second argument");
+
+    if (!hasFloats(arguments, 0)) {
+        std::vector<int64_t> result(size);
+
+        if (!kernels::scale(arguments[0].arrayValue->ints.data(), arguments[1].intValue, result.data(), size))
+            throw overflow("scale");
+
+        return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+    }
+
+    Operand<double> values(arguments[0], size);
+    std::vector<double> result(size);
+    auto factor = arguments[1].type == BasicValue::Type::INT ? arguments[1].intValue : arguments[1].floatValue;
+
+    kernels::scale(values.data, factor, result.data(), size);
+
+    return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+}
+
+BasicValue add(std::vector<BasicValue> arguments) {
+    auto size = checkArrayArguments("add", arguments, 2);
+
+    if (!hasFloats(arguments, 0)) {
+        Operand<int64_t> a(arguments[0], size), b(arguments[1], size);
+        std::vector<int64_t> result(size);
+
+        if (!kernels::add(a.data, b.data, result.data(), size))
+            throw overflow("add");
+
+        return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+    }
+
+    Operand<double> a(arguments[0], size), b(arguments[1], size);
+    std::vector<double> result(size);
+
+    kernels::add(a.data, b.data, result.data(), size);
+
+    return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+}
+
+BasicValue where(std::vector<BasicValue> arguments) {
+    auto size = checkArrayArguments("where", arguments, 3);
+    auto &condition = *arguments[0].arrayValue;
+
+    // Float conditions are turned into 0 and 1 first
+    std::vector<int64_t> mask;
+    const int64_t *conditionData = condition.ints.data();
+
+    if (condition.elementType == NumericArray::FLOAT64) {
+        mask.reserve(size);
+
+        for (auto value: condition.floats)
+            mask.push_back(value != 0);
+
+        conditionData = mask.data();
+    }
+
+    if (!hasFloats(arguments, 1)) {
+        Operand<int64_t> a(arguments[1], size), b(arguments[2], size);
+        std::vector<int64_t> result(size);
+
+        kernels::where(conditionData, a.data, b.data, result.data(), size);
+
+        return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+    }
+
+    Operand<double> a(arguments[1], size), b(arguments[2], size);
+    std::vector<double> result(size);
+
+    kernels::where(conditionData, a.data, b.data, result.data(), size);
+
+    return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+}
+
+BasicValue cumsum(std::vector<BasicValue> arguments) {
+    auto size = checkArrayArguments("cumsum", arguments, 1);
+    auto &array = *arguments[0].arrayValue;
+
+    if (array.elementType == NumericArray::INT64) {
+        std::vector<int64_t> result(size);
+
+        if (!kernels::cumsum(array.ints.data(), result.data(), size))
+            throw overflow("cumsum");
+
+        return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+    }
+
+    std::vector<double> result(size);
+    kernels::cumsum(array.floats.data(), result.data(), size);
+
+    return BasicValue(std::make_shared<NumericArray>(std::move(result)));
+}
+
 // A list of all function names and their corresponding function pointers.
 const std::map<std::string, void *> functionMap = {
         {"print",     (void *) &print},
@@ -225,19 +841,50 @@ const std::map<std::string, void *> functionMap = {
         {"len",       (void *) &len},
         {"readFile",  (void *) &readFile},
         {"writeFile", (void *) &writeFile},
+        {"removeFile", (void *) &removeFile},
+        {"lines",     (void *) &lines},
+        {"open",      (void *) &open_},
+        {"write",     (void *) &write_},
+        {"flush",     (void *) &flush_},
+        {"close",     (void *) &close_},
         {"range",     (void *) &range},
         {"list",      (void *) &list},
-        {"stoi",      (void *) &stoi}
+        {"append",    (void *) &append},
+        {"pop",       (void *) &pop},
+        {"insert",    (void *) &insert},
+        {"extend",    (void *) &extend},
+        {"reserve",   (void *) &reserve},
+        {"stoi",      (void *) &stoi},
+        {"get",       (void *) &get},
+        {"set",       (void *) &set},
+        {"has",       (void *) &has},
+        {"delete",    (void *) &delete_},
+        {"keys",      (void *) &keys},
+        {"values",    (void *) &values},
+        {"time",      (void *) &time_},
+        {"vector",    (void *) &vector_},
+        {"with",      (void *) &with},
+        {"push",      (void *) &push},
+        {"slice",     (void *) &slice},
+        {"array",     (void *) &array},
+        {"sum",       (void *) &sum},
+        {"min",       (void *) &min_},
+        {"max",       (void *) &max_},
+        {"dot",       (void *) &dot},
+        {"scale",     (void *) &scale},
+        {"add",       (void *) &add},
+        {"where",     (void *) &where},
+        {"cumsum",    (void *) &cumsum}
 };
 
-BasicValue executeFunction(const std::string &name, const std::vector<BasicValue> &arguments) {
+BasicValue executeFunction(const std::string &name, std::vector<BasicValue> &arguments) {
     // Searching for the function
     auto function = functionMap.find(name);
 
     // If the function was found
     if (function != functionMap.end()) {
         // Calling the function
-        return ((BasicValue(*)(const std::vector<BasicValue> &)) function->second)(arguments);
+        return ((BasicValue(*)(std::vector<BasicValue> &)) function->second)(arguments);
     }
 
     // If the function was not found
@@ -254,4 +901,23 @@ bool function_exists(const std::string &name) {
     }
 
     return false;
-}
\ No newline at end of file
+}
+bool function_mutates(const std::string &name) {
+    return name == "append" || name == "pop" || name == "insert" || name == "extend" || name == "reserve";
+}
+
+bool function_changes_arguments(const std::string &name) {
+    return function_mutates(name) || name == "set" || name == "delete";
+}
+
+bool function_is_pure(const std::string &name) {
+    return name == "len" || name == "stoi" || name == "get" || name == "has" || name == "keys" ||
+           name == "values" || name == "vector" || name == "with" || name == "push" || name == "slice" ||
+           name == "sum" || name == "min" || name == "max" || name == "dot";
+}
+
+bool function_performs_io(const std::string &name) {
+    return name == "print" || name == "println" || name == "input" || name == "os" || name == "exit" ||
+           name == "readFile" || name == "writeFile" || name == "removeFile" || name == "lines" || name == "open" ||
+           name == "write" || name == "flush" || name == "close" || name == "time";
+}
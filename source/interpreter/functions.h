@@ -26,6 +26,20 @@
 bool function_exists(const std::string& name);
 
 // Executing a function integrated in the interpreter.
-BasicValue executeFunction(const std::string& name, const std::vector<BasicValue>& arguments);
+BasicValue executeFunction(const std::string& name, std::vector<BasicValue>& arguments);
+
+// If an integrated function changes the list in its first argument in place
+bool function_mutates(const std::string& name);
+
+// If an integrated function changes one of its arguments, a list in place or a map
+bool function_changes_arguments(const std::string& name);
+
+// If an integrated function only computes its result from its arguments, without changing them or
+// anything else. Calls with equal arguments give equal results, and no result is a new mutable array.
+bool function_is_pure(const std::string& name);
+
+// If an integrated function reads or writes anything outside of its arguments (console, files, time),
+// those can't be called from memoized functions
+bool function_performs_io(const std::string& name);
 
 #endif //ACL_FUNCTIONS_H
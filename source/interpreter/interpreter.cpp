@@ -15,6 +15,8 @@
  */
 
 #include "interpreter.h"
+#include "../parser/optimizer.h"
+#include <iomanip>
 
 void Interpreter::interpret() {
     // Interpreting all children in the AST
@@ -23,6 +25,66 @@ void Interpreter::interpret() {
     }
 }
 
+void Interpreter::popScope() {
+    auto scope = this->current_scope;
+
+    this->current_scope = scope->parent;
+
+    // Nothing can reach the scope anymore, so its values (e.g. open file handles) are released right away
+    delete scope;
+}
+
+// Whether a value can be stored where the annotation allows it. Ints which grew into big
+// integers are still ints.
+bool matchesType(const BasicValue &value, StaticType type) {
+    switch (type) {
+        case StaticType::INT:
+            return value.type == BasicValue::Type::INT || value.type == BasicValue::Type::BIGINT;
+        case StaticType::FLOAT:
+            return value.type == BasicValue::Type::FLOAT;
+        case StaticType::STRING:
+            return value.type == BasicValue::Type::STRING;
+        default:
+            return true;
+    }
+}
+
+// Name of the type of a value, in the words of the annotations where there is one
+static std::string valueTypeName(const BasicValue &value) {
+    switch (value.type) {
+        case BasicValue::Type::INT:
+        case BasicValue::Type::BIGINT:
+            return "int";
+        case BasicValue::Type::FLOAT:
+            return "float";
+        case BasicValue::Type::STRING:
+            return "string";
+        case BasicValue::Type::LIST:
+            return "list";
+        case BasicValue::Type::VOID:
+            return "void";
+        case BasicValue::Type::ITERATOR:
+            return "iterator";
+        case BasicValue::Type::HANDLE:
+            return "handle";
+        case BasicValue::Type::MAP:
+            return "map";
+        case BasicValue::Type::ARRAY:
+            return "array";
+        case BasicValue::Type::OBJECT:
+            return "object";
+        case BasicValue::Type::VECTOR:
+            return "vector";
+        default:
+            return "unknown";
+    }
+}
+
+[[noreturn]] void typeError(const BasicValue &value, StaticType type, const std::string &what, int line) {
+    throw std::runtime_error(what + " must be of type " + typeName(type) + ", but is " + valueTypeName(value) +
+                             " \"" + value.getValue() + "\", line: " + std::to_string(line + 1));
+}
+
 void Interpreter::importFile(AstChild *node) {
     auto realNode = dynamic_cast<ImportStatementNode *>(node);
 
@@ -34,626 +96,1685 @@ void Interpreter::importFile(AstChild *node) {
     // Getting the parsed abstractSyntaxTree
     auto abstractSyntaxTreeList = parse_file(realNode->path);
 
+    if (this->profile != nullptr)
+        for (auto abstractSyntaxTree: abstractSyntaxTreeList)
+            this->profile->apply(abstractSyntaxTree, this->jit.get());
+
     for (const auto &abstractSyntaxTree: abstractSyntaxTreeList)
         // Adding all functions and variables to the current scope
         for (auto &item: abstractSyntaxTree->children) {
             if (item->getIdentifier() == "FunctionDefinition") {
-                auto realItem = dynamic_cast<FunctionDefinitionNode *>(item);
-
-                this->current_scope->functions.emplace_back(realItem->name, &realItem->parameters, &realItem->body,
-                                                            this->current_scope, realItem->isExternal);
+                this->defineFunction(dynamic_cast<FunctionDefinitionNode *>(item));
             } else if (item->getIdentifier() == "VariableDefinition") {
-                auto realItem = dynamic_cast<VariableDefinitionNode *>(item);
-
-                this->current_scope->variables.emplace_back(realItem->name,
-                                                            this->interpretExpression(realItem->value.get()),
-                                                            realItem->constant);
+                this->defineVariable(dynamic_cast<VariableDefinitionNode *>(item));
             } else if (item->getIdentifier() == "ImportStatement") {
                 this->importFile(item);
             }
         }
 }
 
-void Interpreter::interpretChild(AstChild *node) {
+ControlFlow Interpreter::interpretBlock(std::vector<std::unique_ptr<AstChild>> &body) {
+    for (auto &item: body) {
+        auto flow = this->interpretChild(item.get());
+
+        if (flow != ControlFlow::NORMAL)
+            return flow;
+    }
+
+    return ControlFlow::NORMAL;
+}
+
+ControlFlow Interpreter::interpretScopedBlock(std::vector<std::unique_ptr<AstChild>> &body) {
+    // new scope
+    this->current_scope = new Scope(this->current_scope);
+
+    auto flow = this->interpretBlock(body);
+
+    // back to the parent scope
+    this->popScope();
+
+    return flow;
+}
+
+ControlFlow Interpreter::interpretChild(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    // The samples which came due belong to the statement before
+    if (this->sampler != nullptr) {
+        if (Sampler::due())
+            this->takeSamples();
+
+        this->currentLine = node->line;
+    }
+
     // Interpret the child node
-    if (node->getIdentifier() == "Expression" || node->getIdentifier() == "IntegerLiteral" ||
-        node->getIdentifier() == "FloatLiteral" ||
-        node->getIdentifier() == "Unary" || node->getIdentifier() == "StringLiteral" ||
-        node->getIdentifier() == "VariableReference" || node->getIdentifier() == "FunctionCall") {
+    if (identifier == "Expression" || identifier == "IntegerLiteral" ||
+        identifier == "FloatLiteral" ||
+        identifier == "Unary" || identifier == "StringLiteral" ||
+        identifier == "VariableReference" || identifier == "FunctionCall" ||
+        identifier == "MemberAccess" || identifier == "MethodCall") {
         // We need to calculate the value of the expression
         // and store it in the value field of the node
         this->interpretExpression(node);
-    } else if (node->getIdentifier() == "ImportStatement") {
+    } else if (identifier == "ImportStatement") {
         importFile(node);
-    } else if (node->getIdentifier() == "VariableDefinition") {
-        auto realNode = dynamic_cast<VariableDefinitionNode *>(node);
+    } else if (identifier == "VariableDefinition") {
+        this->defineVariable(dynamic_cast<VariableDefinitionNode *>(node));
+    } else if (identifier == "VariableAssignment") {
+        this->assignVariable(dynamic_cast<VariableAssignmentNode *>(node));
+    } else if (identifier == "MemberAssignment") {
+        auto realNode = dynamic_cast<MemberAssignmentNode *>(node);
+        auto object = this->interpretExpression(realNode->object.get());
+
+        auto slot = this->resolveField(object, realNode->name, realNode->cache, realNode->line);
+        auto value = this->interpretExpression(realNode->value.get());
+        auto type = object.objectValue->shape->fieldTypes[slot];
+
+        if (!matchesType(value, type))
+            typeError(value, type, "Field " + realNode->name, realNode->line);
+
+        object.objectValue->slots[slot] = std::move(value);
+    } else if (identifier == "IfStatement") {
+        auto realNode = dynamic_cast<IfStatementNode *>(node);
 
-        this->current_scope->variables.emplace_back(realNode->name,
-                                                    this->interpretExpression(realNode->value.get()),
-                                                    realNode->constant);
-    } else if (node->getIdentifier() == "VariableAssignment") {
-        auto realNode = dynamic_cast<VariableAssignmentNode *>(node);
+        // We need to check if the condition is true
+        auto taken = this->interpretExpression(realNode->condition.get()).intValue == 1;
 
-        // We need to find the variable in the current scope
-        // Checking if the variable is defined in any scope above the current one
-        for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
-            for (auto &variable: scope->variables) {
-                if (variable.name == realNode->name) {
-                    if (variable.constant)
-                        throw std::runtime_error("Cannot assign to constant variable");
-
-                    variable.value = this->interpretExpression(realNode->value.get());
-                    return;
-                }
-            }
-        }
+        if (this->profile != nullptr && this->profile->recording)
+            this->profile->recordBranch(realNode, taken);
 
-        // If we get here, the variable is not defined
-        throw std::runtime_error("Variable " + realNode->name + " is not defined");
-    } else if (node->getIdentifier() == "IfStatement") {
-        auto realNode = dynamic_cast<IfStatementNode *>(node);
+        if (taken)
+            return this->interpretScopedBlock(realNode->thenBranch);
 
-        // new scope
-        this->current_scope = new Scope(this->current_scope);
+        return this->interpretScopedBlock(realNode->elseBranch);
+    } else if (identifier == "SwitchStatement") {
+        auto realNode = dynamic_cast<SwitchStatementNode *>(node);
+        auto caseNode = this->selectSwitchCase(realNode);
+
+        if (this->profile != nullptr && this->profile->recording)
+            this->profile->recordCase(realNode, caseNode);
+
+        if (caseNode == nullptr)
+            return ControlFlow::NORMAL;
+
+        return this->interpretScopedBlock(caseNode->body);
+    } else if (identifier == "WhileStatement") {
+        return this->interpretWhile(dynamic_cast<WhileStatementNode *>(node));
+    } else if (identifier == "ForStatement") {
+        return this->interpretFor(dynamic_cast<ForStatementNode *>(node));
+    } else if (identifier == "BreakStatement") {
+        return ControlFlow::BREAK;
+    } else if (identifier == "ContinueStatement") {
+        return ControlFlow::CONTINUE;
+    } else if (identifier == "ReturnStatement") {
+        this->interpretReturn(dynamic_cast<ReturnStatementNode *>(node));
+
+        return ControlFlow::RETURN;
+    } else if (identifier == "FunctionDefinition") {
+        this->defineFunction(dynamic_cast<FunctionDefinitionNode *>(node));
+    } else if (identifier == "ClassDefinition") {
+        this->defineClass(dynamic_cast<ClassDefinitionNode *>(node));
+    }
 
-        // We need to check if the condition is true
-        if (this->interpretExpression(realNode->condition.get()).intValue == 1) {
-            // If it is, we need to interpret the true branch
-            for (auto &item: realNode->thenBranch) {
-                this->interpretChild(item.get());
-            }
-        } else {
-            // If it is not, we need to interpret the false branch
-            for (auto &item: realNode->elseBranch) {
-                this->interpretChild(item.get());
-            }
-        }
+    return ControlFlow::NORMAL;
+}
 
-        // back to the parent scope
-        this->current_scope = this->current_scope->parent;
-    } else if (node->getIdentifier() == "SwitchStatement") {
-        auto realNode = dynamic_cast<SwitchStatementNode *>(node);
-        auto expr = this->interpretExpression(realNode->condition.get());
-        bool executed = false;
 
-        // Checking which case is the correct one
-        for (auto &caseNode: realNode->cases) {
-            if (caseNode->condition != nullptr) {
-                auto caseExpr = this->interpretExpression(caseNode->condition.get());
+void Interpreter::defineVariable(VariableDefinitionNode *node) {
+    auto value = this->interpretExpression(node->value.get());
 
-                if (caseExpr.getValue() == expr.getValue()) {
-                    if (executed)
-                        throw std::runtime_error("Multiple cases with the same value");
+    if (!matchesType(value, node->type))
+        typeError(value, node->type, "Variable " + node->name, node->line);
 
-                    executed = true;
+    this->current_scope->variables.emplace_back(node->name, std::move(value), node->constant, node->type);
+}
 
-                    // If it is, we need to interpret the case
-                    for (auto &item: caseNode->body) {
-                        // new scope
-                        this->current_scope = new Scope(this->current_scope);
+void Interpreter::assignVariable(VariableAssignmentNode *node) {
+    if (!node->indices.empty()) {
+        this->assignIndex(node);
+        return;
+    }
 
-                        this->interpretChild(item.get());
+    if (this->appendInPlace(node))
+        return;
 
-                        // back to the parent scope
-                        this->current_scope = this->current_scope->parent;
-                    }
+    // Checking if the variable is defined in any scope above the current one
+    auto variable = this->findVariable(node->name);
 
-                    return;
-                }
-            }
+    if (variable.value != nullptr) {
+        if (variable.constant)
+            throw std::runtime_error("Cannot assign to constant variable");
+
+        auto value = this->interpretExpression(node->value.get());
+
+        if (!matchesType(value, variable.type))
+            typeError(value, variable.type, "Variable " + node->name, node->line);
+
+        *variable.value = std::move(value);
+        return;
+    }
+
+    // If we get here, the variable is not defined
+    throw std::runtime_error("Variable " + node->name + " is not defined");
+}
+
+ControlFlow Interpreter::interpretWhile(WhileStatementNode *node) {
+    // Invariant values are computed again for every run of the loop
+    for (auto invariant: node->invariants)
+        invariant->cached = nullptr;
+
+    // new scope
+    this->current_scope = new Scope(this->current_scope);
+
+    jit::CompiledLoop *compiled = nullptr;
+
+    if (this->jit != nullptr && !this->jit->paused) {
+        compiled = &this->jit->loop(node);
+
+        if (this->runCompiledLoop(node, *compiled, false)) {
+            this->popScope();
+            return ControlFlow::NORMAL;
         }
+    }
 
-        if (!executed) {
-            // Default case
-            for (auto &caseNode: realNode->cases) {
-                if (caseNode->condition == nullptr) {
-                    if (executed)
-                        throw std::runtime_error("Multiple default cases");
+    auto flow = this->iterateWhile(node, compiled);
 
-                    executed = true;
+    // back to the parent scope
+    this->popScope();
 
-                    // new scope
-                    this->current_scope = new Scope(this->current_scope);
+    return flow == ControlFlow::RETURN ? flow : ControlFlow::NORMAL;
+}
 
-                    for (auto &item: caseNode->body) {
-                        this->interpretChild(item.get());
-                    }
+ControlFlow Interpreter::iterateWhile(WhileStatementNode *node, jit::CompiledLoop *compiled) {
+    auto flow = ControlFlow::NORMAL;
+    int64_t iterations = 0;
 
-                    // back to the parent scope
-                    this->current_scope = this->current_scope->parent;
-                }
-            }
+    // The condition is checked once per iteration
+    while (this->interpretExpression(node->condition.get()).intValue == 1) {
+        // Variables and functions defined in the body only live for one iteration
+        this->current_scope->variables.clear();
+        this->current_scope->functions.clear();
+
+        flow = this->interpretBlock(node->body);
+
+        if (flow == ControlFlow::BREAK || flow == ControlFlow::RETURN)
+            break;
+
+        if (this->profile != nullptr && this->profile->recording)
+            this->profile->recordIteration(node);
+
+        if (compiled == nullptr)
+            continue;
+
+        compiled->iterations++;
+
+        // A loop which gets hot while it runs goes on as compiled code from the next iteration
+        // (on-stack replacement). Tried again after as many iterations if the code bails out.
+        if (++iterations % this->jit->loopThreshold == 0 && this->runCompiledLoop(node, *compiled, true))
+            return ControlFlow::NORMAL;
+    }
+
+    return flow;
+}
+
+bool Interpreter::runCompiledLoop(WhileStatementNode *node, jit::CompiledLoop &compiled, bool replacement) {
+    auto isVariable = [this](const Symbol &name) { return this->findVariable(name).value != nullptr; };
+    auto resolve = [this](const Symbol &name) { return compilableFunction(this->findFunction(name)); };
+
+    if (!this->jit->prepare(compiled, node, isVariable, resolve))
+        return false;
+
+    // The same loop can run where other functions have the names it calls
+    for (auto &[name, definition]: compiled.calls) {
+        auto function = this->findFunction(name);
+
+        if (function == nullptr || function->definition != definition)
+            return false;
+    }
+
+    std::vector<BasicValue *> variables;
+    std::vector<jit::Slot> slots;
+
+    for (auto &name: compiled.variables) {
+        auto variable = this->findVariable(name);
+
+        // The interpreter reports assignments to constants
+        if (variable.value == nullptr || (variable.constant && compiled.assigned.contains(name)))
+            return false;
+
+        variables.push_back(variable.value);
+        slots.push_back(jit::Slot{variable.value->type, variable.value->intValue});
+    }
+
+    std::vector<BasicValue> initial;
+
+    if (this->jit->differential)
+        for (auto variable: variables)
+            initial.push_back(*variable);
+
+    this->jit->ran(compiled, replacement);
+
+    auto status = this->jit->run(compiled.entry, slots.data(), (int64_t) (this->maxStackDepth - this->frames.size()));
+
+    // The values at the start of the iteration which bailed out, or at the end of the loop. Values
+    // which weren't ints are never changed.
+    for (size_t i = 0; i < variables.size(); i++)
+        if (slots[i].tag == BasicValue::Type::INT)
+            *variables[i] = BasicValue(slots[i].value);
+
+    if (status != jit::FINISHED)
+        this->jit->deoptimized(compiled);
+
+    if (!this->jit->differential)
+        return status == jit::FINISHED;
+
+    // Finishing the loop in the interpreter, then running all of it again in the interpreter alone. The
+    // loop only changes its variables, so it can run twice.
+    std::vector<BasicValue> results;
+
+    this->jit->paused = true;
+
+    try {
+        if (status != jit::FINISHED)
+            this->iterateWhile(node, nullptr);
+
+        for (size_t i = 0; i < variables.size(); i++) {
+            results.push_back(*variables[i]);
+            *variables[i] = initial[i];
         }
-    } else if (node->getIdentifier() == "WhileStatement") {
-        auto realNode = dynamic_cast<WhileStatementNode *>(node);
-        auto condition = std::move(realNode->condition).get();
 
-        // new scope
-        this->current_scope = new Scope(this->current_scope);
+        this->current_scope->variables.clear();
+        this->iterateWhile(node, nullptr);
+    } catch (...) {
+        this->jit->paused = false;
+        throw;
+    }
 
-        // We need to check if the condition is true
-        while (this->interpretExpression(condition).intValue == 1) {
-            auto hasBreak = false;
-
-            // If it is, we need to interpret the true branch
-            for (auto &item: realNode->body) {
-                for (const auto &n: this->getAllNodesInNode(item.get(), true)) {
-                    if (n->getIdentifier() == "BreakStatement") {
-                        hasBreak = true;
-                        break;
-                    }
+    this->jit->paused = false;
 
-                    if (n->getIdentifier() == "ContinueStatement") {
-                        throw std::runtime_error("Continue statement is not supported in while loops");
-                    }
+    for (size_t i = 0; i < variables.size(); i++) {
+        auto &expected = *variables[i];
 
-                    if (n->getIdentifier() == "ReturnStatement") {
-                        this->current_scope = this->current_scope->parent;
-                        return;
-                    }
+        if (expected.type != results[i].type || expected.getValue() != results[i].getValue())
+            throw std::runtime_error("Compiled while loop (line " + std::to_string(node->line + 1) + ") left " +
+                                     compiled.variables[i] + " = " + results[i].getValue() +
+                                     ", the interpreter " + expected.getValue());
+    }
 
-                    if (!hasBreak)
-                        this->interpretChild(n);
+    return true;
+}
 
-                    if (this->interpretExpression(condition).intValue == 0)
-                        break;
-                }
-            }
+ControlFlow Interpreter::interpretFor(ForStatementNode *node) {
+    auto location = this->interpretExpression(node->location.get());
+
+    // Maps are iterated by their keys
+    if (location.type == BasicValue::Type::MAP)
+        location = BasicValue(std::make_shared<MapIterator>(location.mapValue));
+
+    if (location.type == BasicValue::Type::ARRAY)
+        location = BasicValue(std::make_shared<ArrayIterator>(location.arrayValue));
 
-            if (hasBreak)
+    if (location.type == BasicValue::Type::VECTOR)
+        location = BasicValue(std::make_shared<VectorIterator>(location.vectorValue));
+
+    if (location.type != BasicValue::Type::LIST && location.type != BasicValue::Type::ITERATOR)
+        throw std::runtime_error("For loop location is not a list");
+
+    for (auto invariant: node->invariants)
+        invariant->cached = nullptr;
+
+    // new scope, the loop variable is always the first variable in it
+    this->current_scope = new Scope(this->current_scope);
+
+    auto &variables = this->current_scope->variables;
+    variables.emplace_back(node->initializer, BasicValue(0), false);
+
+    auto flow = ControlFlow::NORMAL;
+    size_t listIndex = 0;
+    BasicValue item;
+
+    while (true) {
+        // Iterators are pulled one element at a time, so they never have to be loaded completely
+        if (location.type == BasicValue::Type::ITERATOR) {
+            if (!location.iteratorValue->next(item))
+                break;
+        } else {
+            if (listIndex >= location.listValue->size())
                 break;
+
+            item = (*location.listValue)[listIndex++];
         }
 
-        // back to the parent scope
-        this->current_scope = this->current_scope->parent;
-    } else if (node->getIdentifier() == "ForStatement") {
-        auto realNode = dynamic_cast<ForStatementNode *>(node);
-        auto location = this->interpretExpression(realNode->location.get());
+        // Variables and functions defined in the body only live for one iteration
+        variables.erase(variables.begin() + 1, variables.end());
+        this->current_scope->functions.clear();
 
-        if (location.type != BasicValue::Type::LIST)
-            throw std::runtime_error("For loop location is not a list");
+        variables[0].value = item;
 
-        auto list = location.listValue;
+        flow = this->interpretBlock(node->body);
 
-        // new scope
-        this->current_scope = new Scope(this->current_scope);
+        if (flow == ControlFlow::BREAK || flow == ControlFlow::RETURN)
+            break;
+    }
 
-        this->current_scope->variables.emplace_back(realNode->initializer, BasicValue(0), false);
+    // back to the parent scope
+    this->popScope();
 
-        auto hasBreak = false;
+    return flow == ControlFlow::RETURN ? flow : ControlFlow::NORMAL;
+}
 
-        for (auto &item: list) {
-            for (auto &variable: this->current_scope->variables) {
-                if (variable.name == realNode->initializer) {
-                    variable.value = item;
+void Interpreter::defineFunction(FunctionDefinitionNode *node) {
+    auto &function = this->current_scope->functions.emplace_back(node->name, &node->parameters, &node->body,
+                                                                 this->current_scope, node->isExternal);
+    function.parameterTypes = &node->parameterTypes;
+    function.returnType = node->returnType;
+    function.definition = node;
+
+    if (!node->memoized)
+        return;
+
+    if (node->isExternal)
+        throw std::runtime_error("External function " + node->name + " can't be memoized");
+
+    // Every run of the definition gets its own cache, a function defined in a function may see different
+    // variables each time. Their counts are added up for the definition.
+    for (auto &[definition, counts]: this->memoCounts) {
+        if (definition == node) {
+            function.memo = std::make_shared<MemoCache>(counts);
+            return;
+        }
+    }
 
-                    break;
-                }
-            }
+    this->memoCounts.emplace_back(node, std::make_shared<MemoCache::Counts>());
+    function.memo = std::make_shared<MemoCache>(this->memoCounts.back().second);
+}
 
-            auto hasContinue = false;
+void Interpreter::defineClass(ClassDefinitionNode *node) {
+    // We need to be in the highest scope
+    if (this->current_scope->parent != nullptr) {
+        throw std::runtime_error("Class definition must be in the highest scope");
+    }
 
-            for (auto &scope: realNode->body) {
-                // We need to go through everything. even if-statements in if-statements
-                for (const auto &n: this->getAllNodesInNode(scope.get(), true)) {
-                    if (n->getIdentifier() == "BreakStatement")
-                        hasBreak = true;
+    // Checking if the body only contains: function definitions, variable definitions
+    for (const auto &item: node->body) {
+        if (item->getIdentifier() != "FunctionDefinition" && item->getIdentifier() != "VariableDefinition") {
+            throw std::runtime_error("Class definition can only contain function definitions and variable definitions");
+        }
+    }
 
-                    if (n->getIdentifier() == "ContinueStatement")
-                        hasContinue = true;
+    // Adding to the current scope
+    auto scope = new Scope(this->current_scope);
+    auto shape = std::make_shared<Shape>(node);
+    shape->scope = scope;
 
-                    if (!hasBreak && !hasContinue)
-                        this->interpretChild(n);
-                }
-            }
-        }
+    this->current_scope->classes.emplace_back(node->name, &node->body, &node->constructor, scope,
+                                              shape);
+}
+
+void Interpreter::interpretReturn(ReturnStatementNode *node) {
+    this->returnValue = BasicValue();
+
+    if (node->value == nullptr)
+        return;
+
+    // `return f(...)` in a function: f runs in place of the current call instead of inside of it
+    if (node->tailCall && !this->frames.empty() && this->frames.back().tailCalls) {
+        auto call = dynamic_cast<FunctionCallNode *>(node->value.get());
+        auto function = this->findFunction(call->name);
 
-        // back to the parent scope
-        this->current_scope = this->current_scope->parent;
-    } else if (node->getIdentifier() == "FunctionDefinition") {
-        auto realNode = dynamic_cast<FunctionDefinitionNode *>(node);
+        if (function != nullptr && !function->isExternal && function->memo == nullptr &&
+            !this->definedInFrame(*function)) {
+            std::vector<BasicValue> arguments;
 
-        // Adding to the current scope
-        this->current_scope->functions.emplace_back(realNode->name, &realNode->parameters, &realNode->body,
-                                                    this->current_scope, realNode->isExternal);
-    } else if (node->getIdentifier() == "ClassDefinition") {
-        auto realNode = dynamic_cast<ClassDefinitionNode *>(node);
+            for (auto &argument: call->args)
+                arguments.push_back(this->interpretExpression(argument.get()));
 
-        // We need to be in the highest scope
-        if (this->current_scope->parent != nullptr) {
-            throw std::runtime_error("Class definition must be in the highest scope");
+            this->tailCall.emplace(TailCall{*function, std::move(arguments)});
+            return;
         }
+    }
+
+    this->returnValue = this->interpretExpression(node->value.get());
+}
+
+// Appending to a string which isn't shared with another value happens in place, so the
+// intermediate results of `a + b + c` aren't copied again
+BasicValue appendText(BasicValue left, std::string_view text) {
+    left.stringValue.mutate() += text;
+
+    return left;
+}
+
+// Int operators without the big integer fallback. Returns false if the result doesn't fit into
+// 64 bits or for a division by zero, the generic path handles those.
+bool applyIntOperator(int64_t left, int64_t right, Operator op, int64_t &result) {
+    switch (op) {
+        case Operator::ADD:
+            return !__builtin_add_overflow(left, right, &result);
+        case Operator::SUBTRACT:
+            return !__builtin_sub_overflow(left, right, &result);
+        case Operator::MULTIPLY:
+            return !__builtin_mul_overflow(left, right, &result);
+        case Operator::DIVIDE:
+        case Operator::MODULO:
+            if (right == 0 || (left == INT64_MIN && right == -1)) return false;
+            result = op == Operator::DIVIDE ? left / right : left % right;
+            return true;
+        case Operator::EQUAL: result = left == right; return true;
+        case Operator::NOT_EQUAL: result = left != right; return true;
+        case Operator::LESS: result = left < right; return true;
+        case Operator::GREATER: result = left > right; return true;
+        case Operator::LESS_EQUAL: result = left <= right; return true;
+        case Operator::GREATER_EQUAL: result = left >= right; return true;
+        case Operator::AND: result = left && right; return true;
+        case Operator::OR: result = left || right; return true;
+        default:
+            return false;
+    }
+}
+
+// Float operators, comparisons give 0 or 1. Returns false for operators floats don't have.
+bool applyFloatOperator(double left, double right, Operator op, double &result) {
+    switch (op) {
+        case Operator::ADD: result = left + right; return true;
+        case Operator::SUBTRACT: result = left - right; return true;
+        case Operator::MULTIPLY: result = left * right; return true;
+        case Operator::DIVIDE: result = left / right; return true;
+        case Operator::EQUAL: result = left == right; return true;
+        case Operator::NOT_EQUAL: result = left != right; return true;
+        case Operator::LESS: result = left < right; return true;
+        case Operator::GREATER: result = left > right; return true;
+        case Operator::LESS_EQUAL: result = left <= right; return true;
+        case Operator::GREATER_EQUAL: result = left >= right; return true;
+        default:
+            return false;
+    }
+}
 
-        // Checking if the body only contains: function definitions, variable definitions
-        for (const auto &item: realNode->body) {
-            if (item->getIdentifier() != "FunctionDefinition" && item->getIdentifier() != "VariableDefinition") {
-                throw std::runtime_error("Class definition can only contain function definitions and variable definitions");
+// Arithmetic on numbers which don't fit into 64 bits. Results which fit again become ints.
+BasicValue applyBigOperator(const BigInt &left, const BigInt &right, const std::string &op, int line) {
+    if (op == "+") return bigIntValue(left.add(right));
+    else if (op == "-") return bigIntValue(left.subtract(right));
+    else if (op == "*") return bigIntValue(left.multiply(right));
+    else if (op == "/" || op == "%") {
+        if (right.isZero())
+            throw std::runtime_error("Division by zero, line: " + std::to_string(line + 1));
+
+        return bigIntValue(op == "/" ? left.divide(right) : left.remainder(right));
+    } else if (op == "==") return BasicValue(left.compare(right) == 0);
+    else if (op == "!=") return BasicValue(left.compare(right) != 0);
+    else if (op == "<") return BasicValue(left.compare(right) < 0);
+    else if (op == ">") return BasicValue(left.compare(right) > 0);
+    else if (op == "<=") return BasicValue(left.compare(right) <= 0);
+    else if (op == ">=") return BasicValue(left.compare(right) >= 0);
+    else if (op == "&&") return BasicValue(!left.isZero() && !right.isZero());
+    else if (op == "||") return BasicValue(!left.isZero() || !right.isZero());
+    else throw std::runtime_error("Unknown operator " + op);
+}
+
+BasicValue Interpreter::applyOperator(BasicValue left, const BasicValue &right, const std::string &op, int line) {
+    if (left.type == BasicValue::Type::INT && right.type == BasicValue::Type::INT) {
+        int64_t result;
+
+        // Checked arithmetic, only results which don't fit into 64 bits take the big integer path
+        if (op == "+") {
+            if (!__builtin_add_overflow(left.intValue, right.intValue, &result)) return BasicValue(result);
+        } else if (op == "-") {
+            if (!__builtin_sub_overflow(left.intValue, right.intValue, &result)) return BasicValue(result);
+        } else if (op == "*") {
+            if (!__builtin_mul_overflow(left.intValue, right.intValue, &result)) return BasicValue(result);
+        } else if (op == "/" || op == "%") {
+            if (right.intValue == 0)
+                throw std::runtime_error("Division by zero, line: " + std::to_string(line + 1));
+
+            // The smallest int divided by -1 is the only division which overflows
+            if (left.intValue != INT64_MIN || right.intValue != -1)
+                return BasicValue(op == "/" ? left.intValue / right.intValue : left.intValue % right.intValue);
+        } else if (op == "==") return BasicValue(left.intValue == right.intValue);
+        else if (op == "!=") return BasicValue(left.intValue != right.intValue);
+        else if (op == "<") return BasicValue(left.intValue < right.intValue);
+        else if (op == ">") return BasicValue(left.intValue > right.intValue);
+        else if (op == "<=") return BasicValue(left.intValue <= right.intValue);
+        else if (op == ">=") return BasicValue(left.intValue >= right.intValue);
+        else if (op == "&&") return BasicValue(left.intValue && right.intValue);
+        else if (op == "||") return BasicValue(left.intValue || right.intValue);
+        else throw std::runtime_error("Unknown operator " + op);
+
+        return applyBigOperator(BigInt(left.intValue), BigInt(right.intValue), op, line);
+    } else if ((left.type == BasicValue::Type::BIGINT || left.type == BasicValue::Type::INT) &&
+               (right.type == BasicValue::Type::BIGINT || right.type == BasicValue::Type::INT)) {
+        return applyBigOperator(toBigInt(left), toBigInt(right), op, line);
+    } else if (left.type == BasicValue::Type::BIGINT && right.type == BasicValue::Type::STRING) {
+        if (op == "+") return BasicValue(left.getValue() + *right.stringValue);
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::BIGINT) {
+        if (op == "+") return appendText(std::move(left), right.getValue());
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::STRING) {
+        if (op == "+") return appendText(std::move(left), right.stringValue.view());
+        else if (op == "==") return BasicValue(left.stringValue.view() == right.stringValue.view());
+        else if (op == "!=") return BasicValue(left.stringValue.view() != right.stringValue.view());
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::INT && right.type == BasicValue::Type::STRING) {
+        if (op == "+") return BasicValue(std::to_string(left.intValue) + *right.stringValue);
+        else if (op == "==") return BasicValue(std::to_string(left.intValue) == *right.stringValue);
+        else if (op == "!=") return BasicValue(std::to_string(left.intValue) != *right.stringValue);
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::INT) {
+        if (op == "+") return appendText(std::move(left), std::to_string(right.intValue));
+        else if (op == "==") return BasicValue(*left.stringValue == std::to_string(right.intValue));
+        else if (op == "!=") return BasicValue(*left.stringValue != std::to_string(right.intValue));
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::FLOAT && right.type == BasicValue::Type::FLOAT) {
+        if (op == "+") return BasicValue(left.floatValue + right.floatValue);
+        else if (op == "-") return BasicValue(left.floatValue - right.floatValue);
+        else if (op == "*") return BasicValue(left.floatValue * right.floatValue);
+        else if (op == "/") return BasicValue(left.floatValue / right.floatValue);
+        else if (op == "==") return BasicValue(left.floatValue == right.floatValue);
+        else if (op == "!=") return BasicValue(left.floatValue != right.floatValue);
+        else if (op == "<") return BasicValue(left.floatValue < right.floatValue);
+        else if (op == ">") return BasicValue(left.floatValue > right.floatValue);
+        else if (op == "<=") return BasicValue(left.floatValue <= right.floatValue);
+        else if (op == ">=") return BasicValue(left.floatValue >= right.floatValue);
+        else throw std::runtime_error("Unknown operator " + op);
+    } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::FLOAT) {
+        if (op == "+") return appendText(std::move(left), std::to_string(right.floatValue));
+        else if (op == "==") return BasicValue(*left.stringValue == std::to_string(right.floatValue));
+        else if (op == "!=") return BasicValue(*left.stringValue != std::to_string(right.floatValue));
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::FLOAT && right.type == BasicValue::Type::STRING) {
+        if (op == "+") return BasicValue(std::to_string(left.floatValue) + *right.stringValue);
+        else if (op == "==") return BasicValue(std::to_string(left.floatValue) == *right.stringValue);
+        else if (op == "!=") return BasicValue(std::to_string(left.floatValue) != *right.stringValue);
+        else throw std::runtime_error("Cannot divide, multiply two strings");
+    } else if (left.type == BasicValue::Type::LIST && right.type == BasicValue::Type::LIST) {
+        if (op == "==") {
+            // Comparing all elements
+            if (left.listValue->size() != right.listValue->size()) return BasicValue(false);
+
+            for (int i = 0; i < left.listValue->size(); i++) {
+                if (left.type != right.type) return BasicValue(false);
+
+                switch (left.type) {
+                    case BasicValue::Type::INT:
+                        if ((*left.listValue)[i].intValue != (*right.listValue)[i].intValue) return BasicValue(false);
+                        break;
+                    case BasicValue::Type::FLOAT:
+                        if ((*left.listValue)[i].floatValue != (*right.listValue)[i].floatValue) return BasicValue(false);
+                        break;
+                    case BasicValue::Type::STRING:
+                        if (*(*left.listValue)[i].stringValue != *(*right.listValue)[i].stringValue)
+                            return BasicValue(false);
+                        break;
+                    case BasicValue::Type::LIST:
+                        throw std::runtime_error("Unimplemented");
+                    case BasicValue::VOID:
+                        return BasicValue(false);
+                    default:
+                        throw std::runtime_error("Unimplemented");
+                }
             }
-        }
 
-        // Adding to the current scope
-        auto scope = new Scope(this->current_scope);
-        this->current_scope->classes.emplace_back(realNode->name, &realNode->body, &realNode->constructor, scope);
+            return BasicValue(true);
+        } else throw std::runtime_error("Unknown operator " + op);
     }
+
+    throw std::runtime_error(
+            "Cannot perform math operation on non-integer values, line: " + std::to_string(line) +
+            ". Values: " + std::to_string(left.type) + " and " + std::to_string(right.type));
 }
 
 BasicValue Interpreter::interpretExpression(AstChild *node) {
-    if (node->getIdentifier() == "Expression") {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "Expression") {
         auto *realNode = dynamic_cast<ExpressionNode *>(node);
 
+        if (realNode->unboxed == StaticType::INT) {
+            int64_t result;
+
+            if (this->evaluateInt(realNode, result))
+                return BasicValue(result);
+        } else if (realNode->unboxed == StaticType::FLOAT) {
+            double result;
+
+            if (this->evaluateFloat(realNode, result))
+                return BasicValue(result);
+        }
+
         auto left = this->interpretExpression(realNode->left.get());
         auto right = this->interpretExpression(realNode->right.get());
-        auto op = realNode->op;
-
-        if (left.type == BasicValue::Type::INT && right.type == BasicValue::Type::INT) {
-            if (op == "+") return BasicValue(left.intValue + right.intValue);
-            else if (op == "-") return BasicValue(left.intValue - right.intValue);
-            else if (op == "*") return BasicValue(left.intValue * right.intValue);
-            else if (op == "/") return BasicValue(left.intValue / right.intValue);
-            else if (op == "%") return BasicValue(left.intValue % right.intValue);
-            else if (op == "==") return BasicValue(left.intValue == right.intValue);
-            else if (op == "!=") return BasicValue(left.intValue != right.intValue);
-            else if (op == "<") return BasicValue(left.intValue < right.intValue);
-            else if (op == ">") return BasicValue(left.intValue > right.intValue);
-            else if (op == "<=") return BasicValue(left.intValue <= right.intValue);
-            else if (op == ">=") return BasicValue(left.intValue >= right.intValue);
-            else if (op == "&&") return BasicValue(left.intValue && right.intValue);
-            else if (op == "||") return BasicValue(left.intValue || right.intValue);
-            else throw std::runtime_error("Unknown operator " + op);
-        } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::STRING) {
-            if (op == "+") return BasicValue(left.stringValue + right.stringValue);
-            else if (op == "==") return BasicValue(left.stringValue == right.stringValue);
-            else if (op == "!=") return BasicValue(left.stringValue != right.stringValue);
-            else throw std::runtime_error("Cannot divide, multiply two strings");
-        } else if (left.type == BasicValue::Type::INT && right.type == BasicValue::Type::STRING) {
-            if (op == "+") return BasicValue(std::to_string(left.intValue) + right.stringValue);
-            else if (op == "==") return BasicValue(std::to_string(left.intValue) == right.stringValue);
-            else if (op == "!=") return BasicValue(std::to_string(left.intValue) != right.stringValue);
-            else throw std::runtime_error("Cannot divide, multiply two strings");
-        } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::INT) {
-            if (op == "+") return BasicValue(left.stringValue + std::to_string(right.intValue));
-            else if (op == "==") return BasicValue(left.stringValue == std::to_string(right.intValue));
-            else if (op == "!=") return BasicValue(left.stringValue != std::to_string(right.intValue));
-            else throw std::runtime_error("Cannot divide, multiply two strings");
-        } else if (left.type == BasicValue::Type::FLOAT && right.type == BasicValue::Type::FLOAT) {
-            if (op == "+") return BasicValue(left.floatValue + right.floatValue);
-            else if (op == "-") return BasicValue(left.floatValue - right.floatValue);
-            else if (op == "*") return BasicValue(left.floatValue * right.floatValue);
-            else if (op == "/") return BasicValue(left.floatValue / right.floatValue);
-            else if (op == "==") return BasicValue(left.floatValue == right.floatValue);
-            else if (op == "!=") return BasicValue(left.floatValue != right.floatValue);
-            else if (op == "<") return BasicValue(left.floatValue < right.floatValue);
-            else if (op == ">") return BasicValue(left.floatValue > right.floatValue);
-            else if (op == "<=") return BasicValue(left.floatValue <= right.floatValue);
-            else if (op == ">=") return BasicValue(left.floatValue >= right.floatValue);
-            else throw std::runtime_error("Unknown operator " + op);
-        } else if (left.type == BasicValue::Type::STRING && right.type == BasicValue::Type::FLOAT) {
-            if (op == "+") return BasicValue(left.stringValue + std::to_string(right.floatValue));
-            else if (op == "==") return BasicValue(left.stringValue == std::to_string(right.floatValue));
-            else if (op == "!=") return BasicValue(left.stringValue != std::to_string(right.floatValue));
-            else throw std::runtime_error("Cannot divide, multiply two strings");
-        } else if (left.type == BasicValue::Type::FLOAT && right.type == BasicValue::Type::STRING) {
-            if (op == "+") return BasicValue(std::to_string(left.floatValue) + right.stringValue);
-            else if (op == "==") return BasicValue(std::to_string(left.floatValue) == right.stringValue);
-            else if (op == "!=") return BasicValue(std::to_string(left.floatValue) != right.stringValue);
-            else throw std::runtime_error("Cannot divide, multiply two strings");
-        } else if (left.type == BasicValue::Type::LIST && right.type == BasicValue::Type::LIST) {
-            if (op == "==") {
-                // Comparing all elements
-                if (left.listValue.size() != right.listValue.size()) return BasicValue(false);
-
-                for (int i = 0; i < left.listValue.size(); i++) {
-                    if (left.type != right.type) return BasicValue(false);
-
-                    switch (left.type) {
-                        case BasicValue::Type::INT:
-                            if (left.listValue[i].intValue != right.listValue[i].intValue) return BasicValue(false);
-                            break;
-                        case BasicValue::Type::FLOAT:
-                            if (left.listValue[i].floatValue != right.listValue[i].floatValue) return BasicValue(false);
-                            break;
-                        case BasicValue::Type::STRING:
-                            if (left.listValue[i].stringValue != right.listValue[i].stringValue)
-                                return BasicValue(false);
-                            break;
-                        case BasicValue::Type::LIST:
-                            throw std::runtime_error("Unimplemented");
-                        case BasicValue::VOID:
-                            return BasicValue(false);
-                    }
-                }
 
-                return BasicValue(true);
-            } else throw std::runtime_error("Unknown operator " + op);
+        // Specialized expressions are recorded as well, a profile written from a profile keeps them
+        if (this->profile != nullptr && this->profile->recording)
+            this->profile->recordOperands(realNode, left.type, right.type);
+
+        // The type inference found that both operands are always ints or floats. The tags are still
+        // compared once, imported files can replace builtins the inference relies on.
+        if (realNode->operands == StaticType::INT && left.type == BasicValue::Type::INT &&
+            right.type == BasicValue::Type::INT) {
+            int64_t result;
+
+            if (applyIntOperator(left.intValue, right.intValue, realNode->opcode, result))
+                return BasicValue(result);
+        } else if (realNode->operands == StaticType::FLOAT && left.type == BasicValue::Type::FLOAT &&
+                   right.type == BasicValue::Type::FLOAT) {
+            double result;
+
+            if (applyFloatOperator(left.floatValue, right.floatValue, realNode->opcode, result))
+                return isComparison(realNode->opcode) ? BasicValue(result != 0.0) : BasicValue(result);
         }
 
-        throw std::runtime_error(
-                "Cannot perform math operation on non-integer values, line: " + std::to_string(realNode->line) +
-                ". Values: " + std::to_string(left.type) + " and " + std::to_string(right.type));
-    } else if (node->getIdentifier() == "IntegerLiteral") {
+        return this->applyOperator(std::move(left), right, realNode->op, realNode->line);
+    } else if (identifier == "IntegerLiteral") {
         auto realNode = dynamic_cast<IntegerLiteralNode *>(node);
+
+        if (!realNode->digits.empty())
+            return bigIntValue(BigInt::parse(realNode->digits));
+
         return BasicValue(realNode->value);
-    } else if (node->getIdentifier() == "FloatLiteral") {
+    } else if (identifier == "FloatLiteral") {
         auto realNode = dynamic_cast<FloatLiteralNode *>(node);
         return BasicValue(realNode->value);
-    } else if (node->getIdentifier() == "StringLiteral") {
+    } else if (identifier == "StringLiteral") {
         auto realNode = dynamic_cast<StringLiteralNode *>(node);
-        return BasicValue(realNode->value);
-    } else if (node->getIdentifier() == "Unary") {
+        return BasicValue(SharedString(realNode->buffer, realNode->value.hash()));
+    } else if (identifier == "Unary") {
         auto realNode = dynamic_cast<UnaryExpressionNode *>(node);
         BasicValue value = this->interpretExpression(realNode->child.get());
 
-        if (value.type == BasicValue::Type::INT) {
-            if (realNode->op == "-")
-                return BasicValue(-value.intValue);
-
-            return BasicValue(value.intValue);
-        } else throw std::runtime_error("Cannot perform unary operation on non-integer values");
-    } else if (node->getIdentifier() == "VariableReference") {
+        if (realNode->op != "-")
+            return value;
+
+        if (value.type == BasicValue::Type::INT && value.intValue != INT64_MIN)
+            return BasicValue(-value.intValue);
+        else if (value.type == BasicValue::Type::INT || value.type == BasicValue::Type::BIGINT)
+            return bigIntValue(toBigInt(value).negate());
+        else if (value.type == BasicValue::Type::FLOAT)
+            return BasicValue(-value.floatValue);
+        else throw std::runtime_error("Cannot perform unary operation on non-numeric values");
+    } else if (identifier == "VariableReference") {
         auto realNode = dynamic_cast<VariableReferenceNode *>(node);
 
         // Checking if the variable is defined in any scope above the current one
-        for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
-            for (auto &variable: scope->variables) {
-                if (variable.name == realNode->name) {
-                    return variable.value;
-                }
-            }
-        }
+        auto variable = this->findVariable(realNode->name);
+
+        if (variable.value != nullptr)
+            return *variable.value;
 
         throw std::runtime_error(
                 "Variable " + realNode->name + " is not defined, line: " + std::to_string(realNode->line + 1));
-    } else if (node->getIdentifier() == "FunctionCall") {
-        // This can also be the instantiation of a class
-        auto realNode = dynamic_cast<FunctionCallNode *>(node);
-
-        // Searching in the all the scopes above the current scope
-        for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
-            for (const auto &item: scope->functions) {
-                if (item.name == realNode->name) {
-                    // Build-in
-                    if (item.isExternal && function_exists(realNode->name)) {
-                        // Mapping the arguments, so all arguments are BasicValues
-                        std::vector<BasicValue> args;
-
-                        for (auto &arg: realNode->args)
-                            args.push_back(this->interpretExpression(arg.get()));
-
-                        return executeFunction(realNode->name, args);
-                    }
-
-                    // Checking the arguments
-                    if (item.parameters->size() != realNode->args.size())
-                        throw std::runtime_error("Wrong number of arguments");
-
-                    // Saving the current scope
-                    auto old_scope = this->current_scope;
-
-                    // new scope
-                    auto new_scope = new Scope(item.scope);
-
-                    // We need to add the parameters to the scope
-                    auto index = 0;
-
-                    for (auto &parameter: *item.parameters) {
-                        new_scope->variables.emplace_back(parameter,
-                                                          this->interpretExpression(
-                                                                  realNode->args[index].get()), false);
-                        index++;
-                    }
-
-                    this->current_scope = new_scope;
-
-                    // Interpreting
-                    for (const auto &bodyNode: *item.body) {
-                        for (auto &nItem: this->getAllNodesInNode(bodyNode.get())) {
-                            if (nItem->getIdentifier() == "ReturnStatement") {
-                                auto returnNode = dynamic_cast<ReturnStatementNode *>(nItem);
-
-                                if (returnNode->value != nullptr) {
-                                    auto value = this->interpretExpression(returnNode->value.get());
-
-                                    // Returning the value
-                                    this->current_scope = old_scope;
-                                    return value;
-                                }
-
-                                // Returning the value
-                                this->current_scope = old_scope;
-                                return BasicValue();
-                            }
-
-                            this->interpretChild(nItem);
-                        }
-                    }
-
-                    // back to the parent scope
-                    this->current_scope = old_scope;
-
-                    return BasicValue();
-                }
-            }
+    } else if (identifier == "FunctionCall") {
+        return this->interpretCall(dynamic_cast<FunctionCallNode *>(node));
+    } else if (identifier == "InlinedCall") {
+        auto realNode = dynamic_cast<InlinedCallNode *>(node);
+
+        if (this->resolveInlinedCall(realNode))
+            return this->interpretExpression(realNode->body.get());
+
+        return this->interpretCall(realNode->call.get());
+    } else if (identifier == "Invariant") {
+        return this->interpretInvariant(dynamic_cast<InvariantNode *>(node));
+    } else if (identifier == "Array") {
+        // Defining an array
+        auto realNode = dynamic_cast<ArrayNode *>(node);
+
+        std::vector<BasicValue> values;
+
+        for (auto &value: realNode->elements)
+            values.push_back(this->interpretExpression(value.get()));
+
+        return BasicValue(values);
+    } else if (identifier == "MemberAccess") {
+        auto realNode = dynamic_cast<MemberAccessNode *>(node);
+        auto object = this->interpretExpression(realNode->object.get());
+
+        auto slot = this->resolveField(object, realNode->name, realNode->cache, realNode->line);
+
+        return object.objectValue->slots[slot];
+    } else if (identifier == "MethodCall") {
+        return this->callMethod(dynamic_cast<MethodCallNode *>(node));
+    } else if (identifier == "Map") {
+        // Defining a map
+        auto realNode = dynamic_cast<MapNode *>(node);
+
+        auto map = std::make_shared<ValueMap>();
+
+        for (auto &entry: realNode->entries)
+            map->set(this->interpretExpression(entry.first.get()), this->interpretExpression(entry.second.get()));
+
+        return BasicValue(map);
+    } else if (identifier == "ArrayAccess") {
+        return this->interpretIndex(dynamic_cast<ArrayAccessNode *>(node));
+    }
+
+    throw std::runtime_error("Cannot interpret expression: " + identifier);
+}
+
+bool Interpreter::evaluateInt(AstChild *node, int64_t &result) {
+    // Dispatching on the class of the node, comparing the identifiers would cost more than the operators
+    if (auto expression = dynamic_cast<ExpressionNode *>(node)) {
+        // Comparing floats
+        if (expression->operands == StaticType::FLOAT) {
+            double left, right, compared;
+
+            if (!this->evaluateFloat(expression->left.get(), left) ||
+                !this->evaluateFloat(expression->right.get(), right) ||
+                !applyFloatOperator(left, right, expression->opcode, compared))
+                return false;
+
+            result = compared != 0.0;
+            return true;
         }
 
-        // Checking if we might be instantiating a class
-        for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
-            for (const auto &item: scope->classes) {
-                if (item.name == realNode->name) {
-                    // Checking the constructor
-                    if (realNode->args.size() != item.constructor->size())
-                        throw std::runtime_error("Wrong number of arguments");
+        int64_t left, right;
 
-                    auto instance = BasicValue(item.name, true);
+        return this->evaluateInt(expression->left.get(), left) && this->evaluateInt(expression->right.get(), right) &&
+               applyIntOperator(left, right, expression->opcode, result);
+    }
 
-                    // Saving the current scope
-                    auto old_scope = this->current_scope;
+    if (auto reference = dynamic_cast<VariableReferenceNode *>(node)) {
+        auto variable = this->findVariable(reference->name).value;
 
-                    // new scope
-                    auto new_scope = new Scope();
+        if (variable == nullptr || variable->type != BasicValue::Type::INT)
+            return false;
 
-                    // We need to add the parameters to the scope
-                    auto index = 0;
+        result = variable->intValue;
+        return true;
+    }
 
-                    for (auto &parameter: *item.constructor) {
-                        new_scope->variables.emplace_back(parameter,
-                                                          this->interpretExpression(
-                                                                  realNode->args[index].get()), false);
-                        index++;
-                    }
+    if (auto literal = dynamic_cast<IntegerLiteralNode *>(node)) {
+        result = literal->value;
+        return true;
+    }
 
-                    this->current_scope = new_scope;
+    if (auto unary = dynamic_cast<UnaryExpressionNode *>(node)) {
+        int64_t value;
 
-                    // Interpreting
-                    for (auto &bodyNode: *item.body) {
-                        this->interpretChild(bodyNode.get());
-                    }
+        if (!this->evaluateInt(unary->child.get(), value) || value == INT64_MIN)
+            return false;
 
-                    // back to the parent scope
-                    this->current_scope = old_scope;
+        result = -value;
+        return true;
+    }
 
-                    return instance;
-                }
-            }
+    if (auto invariant = dynamic_cast<InvariantNode *>(node)) {
+        auto value = this->interpretInvariant(invariant);
+
+        if (value.type != BasicValue::Type::INT)
+            return false;
+
+        result = value.intValue;
+        return true;
+    }
+
+    if (auto inlined = dynamic_cast<InlinedCallNode *>(node))
+        return this->resolveInlinedCall(inlined) && this->evaluateInt(inlined->body.get(), result);
+
+    return false;
+}
+
+bool Interpreter::evaluateFloat(AstChild *node, double &result) {
+    if (auto expression = dynamic_cast<ExpressionNode *>(node)) {
+        double left, right;
+
+        return this->evaluateFloat(expression->left.get(), left) &&
+               this->evaluateFloat(expression->right.get(), right) &&
+               applyFloatOperator(left, right, expression->opcode, result);
+    }
+
+    if (auto reference = dynamic_cast<VariableReferenceNode *>(node)) {
+        auto variable = this->findVariable(reference->name).value;
+
+        if (variable == nullptr || variable->type != BasicValue::Type::FLOAT)
+            return false;
+
+        result = variable->floatValue;
+        return true;
+    }
+
+    if (auto literal = dynamic_cast<FloatLiteralNode *>(node)) {
+        result = literal->value;
+        return true;
+    }
+
+    if (auto unary = dynamic_cast<UnaryExpressionNode *>(node)) {
+        double value;
+
+        if (!this->evaluateFloat(unary->child.get(), value))
+            return false;
+
+        result = -value;
+        return true;
+    }
+
+    if (auto invariant = dynamic_cast<InvariantNode *>(node)) {
+        auto value = this->interpretInvariant(invariant);
+
+        if (value.type != BasicValue::Type::FLOAT)
+            return false;
+
+        result = value.floatValue;
+        return true;
+    }
+
+    if (auto inlined = dynamic_cast<InlinedCallNode *>(node))
+        return this->resolveInlinedCall(inlined) && this->evaluateFloat(inlined->body.get(), result);
+
+    return false;
+}
+
+bool Interpreter::resolveInlinedCall(InlinedCallNode *node) {
+    if (node->state == InlinedCallNode::UNCHECKED) {
+        auto function = this->findFunction(node->call->name);
+
+        node->state = function != nullptr && function->body == &node->function->body ? InlinedCallNode::INLINED
+                                                                                       : InlinedCallNode::CALLED;
+    }
+
+    return node->state == InlinedCallNode::INLINED;
+}
+
+BasicValue Interpreter::interpretInvariant(InvariantNode *node) {
+    if (node->cached != nullptr)
+        return *node->cached;
+
+    // The optimizer only knows the builtins by their names, an imported file could define a function
+    // with the same name
+    if (!node->checked) {
+        node->checked = true;
+        node->cacheable = true;
+
+        for (auto &name: node->builtins) {
+            auto function = this->findFunction(name);
+
+            if (function == nullptr || !function->isExternal || !function_exists(name))
+                node->cacheable = false;
         }
+    }
 
-        throw std::runtime_error("Function/Class " + realNode->name + " is not defined");
-    } else if (node->getIdentifier() == "Array") {
-        // Defining an array
-        auto realNode = dynamic_cast<ArrayNode *>(node);
+    auto value = this->interpretExpression(node->value.get());
 
-        std::vector<BasicValue> values;
+    if (node->cacheable)
+        node->cached = std::make_shared<BasicValue>(value);
 
-        for (auto &value: realNode->elements)
-            values.push_back(this->interpretExpression(value.get()));
+    return value;
+}
 
-        return BasicValue(values);
-    } else if (node->getIdentifier() == "ArrayAccess") {
-        // Accessing an array
-        auto realNode = dynamic_cast<ArrayAccessNode *>(node);
+BasicValue Interpreter::interpretCall(FunctionCallNode *node) {
+    auto function = this->findFunction(node->name);
+
+    if (function != nullptr) {
+        // Build-in
+        if (function->isExternal && function_exists(node->name))
+            return this->callBuiltin(node);
+
+        // Checking the arguments
+        if (function->parameters->size() != node->args.size())
+            throw std::runtime_error("Wrong number of arguments");
+
+        std::vector<BasicValue> arguments;
+
+        for (auto &argument: node->args)
+            arguments.push_back(this->interpretExpression(argument.get()));
+
+        if (this->profile != nullptr && this->profile->recording)
+            this->profile->recordCall(node, function->definition);
+
+        if (function->memo != nullptr)
+            return this->callMemoized(*function, std::move(arguments), node->line);
+
+        BasicValue result;
+
+        if (this->jit != nullptr && this->callCompiled(*function, arguments, result, node->line))
+            return result;
+
+        return this->callFunction(*function, std::move(arguments), node->line);
+    }
+
+    // Checking if we might be instantiating a class
+    for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
+        for (const auto &item: scope->classes) {
+            if (item.name == node->name)
+                return this->instantiateClass(item, node);
+        }
+    }
+
+    throw std::runtime_error("Function/Class " + node->name + " is not defined");
+}
+
+BasicValue Interpreter::callBuiltin(FunctionCallNode *node) {
+    if (this->memoizedFunction != nullptr && function_performs_io(node->name))
+        throw std::runtime_error(node->name + "() can't be called in memoized function " +
+                                 this->memoizedFunction->name + ", its result would be cached, line: " +
+                                 std::to_string(node->line + 1));
+
+    // Builtins changing a list in place get the stored list instead of a copy. It is
+    // moved out of its variable for the call, so its buffer isn't shared and the
+    // builtin doesn't have to copy it.
+    auto mutates = function_mutates(node->name) && !node->args.empty();
+
+    // Mapping the arguments, so all arguments are BasicValues
+    std::vector<BasicValue> args;
+
+    for (size_t i = 0; i < node->args.size(); i++)
+        args.push_back(mutates && i == 0 ? BasicValue() : this->interpretExpression(node->args[i].get()));
+
+    if (!mutates)
+        return executeFunction(node->name, args);
+
+    BasicValue owner;
+    auto target = this->findTarget(node->args[0].get(), owner);
+
+    if (target == nullptr)
+        args[0] = this->interpretExpression(node->args[0].get());
+    else
+        args[0] = std::move(*target);
+
+    BasicValue result;
+
+    try {
+        result = executeFunction(node->name, args);
+    } catch (...) {
+        if (target != nullptr)
+            *target = std::move(args[0]);
+
+        throw;
+    }
+
+    if (target != nullptr)
+        *target = std::move(args[0]);
+
+    return result;
+}
+
+BasicValue Interpreter::instantiateClass(const InterpretedClass &item, FunctionCallNode *node) {
+    // Checking the constructor
+    if (node->args.size() != item.constructor->size())
+        throw std::runtime_error("Wrong number of arguments");
+
+    auto instance = std::make_shared<ObjectInstance>(item.shape);
+
+    // new scope
+    auto new_scope = new Scope(item.scope);
+
+    // The constructor parameters are the first fields, so the variables of the
+    // scope line up with the slots of the instance
+    auto index = 0;
+
+    for (auto &parameter: *item.constructor) {
+        new_scope->variables.emplace_back(parameter, this->interpretExpression(node->args[index].get()), false);
+        index++;
+    }
+
+    this->pushFrame(item.name, new_scope, false, node->line);
+
+    // Initializing the fields, methods are part of the shape
+    for (auto &bodyNode: *item.body) {
+        if (bodyNode->getIdentifier() == "VariableDefinition")
+            this->interpretChild(bodyNode.get());
+    }
+
+    // back to the parent scope
+    this->popFrame();
+
+    for (size_t slot = 0; slot < instance->slots.size(); slot++)
+        instance->slots[slot] = new_scope->variables[slot].value;
+
+    delete new_scope;
+
+    return BasicValue(instance);
+}
 
-        auto array = this->interpretExpression(realNode->array.get());
+BasicValue Interpreter::callMethod(MethodCallNode *node) {
+    auto object = this->interpretExpression(node->object.get());
 
-        if (array.type != BasicValue::Type::LIST)
-            throw std::runtime_error("Array is not an array");
+    if (object.type != BasicValue::Type::OBJECT)
+        throw std::runtime_error("Cannot call method " + node->name + " on a value which is not an object, line: " +
+                                 std::to_string(node->line + 1));
 
-        auto index = this->interpretExpression(realNode->index.get());
+    auto &instance = *object.objectValue;
+    auto method = this->resolveMethod(instance.shape.get(), node);
+
+    if (method->parameters.size() != node->args.size())
+        throw std::runtime_error("Wrong number of arguments");
+
+    // The fields are looked up in the slots of the instance, so changes through other references to it
+    // are seen by the method and the other way around
+    auto new_scope = new Scope(instance.shape->scope);
+    new_scope->instance = &instance;
+
+    for (size_t index = 0; index < method->parameters.size(); index++) {
+        auto value = this->interpretExpression(node->args[index].get());
+        auto type = method->parameterTypes[index];
+
+        if (!matchesType(value, type))
+            typeError(value, type, "Argument " + method->parameters[index] + " of " + node->name, node->line);
+
+        new_scope->variables.emplace_back(method->parameters[index], std::move(value), false, type);
+    }
+
+    // Methods don't make tail calls, only callFunction can replace its frame
+    this->pushFrame(node->name, new_scope, false, node->line);
+
+    auto value = this->runFrame(&method->body);
+
+    this->popFrame();
+
+    if (!matchesType(value, method->returnType))
+        typeError(value, method->returnType, "Result of " + node->name, node->line);
+
+    delete new_scope;
+
+    return value;
+}
+
+BasicValue Interpreter::interpretIndex(ArrayAccessNode *node) {
+    auto array = this->interpretExpression(node->array.get());
+
+    // Looking up a key in a map
+    if (array.type == BasicValue::Type::MAP) {
+        auto key = this->interpretExpression(node->index.get());
+        auto value = array.mapValue->find(key);
+
+        if (value == nullptr)
+            throw std::runtime_error("Key not found in map: " + key.getValue());
+
+        return *value;
+    }
+
+    if (array.type == BasicValue::Type::ARRAY) {
+        auto index = this->interpretExpression(node->index.get());
+
+        if (index.type != BasicValue::Type::INT)
+            throw std::runtime_error("Index is not an integer");
+
+        if (index.intValue < 0 || (size_t) index.intValue >= array.arrayValue->size())
+            throw std::runtime_error("Index out of bounds");
+
+        return array.arrayValue->get(index.intValue);
+    }
+
+    if (array.type == BasicValue::Type::VECTOR) {
+        auto index = this->interpretExpression(node->index.get());
 
         if (index.type != BasicValue::Type::INT)
             throw std::runtime_error("Index is not an integer");
 
-        if (index.intValue < 0 || index.intValue >= array.listValue.size())
+        if (index.intValue < 0 || (size_t) index.intValue >= array.vectorValue->size())
             throw std::runtime_error("Index out of bounds");
 
-        return array.listValue[index.intValue];
+        return array.vectorValue->get(index.intValue);
     }
 
-    throw std::runtime_error("Cannot interpret expression: " + node->getIdentifier());
+    if (array.type != BasicValue::Type::LIST)
+        throw std::runtime_error("Array is not an array");
+
+    auto index = this->interpretExpression(node->index.get());
+
+    if (index.type != BasicValue::Type::INT)
+        throw std::runtime_error("Index is not an integer");
+
+    if (index.intValue < 0 || (size_t) index.intValue >= array.listValue->size())
+        throw std::runtime_error("Index out of bounds");
+
+    return (*array.listValue)[index.intValue];
 }
 
-std::vector<AstChild *> Interpreter::getAllNodesInNode(AstChild *node, bool ignoreLoops) {
-    std::vector<AstChild *> nodes;
+void Interpreter::pushFrame(const Symbol &name, Scope *scope, bool tailCalls, int line) {
+    if (this->frames.size() >= this->maxStackDepth)
+        throw std::runtime_error("Stack overflow: more than " + std::to_string(this->maxStackDepth) +
+                                 " nested calls (calling " + name + ", line: " + std::to_string(line + 1) +
+                                 "), the limit can be changed with --max-stack");
 
-    nodes.push_back(node);
+    // Deeply nested expressions can use up the native stack before the frame limit is reached
+    char marker;
 
-    if (node->getIdentifier() == "IfStatement") {
-        // Removing the node (This is a workaround, because other nodes need to be added too, even if they
-        // don't have a special case in this function)
-        nodes.pop_back();
+    if (this->nativeStackBase != nullptr && this->nativeStackBase - &marker > this->nativeStackSize)
+        throw std::runtime_error("Stack overflow: out of native stack after " + std::to_string(this->frames.size()) +
+                                 " nested calls (calling " + name + ", line: " + std::to_string(line + 1) + ")");
 
-        auto ifNode = dynamic_cast<IfStatementNode *>(node);
+    this->frames.push_back(CallFrame{name, scope, this->current_scope, line, tailCalls});
+    this->current_scope = scope;
+}
 
-        if (this->interpretExpression(ifNode->condition.get()).intValue == 1)
-            for (auto &nItem: ifNode->thenBranch) {
-                for (auto &item: this->getAllNodesInNode(nItem.get(), ignoreLoops)) {
-                    nodes.push_back(item);
-                }
-            }
-        else
-            for (auto &nItem: ifNode->elseBranch) {
-                for (auto &item: this->getAllNodesInNode(nItem.get(), ignoreLoops)) {
-                    nodes.push_back(item);
-                }
-            }
+void Interpreter::popFrame() {
+    // The caller goes on at the line of the call
+    if (this->sampler != nullptr) {
+        if (Sampler::due())
+            this->takeSamples();
+
+        this->currentLine = this->frames.back().line;
     }
 
-    if (node->getIdentifier() == "SwitchStatement") {
-        // Removing the node (This is a workaround, because other nodes need to be added too, even if they
-        // don't have a special case in this function)
-        nodes.pop_back();
+    this->current_scope = this->frames.back().caller;
+    this->frames.pop_back();
+}
 
-        auto realNode = dynamic_cast<SwitchStatementNode *>(node);
-        auto expr = this->interpretExpression(realNode->condition.get());
-        bool executed = false;
-
-        // Checking which case is the correct one
-        for (auto &caseNode: realNode->cases) {
-            if (caseNode->condition != nullptr) {
-                auto caseExpr = this->interpretExpression(caseNode->condition.get());
-
-                if (caseExpr.getValue() == expr.getValue()) {
-                    if (executed)
-                        throw std::runtime_error("Multiple cases with the same value");
-
-                    executed = true;
-
-                    // If it is, we need to interpret the case
-                    for (auto &item: caseNode->body) {
-                        for (auto &nItem: this->getAllNodesInNode(item.get(), ignoreLoops)) {
-                            nodes.push_back(nItem);
-                        }
-                    }
-                }
+BasicValue Interpreter::runFrame(std::vector<std::unique_ptr<AstChild>> *body) {
+    if (this->interpretBlock(*body) != ControlFlow::RETURN)
+        return BasicValue();
+
+    auto value = std::move(this->returnValue);
+    this->returnValue = BasicValue();
+
+    return value;
+}
+
+BasicValue Interpreter::callFunction(const InterpreterFunction &function, std::vector<BasicValue> arguments, int line) {
+    // The calls a memoized function makes have to return to it, so their results can be cached
+    this->pushFrame(function.name, nullptr, function.memo == nullptr, line);
+
+    auto current = function;
+
+    // Annotated result types of the functions the tail calls went through, the result has to match all of them
+    std::vector<std::pair<Symbol, StaticType>> returnTypes;
+
+    // Each iteration is one call, tail calls replace the frame instead of pushing a new one
+    while (true) {
+        // Checking the arguments
+        if (current.parameters->size() != arguments.size())
+            throw std::runtime_error("Wrong number of arguments");
+
+        auto scope = new Scope(current.scope);
+
+        for (size_t i = 0; i < arguments.size(); i++) {
+            auto &parameter = (*current.parameters)[i];
+            auto type = (*current.parameterTypes)[i];
+
+            if (!matchesType(arguments[i], type)) {
+                delete scope;
+                typeError(arguments[i], type, "Argument " + parameter + " of " + current.name, line);
             }
+
+            scope->variables.emplace_back(parameter, std::move(arguments[i]), false, type);
         }
 
-        if (!executed) {
-            // Default case
-            for (auto &caseNode: realNode->cases) {
-                if (caseNode->condition == nullptr) {
-                    if (executed)
-                        throw std::runtime_error("Multiple default cases");
+        if (current.returnType != StaticType::UNKNOWN &&
+            (returnTypes.empty() || returnTypes.back() != std::make_pair(current.name, current.returnType)))
+            returnTypes.emplace_back(current.name, current.returnType);
 
-                    executed = true;
+        auto &frame = this->frames.back();
+        frame.name = current.name;
+        frame.scope = scope;
+        this->current_scope = scope;
 
-                    for (auto &nItem: this->getAllNodesInNode(caseNode.get(), ignoreLoops)) {
-                        nodes.push_back(nItem);
-                    }
-                }
-            }
+        auto value = this->runFrame(current.body);
+
+        delete scope;
+
+        if (!this->tailCall) {
+            this->popFrame();
+
+            for (auto &[name, type]: returnTypes)
+                if (!matchesType(value, type))
+                    typeError(value, type, "Result of " + name, line);
+
+            return value;
         }
+
+        current = this->tailCall->function;
+        arguments = std::move(this->tailCall->arguments);
+        this->tailCall.reset();
     }
+}
 
-    if (node->getIdentifier() == "SwitchCase") {
-        // Removing the node (This is a workaround, because other nodes need to be added too, even if they
-        // don't have a special case in this function)
-        nodes.pop_back();
+bool Interpreter::callCompiled(InterpreterFunction &function, const std::vector<BasicValue> &arguments,
+                               BasicValue &result, int line) {
+    if (this->jit->paused)
+        return false;
 
-        auto realNode = dynamic_cast<SwitchCaseNode *>(node);
+    auto definition = compilableFunction(&function);
 
-        for (auto &item: realNode->body) {
-            for (auto &nItem: this->getAllNodesInNode(item.get(), ignoreLoops)) {
-                nodes.push_back(nItem);
-            }
+    if (definition == nullptr)
+        return false;
+
+    if (function.compiled == nullptr)
+        function.compiled = &this->jit->function(definition);
+
+    auto &compiled = *function.compiled;
+
+    if (!this->jit->prepare(compiled, definition))
+        return false;
+
+    std::vector<jit::Slot> slots(std::max<size_t>(arguments.size(), 1));
+
+    for (size_t i = 0; i < arguments.size(); i++)
+        slots[i] = jit::Slot{arguments[i].type, arguments[i].intValue};
+
+    this->jit->ran(compiled);
+
+    if (this->jit->run(compiled.entry, slots.data(), (int64_t) (this->maxStackDepth - this->frames.size())) !=
+        jit::FINISHED) {
+        this->jit->deoptimized(compiled);
+        return false;
+    }
+
+    result = BasicValue(slots[0].value);
+
+    if (!this->jit->differential)
+        return true;
+
+    // Calling the function again in the interpreter alone, it only computes its result
+    BasicValue expected;
+
+    this->jit->paused = true;
+
+    try {
+        expected = this->callFunction(function, arguments, line);
+    } catch (const std::exception &error) {
+        this->jit->paused = false;
+        throw std::runtime_error("Compiled function " + function.name + " returned " + result.getValue() +
+                                 ", the interpreter failed: " + error.what());
+    }
+
+    this->jit->paused = false;
+
+    if (expected.type != BasicValue::Type::INT || expected.intValue != result.intValue)
+        throw std::runtime_error("Compiled function " + function.name + " returned " + result.getValue() +
+                                 ", the interpreter " + expected.getValue() + ", line: " + std::to_string(line + 1));
+
+    return true;
+}
+
+void Interpreter::enableJit(bool differential, int64_t callThreshold, int64_t loopThreshold) {
+    // Functions of the file are looked up from the outermost scope, they can't be redefined there
+    this->jit = std::make_unique<jit::Jit>([this](const Symbol &name) -> FunctionDefinitionNode * {
+        auto scope = this->current_scope;
+
+        while (scope->parent != nullptr)
+            scope = scope->parent;
+
+        for (auto &function: scope->functions)
+            if (function.name == name)
+                return compilableFunction(&function);
+
+        return nullptr;
+    });
+
+    this->jit->differential = differential;
+    this->jit->callThreshold = callThreshold;
+    this->jit->loopThreshold = loopThreshold;
+}
+
+FunctionDefinitionNode *Interpreter::compilableFunction(const InterpreterFunction *function) {
+    if (function == nullptr || function->isExternal || function->scope->parent != nullptr)
+        return nullptr;
+
+    return function->definition;
+}
+
+bool Interpreter::definedInFrame(const InterpreterFunction &function) {
+    auto frameScope = this->frames.back().scope;
+
+    for (auto scope = this->current_scope; scope != frameScope->parent; scope = scope->parent)
+        if (function.scope == scope)
+            return true;
+
+    return false;
+}
+
+BasicValue Interpreter::callMemoized(const InterpreterFunction &function, std::vector<BasicValue> arguments, int line) {
+    auto &cache = *function.memo;
+    auto cacheable = MemoCache::cacheable(arguments);
+
+    if (cacheable) {
+        auto result = cache.find(arguments);
+
+        if (result != nullptr)
+            return *result;
+    } else {
+        cache.counts->misses++;
+    }
+
+    auto outerFunction = this->memoizedFunction;
+    this->memoizedFunction = &function;
+
+    auto key = cacheable ? arguments : std::vector<BasicValue>();
+    auto result = this->callFunction(function, std::move(arguments), line);
+
+    this->memoizedFunction = outerFunction;
+
+    if (cacheable)
+        cache.insert(key, result);
+
+    return result;
+}
+
+void Interpreter::printStats(std::ostream &stream) {
+    if (this->jit != nullptr)
+        this->jit->printStats(stream);
+
+    if (this->profile != nullptr)
+        this->profile->printStats(stream);
+
+    for (auto &[definition, counts]: this->memoCounts) {
+        auto calls = counts->hits + counts->misses;
+        auto rate = calls == 0 ? 0.0 : 100.0 * (double) counts->hits / (double) calls;
+
+        stream << "memo " << definition->name << ": " << calls << " calls, " << counts->hits << " hits ("
+               << std::fixed << std::setprecision(1) << rate << "%), " << counts->cached << " cached, "
+               << counts->evictions << " evicted" << std::endl;
+    }
+}
+
+InterpreterFunction *Interpreter::findFunction(const Symbol &name) {
+    for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent)
+        for (auto &function: scope->functions)
+            if (function.name == name)
+                return &function;
+
+    return nullptr;
+}
+
+void Interpreter::takeSamples() {
+    std::vector<Sampler::Frame> stack;
+
+    // Every frame is at the line where it called the next one
+    stack.push_back({"main", this->frames.empty() ? this->currentLine : this->frames[0].line});
+
+    for (size_t i = 0; i < this->frames.size(); i++)
+        stack.push_back({this->frames[i].name, i + 1 < this->frames.size() ? this->frames[i + 1].line
+                                                                          : this->currentLine});
+
+    this->sampler->sample(stack);
+}
+
+int Interpreter::resolveField(BasicValue &object, const std::string &name, InlineCache &cache, int line) {
+    if (object.type != BasicValue::Type::OBJECT)
+        throw std::runtime_error("Cannot access field " + name + " of a value which is not an object, line: " +
+                                 std::to_string(line + 1));
+
+    auto shape = object.objectValue->shape.get();
+
+    // Fast path: the same shape as last time
+    if (cache.shape == shape)
+        return cache.slot;
+
+    auto slot = shape->findField(name);
+
+    if (slot == -1)
+        throw std::runtime_error("Class " + shape->name + " has no field " + name + ", line: " +
+                                 std::to_string(line + 1));
+
+    cache.shape = shape;
+    cache.slot = slot;
+
+    return slot;
+}
+
+Interpreter::Binding Interpreter::findVariable(const Symbol &name) {
+    for (auto scope = this->current_scope; scope != nullptr; scope = scope->parent) {
+        for (auto &variable: scope->variables)
+            if (variable.name == name)
+                return Binding{&variable.value, variable.constant, variable.type};
+
+        // Parameters and locals of a method hide the fields of its instance
+        if (scope->instance != nullptr) {
+            auto &shape = *scope->instance->shape;
+
+            for (size_t slot = 0; slot < shape.fields.size(); slot++)
+                if (shape.fields[slot] == name)
+                    return Binding{&scope->instance->slots[slot], false, shape.fieldTypes[slot]};
+        }
+    }
+
+    return Binding();
+}
+
+BasicValue *Interpreter::findTarget(AstChild *node, BasicValue &owner) {
+    if (node->getIdentifier() == "VariableReference") {
+        auto realNode = dynamic_cast<VariableReferenceNode *>(node);
+        auto variable = this->findVariable(realNode->name);
+
+        if (variable.value == nullptr)
+            throw std::runtime_error(
+                    "Variable " + realNode->name + " is not defined, line: " + std::to_string(realNode->line + 1));
+
+        if (variable.constant)
+            throw std::runtime_error("Cannot modify constant variable " + realNode->name);
+
+        return variable.value;
+    }
+
+    if (node->getIdentifier() == "MemberAccess") {
+        auto realNode = dynamic_cast<MemberAccessNode *>(node);
+
+        // The owner keeps the instance alive while its field is changed
+        owner = this->interpretExpression(realNode->object.get());
+
+        auto slot = this->resolveField(owner, realNode->name, realNode->cache, realNode->line);
+
+        return &owner.objectValue->slots[slot];
+    }
+
+    if (node->getIdentifier() == "ArrayAccess") {
+        // Evaluating the indices first like an assignment to an element, e.g. `xs[0][i]`
+        std::vector<BasicValue> indices;
+        auto container = node;
+
+        while (container->getIdentifier() == "ArrayAccess") {
+            auto realNode = dynamic_cast<ArrayAccessNode *>(container);
+
+            indices.insert(indices.begin(), this->interpretExpression(realNode->index.get()));
+            container = realNode->array.get();
+        }
+
+        auto target = this->findTarget(container, owner);
+
+        if (target == nullptr)
+            throw std::runtime_error("Cannot modify an element of a temporary value, line: " +
+                                     std::to_string(node->line + 1));
+
+        for (auto &index: indices)
+            target = this->findElement(*target, index, node->line);
+
+        return target;
+    }
+
+    return nullptr;
+}
+
+bool Interpreter::mayAssign(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    // Inlined calls are calls of user functions, the call runs instead if the name resolves to another one
+    if (identifier == "MethodCall" || identifier == "InlinedCall")
+        return true;
+
+    // Builtins can't assign to variables, unless they change their first argument
+    if (identifier == "FunctionCall") {
+        auto name = dynamic_cast<FunctionCallNode *>(node)->name;
+        auto function = this->findFunction(name);
+
+        if (function == nullptr || !function->isExternal || !function_exists(name) || function_mutates(name))
+            return true;
+    }
+
+    auto result = false;
+
+    Optimizer::forEachChild(node, [this, &result](std::unique_ptr<AstChild> &child, bool) {
+        result = result || this->mayAssign(child.get());
+    });
+
+    return result;
+}
+
+bool Interpreter::appendInPlace(VariableAssignmentNode *node) {
+    // Collecting the operands of `s + a + b + ...`, which is parsed as `((s + a) + b) + ...`
+    std::vector<AstChild *> operands;
+    auto left = node->value.get();
+
+    while (left->getIdentifier() == "Expression" && dynamic_cast<ExpressionNode *>(left)->op == "+") {
+        auto expression = dynamic_cast<ExpressionNode *>(left);
+
+        operands.insert(operands.begin(), expression->right.get());
+        left = expression->left.get();
+    }
+
+    if (operands.empty() || left->getIdentifier() != "VariableReference" ||
+        dynamic_cast<VariableReferenceNode *>(left)->name != node->name)
+        return false;
+
+    // Calls could assign to the variable, and its old value has to be the left side then
+    if (!node->appendChecked) {
+        node->appendChecked = true;
+        node->appendable = true;
+
+        for (auto operand: operands)
+            node->appendable = node->appendable && !this->mayAssign(operand);
+    }
+
+    if (!node->appendable)
+        return false;
+
+    auto variable = this->findVariable(node->name);
+
+    if (variable.value == nullptr || variable.constant || variable.value->type != BasicValue::Type::STRING)
+        return false;
+
+    // All operands are evaluated first, they could use the variable as well
+    std::vector<BasicValue> values;
+
+    for (auto operand: operands)
+        values.push_back(this->interpretExpression(operand));
+
+    // Looking the variable up again, evaluating the operands could have moved it
+    auto target = this->findVariable(node->name).value;
+
+    for (auto &value: values) {
+        if (target->type == BasicValue::Type::STRING && value.type == BasicValue::Type::STRING)
+            target->stringValue.mutate() += value.stringValue.view();
+        else if (target->type == BasicValue::Type::STRING &&
+                 (value.type == BasicValue::Type::INT || value.type == BasicValue::Type::FLOAT))
+            target->stringValue.mutate() += value.getValue();
+        else
+            *target = this->applyOperator(*target, value, "+", node->line);
+    }
+
+    return true;
+}
+
+void Interpreter::assignIndex(VariableAssignmentNode *node) {
+    // Evaluating everything before looking up the variable, the expressions could define new variables
+    auto value = this->interpretExpression(node->value.get());
+    std::vector<BasicValue> indices;
+
+    for (auto &index: node->indices)
+        indices.push_back(this->interpretExpression(index.get()));
+
+    auto variable = this->findVariable(node->name);
+
+    if (variable.value == nullptr)
+        throw std::runtime_error("Variable " + node->name + " is not defined");
+
+    if (variable.constant)
+        throw std::runtime_error("Cannot assign to constant variable");
+
+    // Walking down to the container of the last index, lists are copied on the way if they are shared
+    auto target = variable.value;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        // Assigning to a new key adds it
+        if (i == indices.size() - 1 && target->type == BasicValue::Type::MAP) {
+            target->mapValue->set(indices[i], std::move(value));
+            return;
         }
+
+        target = this->findElement(*target, indices[i], node->line);
     }
 
-    if (!ignoreLoops) {
-        if (node->getIdentifier() == "WhileStatement") {
-            auto whileNode = dynamic_cast<WhileStatementNode *>(node);
+    *target = std::move(value);
+}
 
-            while (this->interpretExpression(whileNode->condition.get()).intValue == 1) {
-                for (auto &item: whileNode->body)
-                    for (const auto &childNode: getAllNodesInNode(item.get(), ignoreLoops))
-                        nodes.push_back(childNode);
+BasicValue *Interpreter::findElement(BasicValue &container, const BasicValue &index, int line) {
+    if (container.type == BasicValue::Type::MAP) {
+        auto element = container.mapValue->find(index);
+
+        if (element == nullptr)
+            throw std::runtime_error("Key not found in map: " + index.getValue());
+
+        return element;
+    }
+
+    if (container.type == BasicValue::Type::LIST) {
+        if (index.type != BasicValue::Type::INT)
+            throw std::runtime_error("Index is not an integer");
+
+        auto &list = container.listValue.mutate();
+
+        if (index.intValue < 0 || (size_t) index.intValue >= list.size())
+            throw std::runtime_error("Index out of bounds, line: " + std::to_string(line + 1));
+
+        return &list[index.intValue];
+    }
+
+    if (container.type == BasicValue::Type::VECTOR)
+        throw std::runtime_error("Vectors can't be changed, use with() to get a changed copy, line: " +
+                                 std::to_string(line + 1));
+
+    throw std::runtime_error("Only lists and maps can be assigned by index, line: " + std::to_string(line + 1));
+}
+
+FunctionDefinitionNode *Interpreter::resolveMethod(Shape *shape, MethodCallNode *node) {
+    auto &cache = node->cache;
+
+    // Checking the shapes this call has seen before
+    for (int i = 0; i < cache.count; i++)
+        if (cache.shapes[i] == shape)
+            return cache.methods[i];
+
+    auto method = shape->findMethod(node->selector);
+
+    if (method == nullptr)
+        throw std::runtime_error("Class " + shape->name + " has no method " + node->name + ", line: " +
+                                 std::to_string(node->line + 1));
+
+    // Once the cache is full the call is megamorphic, and the method table is used every time
+    if (cache.count < PolymorphicInlineCache::SIZE) {
+        cache.shapes[cache.count] = shape;
+        cache.methods[cache.count] = method;
+        cache.count++;
+    }
+
+    return method;
+}
+
+SwitchCaseNode *Interpreter::selectSwitchCase(SwitchStatementNode *node) {
+    auto value = this->interpretExpression(node->condition.get());
+
+    if (node->table != nullptr) {
+        auto &table = *node->table;
+
+        if (value.type == BasicValue::Type::INT && table.integers) {
+            if (!table.jumpTable.empty()) {
+                // Values below the minimum wrap around to large indices
+                auto index = (uint64_t) value.intValue - (uint64_t) table.minimum;
+
+                if (index < table.jumpTable.size() && table.jumpTable[index] != nullptr)
+                    return table.jumpTable[index];
+            } else {
+                auto found = table.byInteger.find(value.intValue);
+
+                if (found != table.byInteger.end())
+                    return found->second;
             }
-        } else if (node->getIdentifier() == "ForStatement") {
-            auto forNode = dynamic_cast<ForStatementNode *>(node);
 
-            for (auto &item: forNode->body)
-                for (const auto &childNode: getAllNodesInNode(item.get(), ignoreLoops))
-                    nodes.push_back(childNode);
+            return node->defaultCase;
         }
+
+        auto found = value.type == BasicValue::Type::STRING ? table.byText.find(value.stringValue.view())
+                                                             : table.byText.find(value.getValue());
+
+        return found != table.byText.end() ? found->second : node->defaultCase;
     }
 
-    return nodes;
-}
\ No newline at end of file
+    // Labels which aren't literals are evaluated one after another
+    auto text = value.getValue();
+
+    for (auto &caseNode: node->cases)
+        if (caseNode->condition != nullptr && this->interpretExpression(caseNode->condition.get()).getValue() == text)
+            return caseNode.get();
+
+    return node->defaultCase;
+}
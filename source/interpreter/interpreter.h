@@ -19,6 +19,7 @@
 
 
 #include <map>
+#include <optional>
 #include "../parser/ast.h"
 #include "type.h"
 #include <fstream>
@@ -28,37 +29,61 @@
 #include <chrono>
 #include <unistd.h>
 #include "functions.h"
+#include "map.h"
+#include "array.h"
+#include "object.h"
+#include "vector.h"
+#include "memo.h"
+#include "bigint.h"
+#include "../jit/jit.h"
+#include "profile.h"
+#include "sampler.h"
 
 class Scope;
 
 class InterpreterFunction {
 public:
-    std::string name;
-    std::vector<std::string> *parameters;
+    Symbol name;
+    std::vector<Symbol> *parameters;
     std::vector<std::unique_ptr<AstChild>> *body;
     Scope *scope;
     bool isExternal;
 
-    explicit InterpreterFunction(std::string name, std::vector<std::string> *parameters, std::vector<std::unique_ptr<AstChild>> *body, Scope* scope, bool isExternal) : name(std::move(name)), parameters(parameters), body(body), scope(scope), isExternal(isExternal) {}
+    // Cached results, only set for memoized functions
+    std::shared_ptr<MemoCache> memo;
+
+    // Annotated types of the parameters and the result, checked on every call
+    std::vector<StaticType> *parameterTypes = nullptr;
+    StaticType returnType = StaticType::UNKNOWN;
+
+    // The definition, and its compiled code once the function was called with the jit on
+    FunctionDefinitionNode *definition = nullptr;
+    jit::CompiledFunction *compiled = nullptr;
+
+    explicit InterpreterFunction(Symbol name, std::vector<Symbol> *parameters, std::vector<std::unique_ptr<AstChild>> *body, Scope* scope, bool isExternal) : name(std::move(name)), parameters(parameters), body(body), scope(scope), isExternal(isExternal) {}
 };
 
 class InterpretedVariable {
 public:
-    std::string name;
+    Symbol name;
     BasicValue value;
     bool constant;
 
-    explicit InterpretedVariable(std::string name, BasicValue value, bool constant) : name(std::move(name)), value(value), constant(constant) {}
+    // Annotated type, every value assigned to the variable has to have it
+    StaticType type;
+
+    explicit InterpretedVariable(Symbol name, BasicValue value, bool constant, StaticType type = StaticType::UNKNOWN) : name(name), value(std::move(value)), constant(constant), type(type) {}
 };
 
 class InterpretedClass {
 public:
-    std::string name;
+    Symbol name;
     std::vector<std::unique_ptr<AstChild>> *body;
     Scope *scope;
-    std::vector<std::string> *constructor;
+    std::vector<Symbol> *constructor;
+    std::shared_ptr<Shape> shape;
 
-    explicit InterpretedClass(std::string name, std::vector<std::unique_ptr<AstChild>> *body, std::vector<std::string> *constructor, Scope *scope) : name(std::move(name)), body(body), constructor(constructor), scope(scope) {}
+    explicit InterpretedClass(Symbol name, std::vector<std::unique_ptr<AstChild>> *body, std::vector<Symbol> *constructor, Scope *scope, std::shared_ptr<Shape> shape) : name(std::move(name)), body(body), constructor(constructor), scope(scope), shape(std::move(shape)) {}
 };
 
 class Scope {
@@ -68,6 +93,9 @@ public:
     // Variables in vector
     std::vector<InterpretedVariable> variables;
 
+    // The instance a method runs on, its fields are looked up after the variables of the scope
+    ObjectInstance *instance = nullptr;
+
     // Functions in map (function name, function)
     std::vector<InterpreterFunction> functions;
 
@@ -78,13 +106,76 @@ public:
     Scope *parent;
 };
 
+// How a statement ended. Anything but NORMAL leaves all enclosing blocks up to the loop or function.
+enum class ControlFlow {
+    NORMAL,
+    BREAK,
+    CONTINUE,
+    RETURN,
+};
+
+// A call in tail position, run by the caller of the function returning it
+struct TailCall {
+    InterpreterFunction function;
+    std::vector<BasicValue> arguments;
+};
+
+// A running call of a function, method or constructor. The frames are kept on the heap, in the frame
+// stack of the interpreter, so the depth of the recursion can be limited.
+struct CallFrame {
+    Symbol name;
+
+    // Scope of the call, and the scope to go back to when it returns
+    Scope *scope;
+    Scope *caller;
+
+    int line;
+
+    // Only functions can replace their frame with a call
+    bool tailCalls;
+};
+
 class Interpreter {
 private:
     Scope *current_scope;
 
+    std::vector<CallFrame> frames;
+
+    // Line of the statement running in the innermost frame, only kept for the sampler
+    int currentLine = 0;
+
+    // Value of the last return statement
+    BasicValue returnValue;
+
+    // The call a function returned in tail position, it runs in the frame of the function
+    std::optional<TailCall> tailCall;
+
+    // The innermost memoized function being called, I/O builtins can't be called while it runs
+    const InterpreterFunction *memoizedFunction = nullptr;
+
+    // The cache counts of all memoized definitions run so far, for --stats
+    std::vector<std::pair<FunctionDefinitionNode *, std::shared_ptr<MemoCache::Counts>>> memoCounts;
+
 public:
     AbstractSyntaxTree *ast;
 
+    // Maximum number of nested calls, set with --max-stack
+    size_t maxStackDepth = 10000;
+
+    // Compiler of hot functions and loops, not set with --no-jit
+    std::unique_ptr<jit::Jit> jit;
+
+    // Type feedback, recorded with --profile-out and used with --profile-in
+    std::unique_ptr<Profile> profile;
+
+    // Sampling the call stack, only set with --profile
+    std::unique_ptr<Sampler> sampler;
+
+    // Start and size of the native stack the interpreter runs on, when it is known. Calls fail cleanly
+    // instead of crashing when it is used up.
+    char *nativeStackBase = nullptr;
+    long nativeStackSize = 0;
+
     explicit Interpreter(AbstractSyntaxTree *ast) {
         this->ast = ast;
 
@@ -96,12 +187,156 @@ public:
 
     void importFile(AstChild *node);
 
-    void interpretChild(AstChild *node);
+    // Leaving the current scope and destroying it
+    void popScope();
+
+    ControlFlow interpretChild(AstChild *node);
+
+    // Running statements one after another until one of them breaks, continues or returns
+    ControlFlow interpretBlock(std::vector<std::unique_ptr<AstChild>> &body);
+
+    // The same as interpretBlock, but in a new scope
+    ControlFlow interpretScopedBlock(std::vector<std::unique_ptr<AstChild>> &body);
+
+    // Evaluating the value of a return statement, or preparing its tail call
+    void interpretReturn(ReturnStatementNode *node);
+
+    // Adding a variable to the current scope
+    void defineVariable(VariableDefinitionNode *node);
+
+    void assignVariable(VariableAssignmentNode *node);
+
+    ControlFlow interpretWhile(WhileStatementNode *node);
+
+    // Running the iterations of a while loop in its scope, counting them for the compiler if it is given
+    ControlFlow iterateWhile(WhileStatementNode *node, jit::CompiledLoop *compiled);
+
+    // Running a while loop as compiled code, from its start or in the middle of a run (replacing the
+    // interpreter). Returns false if it isn't compiled or bailed out, the interpreter goes on from the
+    // variables the compiled code stored.
+    bool runCompiledLoop(WhileStatementNode *node, jit::CompiledLoop &compiled, bool replacement);
+
+    ControlFlow interpretFor(ForStatementNode *node);
 
-    std::vector<AstChild*> getAllNodesInNode(AstChild *node, bool ignoreLoops = false);
+    // Adding a function to the current scope
+    void defineFunction(FunctionDefinitionNode *node);
+
+    void defineClass(ClassDefinitionNode *node);
+
+    // The case of a switch matching its value, or the default case (nullptr if there is none)
+    SwitchCaseNode *selectSwitchCase(SwitchStatementNode *node);
 
     BasicValue interpretExpression(AstChild *node);
+
+    // Evaluating an expression the type inference marked as unboxed, without boxing the values in
+    // between. Returns false if a variable doesn't have the inferred type or an int result doesn't fit
+    // into 64 bits. The expression only reads values, so it can be evaluated again the generic way.
+    bool evaluateInt(AstChild *node, int64_t &result);
+
+    bool evaluateFloat(AstChild *node, double &result);
+
+    // Calling a function, builtin or constructor
+    BasicValue interpretCall(FunctionCallNode *node);
+
+    // Whether the body of an inlined call can be evaluated, i.e. its name still refers to the function it
+    // was copied from. Checked at the first evaluation.
+    bool resolveInlinedCall(InlinedCallNode *node);
+
+    // Value of a loop-invariant expression, evaluated once per run of its loop
+    BasicValue interpretInvariant(InvariantNode *node);
+
+    BasicValue callBuiltin(FunctionCallNode *node);
+
+    BasicValue instantiateClass(const InterpretedClass &item, FunctionCallNode *node);
+
+    BasicValue callMethod(MethodCallNode *node);
+
+    // Accessing an element of a list, array, vector or map
+    BasicValue interpretIndex(ArrayAccessNode *node);
+
+    // Applying a binary operator to two values
+    BasicValue applyOperator(BasicValue left, const BasicValue &right, const std::string &op, int line);
+
+    // Entering the scope of a call, throws if the stack is full
+    void pushFrame(const Symbol &name, Scope *scope, bool tailCalls, int line);
+
+    // Going back to the scope of the caller
+    void popFrame();
+
+    // Running the body of the current frame, returns the return value
+    BasicValue runFrame(std::vector<std::unique_ptr<AstChild>> *body);
+
+    // Calling a function defined in ACL, tail calls made by it run in the same frame
+    BasicValue callFunction(const InterpreterFunction &function, std::vector<BasicValue> arguments, int line);
+
+    // Calling a function as compiled code. Returns false if it isn't compiled or bailed out, the call
+    // is then interpreted.
+    bool callCompiled(InterpreterFunction &function, const std::vector<BasicValue> &arguments, BasicValue &result,
+                      int line);
+
+    // Compiling hot functions and loops from now on, after the given numbers of calls and iterations
+    void enableJit(bool differential, int64_t callThreshold, int64_t loopThreshold);
+
+    // The definition of a function of the file with the given name, nullptr for any other function
+    static FunctionDefinitionNode *compilableFunction(const InterpreterFunction *function);
+
+    // Whether the function was defined inside of the current call, so it can't outlive its scope
+    bool definedInFrame(const InterpreterFunction &function);
+
+    // Calling a memoized function, the result is looked up in its cache first
+    BasicValue callMemoized(const InterpreterFunction &function, std::vector<BasicValue> arguments, int line);
+
+    // Printing the hit rates of the memoized functions
+    void printStats(std::ostream &stream);
+
+    // Giving the samples which are due to the sampler, with the current call stack
+    void takeSamples();
+
+    // The function with the given name in the current scope or any scope above, or nullptr
+    InterpreterFunction *findFunction(const Symbol &name);
+
+    // Slot of a field of an instance, looked up through the inline cache of the access
+    int resolveField(BasicValue &object, const std::string &name, InlineCache &cache, int line);
+
+    // What a name refers to, a variable or a field of the instance a method runs on
+    struct Binding {
+        // nullptr if the name isn't defined
+        BasicValue *value = nullptr;
+        bool constant = false;
+        StaticType type = StaticType::UNKNOWN;
+    };
+
+    // The variable with the given name in the current scope or any scope above
+    Binding findVariable(const Symbol &name);
+
+    // Location of the value a variable reference, field access or element of either refers to, so
+    // it can be changed in place. Returns nullptr for any other node.
+    BasicValue *findTarget(AstChild *node, BasicValue &owner);
+
+    // Assigning to an element of a list or map, e.g. `a[i] = x`
+    void assignIndex(VariableAssignmentNode *node);
+
+    // Location of an existing element of a list or map, lists are copied first if they are shared
+    BasicValue *findElement(BasicValue &container, const BasicValue &index, int line);
+
+    // Whether evaluating the expression could assign to a variable, i.e. it calls a function,
+    // method or builtin changing its argument
+    bool mayAssign(AstChild *node);
+
+    // Running `s = s + x + ...` on a string variable by appending to the string in place.
+    // Returns false if the assignment doesn't have that form.
+    bool appendInPlace(VariableAssignmentNode *node);
+
+    // Method called on an instance of the shape, looked up through the polymorphic inline cache of the call
+    FunctionDefinitionNode *resolveMethod(Shape *shape, MethodCallNode *node);
 };
 
+// Int operators without the big integer fallback. Returns false if the result doesn't fit into
+// 64 bits or for a division by zero.
+bool applyIntOperator(int64_t left, int64_t right, Operator op, int64_t &result);
+
+// Float operators, comparisons give 0 or 1. Returns false for operators floats don't have.
+bool applyFloatOperator(double left, double right, Operator op, double &result);
+
 
 #endif //ACL_INTERPRETER_H
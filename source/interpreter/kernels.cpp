@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernels.h"
+#include <cstring>
+
+// One clone per instruction set, the dynamic loader picks the best one for the CPU
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define ACL_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define ACL_KERNEL
+#endif
+
+// Eight lanes cover a whole AVX-512 register, smaller instruction sets split them up
+const size_t LANES = 8;
+
+typedef uint64_t UIntVector __attribute__((vector_size(LANES * sizeof(uint64_t))));
+typedef int64_t IntVector __attribute__((vector_size(LANES * sizeof(int64_t))));
+typedef double FloatVector __attribute__((vector_size(LANES * sizeof(double))));
+
+// Unaligned loads and stores of whole vectors
+#define LOAD(vector, pointer) std::memcpy(&(vector), (pointer), sizeof(vector))
+#define STORE(pointer, vector) std::memcpy((pointer), &(vector), sizeof(vector))
+
+// Integer arithmetic is done on unsigned lanes, where it wraps around. Signed overflow of a sum
+// shows in the sign bit of (sum ^ a) & (sum ^ b), which is collected over the whole loop.
+#define OVERFLOWS(sum, a, b) (((sum) ^ (a)) & ((sum) ^ (b)))
+
+// Whether a flag of OVERFLOWS is set in any lane
+static bool overflowed(const UIntVector &flags) {
+    uint64_t any = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        any |= flags[lane];
+
+    return (int64_t) any < 0;
+}
+
+// Products of ints between -2^31 and 2^31 always fit. Values outside of that have bits set above
+// the lower 32 once 2^31 is added.
+const uint64_t HALF = 1ull << 31;
+
+static bool large(const UIntVector &values) {
+    uint64_t any = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        any |= values[lane];
+
+    return (any >> 32) != 0;
+}
+
+ACL_KERNEL bool kernels::sum(const int64_t *data, size_t size, int64_t &result) {
+    UIntVector total = {}, flags = {};
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        UIntVector v;
+        LOAD(v, data + i);
+        auto next = total + v;
+        flags |= OVERFLOWS(next, total, v);
+        total = next;
+    }
+
+    if (overflowed(flags))
+        return false;
+
+    result = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        if (__builtin_add_overflow(result, (int64_t) total[lane], &result))
+            return false;
+
+    for (; i < size; i++)
+        if (__builtin_add_overflow(result, data[i], &result))
+            return false;
+
+    return true;
+}
+
+ACL_KERNEL double kernels::sum(const double *data, size_t size) {
+    // Eight independent partial sums, which also loses less precision than one running sum
+    FloatVector total = {};
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        FloatVector v;
+        LOAD(v, data + i);
+        total += v;
+    }
+
+    double result = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        result += total[lane];
+
+    for (; i < size; i++)
+        result += data[i];
+
+    return result;
+}
+
+ACL_KERNEL int64_t kernels::min(const int64_t *data, size_t size) {
+    auto result = data[0];
+    size_t i = 0;
+
+    if (size >= LANES) {
+        IntVector best;
+        LOAD(best, data);
+
+        for (i = LANES; i + LANES <= size; i += LANES) {
+            IntVector v;
+            LOAD(v, data + i);
+            best = v < best ? v : best;
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++)
+            result = best[lane] < result ? best[lane] : result;
+    }
+
+    for (; i < size; i++)
+        result = data[i] < result ? data[i] : result;
+
+    return result;
+}
+
+ACL_KERNEL double kernels::min(const double *data, size_t size) {
+    auto result = data[0];
+    size_t i = 0;
+
+    if (size >= LANES) {
+        FloatVector best;
+        LOAD(best, data);
+
+        for (i = LANES; i + LANES <= size; i += LANES) {
+            FloatVector v;
+            LOAD(v, data + i);
+            best = v < best ? v : best;
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++)
+            result = best[lane] < result ? best[lane] : result;
+    }
+
+    for (; i < size; i++)
+        result = data[i] < result ? data[i] : result;
+
+    return result;
+}
+
+ACL_KERNEL int64_t kernels::max(const int64_t *data, size_t size) {
+    auto result = data[0];
+    size_t i = 0;
+
+    if (size >= LANES) {
+        IntVector best;
+        LOAD(best, data);
+
+        for (i = LANES; i + LANES <= size; i += LANES) {
+            IntVector v;
+            LOAD(v, data + i);
+            best = v > best ? v : best;
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++)
+            result = best[lane] > result ? best[lane] : result;
+    }
+
+    for (; i < size; i++)
+        result = data[i] > result ? data[i] : result;
+
+    return result;
+}
+
+ACL_KERNEL double kernels::max(const double *data, size_t size) {
+    auto result = data[0];
+    size_t i = 0;
+
+    if (size >= LANES) {
+        FloatVector best;
+        LOAD(best, data);
+
+        for (i = LANES; i + LANES <= size; i += LANES) {
+            FloatVector v;
+            LOAD(v, data + i);
+            best = v > best ? v : best;
+        }
+
+        for (size_t lane = 0; lane < LANES; lane++)
+            result = best[lane] > result ? best[lane] : result;
+    }
+
+    for (; i < size; i++)
+        result = data[i] > result ? data[i] : result;
+
+    return result;
+}
+
+ACL_KERNEL bool kernels::dot(const int64_t *a, const int64_t *b, size_t size, int64_t &result) {
+    UIntVector total = {}, flags = {}, ranges = {};
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        UIntVector x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        ranges |= (x + HALF) | (y + HALF);
+        auto product = x * y;
+        auto next = total + product;
+        flags |= OVERFLOWS(next, total, product);
+        total = next;
+    }
+
+    if (large(ranges) || overflowed(flags))
+        return false;
+
+    result = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        if (__builtin_add_overflow(result, (int64_t) total[lane], &result))
+            return false;
+
+    for (; i < size; i++) {
+        int64_t product;
+
+        if (__builtin_mul_overflow(a[i], b[i], &product) || __builtin_add_overflow(result, product, &result))
+            return false;
+    }
+
+    return true;
+}
+
+ACL_KERNEL double kernels::dot(const double *a, const double *b, size_t size) {
+    FloatVector total = {};
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        FloatVector x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        total += x * y;
+    }
+
+    double result = 0;
+
+    for (size_t lane = 0; lane < LANES; lane++)
+        result += total[lane];
+
+    for (; i < size; i++)
+        result += a[i] * b[i];
+
+    return result;
+}
+
+ACL_KERNEL bool kernels::scale(const int64_t *data, int64_t factor, int64_t *out, size_t size) {
+    UIntVector ranges = {};
+    size_t i = 0;
+
+    if (((uint64_t) factor + HALF) >> 32 == 0) {
+        for (; i + LANES <= size; i += LANES) {
+            UIntVector v;
+            LOAD(v, data + i);
+            ranges |= v + HALF;
+            v *= (uint64_t) factor;
+            STORE(out + i, v);
+        }
+
+        // Large values could have overflowed, they are checked one by one then
+        if (large(ranges))
+            i = 0;
+    }
+
+    for (; i < size; i++)
+        if (__builtin_mul_overflow(data[i], factor, &out[i]))
+            return false;
+
+    return true;
+}
+
+ACL_KERNEL void kernels::scale(const double *data, double factor, double *out, size_t size) {
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        FloatVector v;
+        LOAD(v, data + i);
+        v *= factor;
+        STORE(out + i, v);
+    }
+
+    for (; i < size; i++)
+        out[i] = data[i] * factor;
+}
+
+ACL_KERNEL bool kernels::add(const int64_t *a, const int64_t *b, int64_t *out, size_t size) {
+    UIntVector flags = {};
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        UIntVector x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        auto result = x + y;
+        flags |= OVERFLOWS(result, x, y);
+        STORE(out + i, result);
+    }
+
+    if (overflowed(flags))
+        return false;
+
+    for (; i < size; i++)
+        if (__builtin_add_overflow(a[i], b[i], &out[i]))
+            return false;
+
+    return true;
+}
+
+ACL_KERNEL void kernels::add(const double *a, const double *b, double *out, size_t size) {
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        FloatVector x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x += y;
+        STORE(out + i, x);
+    }
+
+    for (; i < size; i++)
+        out[i] = a[i] + b[i];
+}
+
+ACL_KERNEL void kernels::where(const int64_t *condition, const int64_t *a, const int64_t *b, int64_t *out,
+                               size_t size) {
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        IntVector c, x, y;
+        LOAD(c, condition + i);
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x = c != 0 ? x : y;
+        STORE(out + i, x);
+    }
+
+    for (; i < size; i++)
+        out[i] = condition[i] != 0 ? a[i] : b[i];
+}
+
+ACL_KERNEL void kernels::where(const int64_t *condition, const double *a, const double *b, double *out,
+                               size_t size) {
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        IntVector c;
+        FloatVector x, y;
+        LOAD(c, condition + i);
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x = c != 0 ? x : y;
+        STORE(out + i, x);
+    }
+
+    for (; i < size; i++)
+        out[i] = condition[i] != 0 ? a[i] : b[i];
+}
+
+// Shuffle masks shifting the lanes of a vector up by 1, 2 and 4, filling with zeros
+const IntVector SHIFT_1 = {8, 0, 1, 2, 3, 4, 5, 6};
+const IntVector SHIFT_2 = {8, 9, 0, 1, 2, 3, 4, 5};
+const IntVector SHIFT_4 = {8, 9, 10, 11, 0, 1, 2, 3};
+
+// Adding b to a and collecting the overflow flags of the lanes
+#define CHECKED_ADD(a, b, flags) do { auto added = (a) + (b); (flags) |= OVERFLOWS(added, a, b); (a) = added; } while (0)
+
+ACL_KERNEL bool kernels::cumsum(const int64_t *data, int64_t *out, size_t size) {
+    // Prefix sum inside each vector in three shift and add steps, plus the carry of the last vector
+    const UIntVector zero = {};
+    UIntVector flags = {};
+    uint64_t carry = 0;
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        UIntVector v, carries = zero + carry;
+        LOAD(v, data + i);
+        CHECKED_ADD(v, __builtin_shuffle(v, zero, SHIFT_1), flags);
+        CHECKED_ADD(v, __builtin_shuffle(v, zero, SHIFT_2), flags);
+        CHECKED_ADD(v, __builtin_shuffle(v, zero, SHIFT_4), flags);
+        CHECKED_ADD(v, carries, flags);
+        STORE(out + i, v);
+        carry = v[LANES - 1];
+    }
+
+    // Sums of parts of the array could have overflowed, the prefixes are checked one by one then
+    if (overflowed(flags)) {
+        i = 0;
+        carry = 0;
+    }
+
+    auto sum = (int64_t) carry;
+
+    for (; i < size; i++) {
+        if (__builtin_add_overflow(sum, data[i], &sum))
+            return false;
+
+        out[i] = sum;
+    }
+
+    return true;
+}
+
+ACL_KERNEL void kernels::cumsum(const double *data, double *out, size_t size) {
+    const FloatVector zero = {};
+    double carry = 0;
+    size_t i = 0;
+
+    for (; i + LANES <= size; i += LANES) {
+        FloatVector v;
+        LOAD(v, data + i);
+        v += __builtin_shuffle(v, zero, SHIFT_1);
+        v += __builtin_shuffle(v, zero, SHIFT_2);
+        v += __builtin_shuffle(v, zero, SHIFT_4);
+        v += carry;
+        STORE(out + i, v);
+        carry = v[LANES - 1];
+    }
+
+    for (; i < size; i++) {
+        carry += data[i];
+        out[i] = carry;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_KERNELS_H
+#define ACL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// SIMD kernels behind the numeric array builtins. Every kernel is compiled once per
+// instruction set, and the best version for the running CPU is picked when the
+// program is loaded.
+//
+// The int kernels return false when a result doesn't fit into 64 bits. sum() and dot() also do so
+// when only a partial sum overflowed, the result is computed again with big integers then.
+namespace kernels {
+    bool sum(const int64_t *data, size_t size, int64_t &result);
+
+    double sum(const double *data, size_t size);
+
+    int64_t min(const int64_t *data, size_t size);
+
+    double min(const double *data, size_t size);
+
+    int64_t max(const int64_t *data, size_t size);
+
+    double max(const double *data, size_t size);
+
+    bool dot(const int64_t *a, const int64_t *b, size_t size, int64_t &result);
+
+    double dot(const double *a, const double *b, size_t size);
+
+    // out[i] = data[i] * factor
+    bool scale(const int64_t *data, int64_t factor, int64_t *out, size_t size);
+
+    void scale(const double *data, double factor, double *out, size_t size);
+
+    // out[i] = a[i] + b[i]
+    bool add(const int64_t *a, const int64_t *b, int64_t *out, size_t size);
+
+    void add(const double *a, const double *b, double *out, size_t size);
+
+    // out[i] = condition[i] != 0 ? a[i] : b[i]
+    void where(const int64_t *condition, const int64_t *a, const int64_t *b, int64_t *out, size_t size);
+
+    void where(const int64_t *condition, const double *a, const double *b, double *out, size_t size);
+
+    // out[i] = data[0] + ... + data[i]
+    bool cumsum(const int64_t *data, int64_t *out, size_t size);
+
+    void cumsum(const double *data, double *out, size_t size);
+}
+
+#endif //ACL_KERNELS_H
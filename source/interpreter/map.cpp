@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "map.h"
+#include "bigint.h"
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+// Smallest size of the slot table
+const size_t MIN_CAPACITY = 8;
+
+// Finalizer of splitmix64, spreads the bits of integer keys over the whole hash
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+size_t ValueMap::hashValue(const BasicValue &value) {
+    switch (value.type) {
+        case BasicValue::Type::INT:
+            return mix((uint64_t) value.intValue);
+        case BasicValue::Type::FLOAT: {
+            // -0.0 and 0.0 are the same key
+            auto number = value.floatValue == 0 ? 0 : value.floatValue;
+            uint64_t bits = 0;
+
+            std::memcpy(&bits, &number, sizeof(number));
+            return mix(bits ^ 0x9e3779b97f4a7c15ULL);
+        }
+        case BasicValue::Type::STRING:
+            return value.stringValue.hash();
+        case BasicValue::Type::BIGINT:
+            return std::hash<std::string>()(value.bigValue->toString());
+        default:
+            throw std::runtime_error("Only numbers and strings can be used as map keys. Used: " +
+                                     std::to_string(value.type));
+    }
+}
+
+bool ValueMap::keysEqual(const BasicValue &a, const BasicValue &b) {
+    if (a.type != b.type)
+        return false;
+
+    switch (a.type) {
+        case BasicValue::Type::INT:
+            return a.intValue == b.intValue;
+        case BasicValue::Type::FLOAT:
+            return a.floatValue == b.floatValue;
+        case BasicValue::Type::STRING:
+            return a.stringValue.view() == b.stringValue.view();
+        case BasicValue::Type::BIGINT:
+            return a.bigValue->compare(*b.bigValue) == 0;
+        default:
+            return false;
+    }
+}
+
+long ValueMap::findSlot(const BasicValue &key, size_t hash) const {
+    if (this->slots.empty())
+        return -1;
+
+    auto mask = this->slots.size() - 1;
+
+    // Linear probing, the table always has empty slots left
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+        auto slot = this->slots[i];
+
+        if (slot == EMPTY)
+            return -1;
+
+        if (slot != DELETED) {
+            auto &entry = this->entries[slot];
+
+            if (entry.hash == hash && keysEqual(entry.key, key))
+                return (long) i;
+        }
+    }
+}
+
+BasicValue *ValueMap::find(const BasicValue &key) {
+    auto slot = this->findSlot(key, hashValue(key));
+
+    if (slot == -1)
+        return nullptr;
+
+    return &this->entries[this->slots[slot]].value;
+}
+
+void ValueMap::set(const BasicValue &key, BasicValue value) {
+    auto hash = hashValue(key);
+    auto slot = this->findSlot(key, hash);
+
+    if (slot != -1) {
+        this->entries[this->slots[slot]].value = std::move(value);
+        return;
+    }
+
+    // Keeping the load factor (removed entries included) below 3/4
+    if ((this->entries.size() + 1) * 4 > this->slots.size() * 3)
+        this->rehash((this->count + 1) * 2);
+
+    auto mask = this->slots.size() - 1;
+    auto i = hash & mask;
+
+    while (this->slots[i] >= 0)
+        i = (i + 1) & mask;
+
+    this->slots[i] = (int32_t) this->entries.size();
+    this->entries.push_back({key, std::move(value), hash, false});
+    this->count++;
+}
+
+bool ValueMap::remove(const BasicValue &key) {
+    auto slot = this->findSlot(key, hashValue(key));
+
+    if (slot == -1)
+        return false;
+
+    auto &entry = this->entries[this->slots[slot]];
+
+    entry.removed = true;
+    entry.key = BasicValue();
+    entry.value = BasicValue();
+
+    this->slots[slot] = DELETED;
+    this->count--;
+
+    return true;
+}
+
+size_t ValueMap::size() const {
+    return this->count;
+}
+
+const std::vector<ValueMap::Entry> &ValueMap::getEntries() const {
+    return this->entries;
+}
+
+void ValueMap::rehash(size_t capacity) {
+    size_t size = MIN_CAPACITY;
+
+    while (size < capacity)
+        size *= 2;
+
+    if (this->iterators == 0) {
+        // Dropping removed entries, so the entries stay dense
+        std::vector<Entry> live;
+        live.reserve(this->count + 1);
+
+        for (auto &entry: this->entries)
+            if (!entry.removed)
+                live.push_back(std::move(entry));
+
+        this->entries = std::move(live);
+    } else {
+        // The removed entries are kept in their places, the table has to fit them too
+        while (size < (this->entries.size() + 1) * 2)
+            size *= 2;
+    }
+
+    this->slots.assign(size, EMPTY);
+
+    auto mask = size - 1;
+
+    for (size_t index = 0; index < this->entries.size(); index++) {
+        if (this->entries[index].removed)
+            continue;
+
+        auto i = this->entries[index].hash & mask;
+
+        while (this->slots[i] != EMPTY)
+            i = (i + 1) & mask;
+
+        this->slots[i] = (int32_t) index;
+    }
+}
+
+bool MapIterator::next(BasicValue &value) {
+    auto &entries = this->map->getEntries();
+
+    while (this->index < entries.size()) {
+        auto &entry = entries[this->index++];
+
+        if (!entry.removed) {
+            value = entry.key;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string mapToString(ValueMap &map) {
+    std::string result = "{";
+
+    for (auto &entry: map.getEntries()) {
+        if (entry.removed)
+            continue;
+
+        if (result.size() > 1)
+            result += ", ";
+
+        result += BasicValue(entry.key).getValue() + ": " + BasicValue(entry.value).getValue();
+    }
+
+    return result + "}";
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_MAP_H
+#define ACL_MAP_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "type.h"
+
+// Hash table with open addressing behind the map type. The entries are stored densely
+// in insertion order, the slot table only holds indices into them. That keeps probing
+// cache friendly and makes iterating a map deterministic.
+class ValueMap {
+public:
+    struct Entry {
+        BasicValue key;
+        BasicValue value;
+        size_t hash;
+        bool removed;
+    };
+
+    // Hash of a value which can be used as a key (int, float or string)
+    static size_t hashValue(const BasicValue &value);
+
+    static bool keysEqual(const BasicValue &a, const BasicValue &b);
+
+    // Getting the value of a key, nullptr if the key doesn't exist
+    BasicValue *find(const BasicValue &key);
+
+    void set(const BasicValue &key, BasicValue value);
+
+    // Removing a key, returns false if the key doesn't exist
+    bool remove(const BasicValue &key);
+
+    [[nodiscard]] size_t size() const;
+
+    // All entries in insertion order, including removed ones
+    [[nodiscard]] const std::vector<Entry> &getEntries() const;
+
+    // Iterators over the map. Removed entries are only dropped while there are none, so the positions
+    // of the iterators stay valid.
+    size_t iterators = 0;
+
+private:
+    static constexpr int32_t EMPTY = -1;
+    static constexpr int32_t DELETED = -2;
+
+    std::vector<Entry> entries;
+    std::vector<int32_t> slots;
+    size_t count = 0;
+
+    // Index of the slot holding the key, or -1
+    [[nodiscard]] long findSlot(const BasicValue &key, size_t hash) const;
+
+    // Growing the slot table and dropping removed entries
+    void rehash(size_t capacity);
+};
+
+// Iterating over the keys of a map in insertion order. Used by `for key in map`.
+class MapIterator : public ValueIterator {
+    std::shared_ptr<ValueMap> map;
+    size_t index = 0;
+
+public:
+    explicit MapIterator(std::shared_ptr<ValueMap> map) : map(std::move(map)) {
+        this->map->iterators++;
+    }
+
+    MapIterator(const MapIterator &) = delete;
+
+    ~MapIterator() override {
+        this->map->iterators--;
+    }
+
+    bool next(BasicValue &value) override;
+};
+
+#endif //ACL_MAP_H
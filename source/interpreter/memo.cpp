@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memo.h"
+#include "map.h"
+
+MemoCache::~MemoCache() {
+    this->counts->cached -= this->entries.size();
+}
+
+bool MemoCache::cacheable(const std::vector<BasicValue> &arguments) {
+    for (auto &argument: arguments)
+        if (argument.type != BasicValue::Type::INT && argument.type != BasicValue::Type::FLOAT &&
+            argument.type != BasicValue::Type::STRING && argument.type != BasicValue::Type::BIGINT)
+            return false;
+
+    return true;
+}
+
+size_t MemoCache::hashArguments(const std::vector<BasicValue> &arguments) {
+    size_t hash = arguments.size();
+
+    for (auto &argument: arguments)
+        hash = (hash ^ ValueMap::hashValue(argument)) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+std::list<MemoCache::Entry>::iterator MemoCache::findEntry(const std::vector<BasicValue> &arguments, size_t hash) {
+    auto range = this->index.equal_range(hash);
+
+    for (auto it = range.first; it != range.second; it++) {
+        auto &entry = *it->second;
+        auto equal = entry.arguments.size() == arguments.size();
+
+        for (size_t i = 0; i < arguments.size() && equal; i++)
+            equal = ValueMap::keysEqual(entry.arguments[i], arguments[i]);
+
+        if (equal)
+            return it->second;
+    }
+
+    return this->entries.end();
+}
+
+const BasicValue *MemoCache::find(const std::vector<BasicValue> &arguments) {
+    auto entry = this->findEntry(arguments, hashArguments(arguments));
+
+    if (entry == this->entries.end()) {
+        this->counts->misses++;
+        return nullptr;
+    }
+
+    this->counts->hits++;
+
+    // Moving it to the front, it is the most recently used one now
+    this->entries.splice(this->entries.begin(), this->entries, entry);
+
+    return &entry->result;
+}
+
+void MemoCache::insert(const std::vector<BasicValue> &arguments, BasicValue result) {
+    auto hash = hashArguments(arguments);
+
+    // A recursive call with the same arguments may have cached it already
+    if (this->findEntry(arguments, hash) != this->entries.end())
+        return;
+
+    if (this->entries.size() >= this->capacity) {
+        auto &last = this->entries.back();
+        auto range = this->index.equal_range(last.hash);
+
+        for (auto it = range.first; it != range.second; it++) {
+            if (&*it->second == &last) {
+                this->index.erase(it);
+                break;
+            }
+        }
+
+        this->entries.pop_back();
+        this->counts->evictions++;
+        this->counts->cached--;
+    }
+
+    this->entries.push_front(Entry{arguments, hash, std::move(result)});
+    this->counts->cached++;
+    this->index.emplace(hash, this->entries.begin());
+}
+
+size_t MemoCache::size() const {
+    return this->entries.size();
+}
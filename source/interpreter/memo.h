@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_MEMO_H
+#define ACL_MEMO_H
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "type.h"
+
+// Results of a memoized function, keyed by the arguments of the call. Only the most recently
+// used results are kept, so the memory of the cache is bounded.
+class MemoCache {
+public:
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+    // Counts of all caches of one definition. A function defined in a function gets a new cache
+    // every time its definition runs, it could see different variables.
+    struct Counts {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+
+        // Results in the caches which still exist
+        size_t cached = 0;
+    };
+
+    std::shared_ptr<Counts> counts;
+
+    explicit MemoCache(std::shared_ptr<Counts> counts, size_t capacity = DEFAULT_CAPACITY)
+            : counts(std::move(counts)), capacity(capacity) {}
+
+    ~MemoCache();
+
+    MemoCache(const MemoCache &) = delete;
+
+    MemoCache &operator=(const MemoCache &) = delete;
+
+    // Whether the arguments can be a key, only numbers and strings can
+    static bool cacheable(const std::vector<BasicValue> &arguments);
+
+    // The cached result for the arguments, nullptr if there is none
+    const BasicValue *find(const std::vector<BasicValue> &arguments);
+
+    // Caching a result, dropping the least recently used one when the cache is full
+    void insert(const std::vector<BasicValue> &arguments, BasicValue result);
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Entry {
+        std::vector<BasicValue> arguments;
+        size_t hash;
+        BasicValue result;
+    };
+
+    size_t capacity;
+
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_multimap<size_t, std::list<Entry>::iterator> index;
+
+    static size_t hashArguments(const std::vector<BasicValue> &arguments);
+
+    std::list<Entry>::iterator findEntry(const std::vector<BasicValue> &arguments, size_t hash);
+};
+
+#endif //ACL_MEMO_H
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "object.h"
+
+Shape::Shape(ClassDefinitionNode *node) : name(node->name) {
+    for (auto &parameter: node->constructor) {
+        this->fieldSlots[parameter] = (int) this->fields.size();
+        this->fields.push_back(parameter);
+        this->fieldTypes.push_back(StaticType::UNKNOWN);
+    }
+
+    for (auto &item: node->body) {
+        if (item->getIdentifier() == "VariableDefinition") {
+            auto realItem = dynamic_cast<VariableDefinitionNode *>(item.get());
+
+            if (this->fieldSlots.contains(realItem->name))
+                throw std::runtime_error("Field " + realItem->name + " is defined twice in class " + this->name);
+
+            this->fieldSlots[realItem->name] = (int) this->fields.size();
+            this->fields.push_back(realItem->name);
+            this->fieldTypes.push_back(realItem->type);
+        }
+    }
+
+    // Every selector known so far gets an entry. Selectors numbered later can't belong
+    // to this class, because its methods have already been numbered.
+    for (auto &item: node->body) {
+        if (item->getIdentifier() == "FunctionDefinition") {
+            auto realItem = dynamic_cast<FunctionDefinitionNode *>(item.get());
+            auto selector = getMethodSelector(realItem->name);
+
+            if ((size_t) selector >= this->methodTable.size())
+                this->methodTable.resize(getMethodSelectorCount(), nullptr);
+
+            if (this->methodTable[selector] != nullptr)
+                throw std::runtime_error("Method " + realItem->name + " is defined twice in class " + this->name);
+
+            this->methodTable[selector] = realItem;
+        }
+    }
+}
+
+int Shape::findField(const std::string &field) const {
+    auto slot = this->fieldSlots.find(field);
+
+    return slot == this->fieldSlots.end() ? -1 : slot->second;
+}
+
+FunctionDefinitionNode *Shape::findMethod(int selector) const {
+    if (selector < 0 || (size_t) selector >= this->methodTable.size())
+        return nullptr;
+
+    return this->methodTable[selector];
+}
+
+std::string objectToString(ObjectInstance &object) {
+    std::string result = object.shape->name + "(";
+
+    for (size_t i = 0; i < object.slots.size(); i++) {
+        if (i > 0)
+            result += ", ";
+
+        result += object.shape->fields[i] + ": " + object.slots[i].getValue();
+    }
+
+    return result + ")";
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_OBJECT_H
+#define ACL_OBJECT_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "type.h"
+#include "../parser/ast.h"
+
+class Scope;
+
+// Layout of the instances of a class (a "hidden class"). It is built once from the class
+// definition: every field gets a fixed slot, and the method table maps every method
+// selector to the method of the class.
+class Shape {
+public:
+    std::string name;
+
+    // Constructor parameters first, then the variables of the class body
+    std::vector<Symbol> fields;
+    std::unordered_map<std::string, int> fieldSlots;
+
+    // Annotated type of each field, UNKNOWN for fields without an annotation
+    std::vector<StaticType> fieldTypes;
+
+    // Indexed by method selector, nullptr for methods the class doesn't have
+    std::vector<FunctionDefinitionNode *> methodTable;
+
+    // Scope the class was defined in, methods run inside of it
+    Scope *scope = nullptr;
+
+    explicit Shape(ClassDefinitionNode *node);
+
+    // Slot of a field, or -1
+    [[nodiscard]] int findField(const std::string &field) const;
+
+    // The method for a selector, or nullptr
+    [[nodiscard]] FunctionDefinitionNode *findMethod(int selector) const;
+};
+
+// An instance of a class, the fields are stored in the slots given by the shape.
+class ObjectInstance {
+public:
+    std::shared_ptr<Shape> shape;
+    std::vector<BasicValue> slots;
+
+    explicit ObjectInstance(std::shared_ptr<Shape> shape) : shape(std::move(shape)) {
+        this->slots.resize(this->shape->fields.size());
+    }
+};
+
+#endif //ACL_OBJECT_H
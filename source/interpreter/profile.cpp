@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+#include <functional>
+#include <sstream>
+#include "../main.h"
+#include "../parser/optimizer.h"
+
+// Calling visit for every node of the file with its site, in preorder
+static void forEachSite(AbstractSyntaxTree *tree, const std::function<void(AstChild *, int)> &visit) {
+    int next = 0;
+
+    std::function<void(AstChild *)> walk = [&](AstChild *node) {
+        visit(node, next++);
+
+        Optimizer::forEachChild(node, [&walk](std::unique_ptr<AstChild> &child, bool) {
+            if (child != nullptr)
+                walk(child.get());
+        });
+    };
+
+    for (auto child: tree->children)
+        walk(child);
+}
+
+// The path a parsed file is known by, empty if it isn't parsed
+static std::string parsedPath(AbstractSyntaxTree *tree) {
+    for (auto &[path, parsed]: parsed_files)
+        if (parsed == tree)
+            return path;
+
+    return "";
+}
+
+void Profile::recordOperands(ExpressionNode *node, BasicValue::Type left, BasicValue::Type right) {
+    auto &item = this->feedback[node];
+
+    if (left == BasicValue::Type::INT && right == BasicValue::Type::INT)
+        item.operands |= INTS;
+    else if (left == BasicValue::Type::FLOAT && right == BasicValue::Type::FLOAT)
+        item.operands |= FLOATS;
+    else
+        item.operands |= OTHERS;
+
+    item.count++;
+}
+
+void Profile::recordCall(FunctionCallNode *node, FunctionDefinitionNode *target) {
+    auto &item = this->feedback[node];
+
+    // Sites which called different functions keep nullptr
+    if (item.count == 0 || item.target != target)
+        item.target = item.count == 0 ? target : nullptr;
+
+    item.count++;
+}
+
+void Profile::recordBranch(IfStatementNode *node, bool taken) {
+    auto &item = this->feedback[node];
+
+    if (taken)
+        item.count++;
+    else
+        item.other++;
+}
+
+void Profile::recordIteration(WhileStatementNode *node) {
+    this->feedback[node].count++;
+}
+
+void Profile::recordCase(SwitchStatementNode *node, SwitchCaseNode *selected) {
+    auto &item = this->feedback[node];
+
+    for (size_t i = 0; i < node->cases.size(); i++)
+        if (node->cases[i].get() == selected)
+            item.cases[(int) i]++;
+
+    item.count++;
+}
+
+void Profile::write(std::ostream &stream) const {
+    // Where the nodes are, to write the functions call sites called
+    std::unordered_map<AstChild *, std::string> sites;
+
+    for (size_t i = 0; i < parsed_files.size(); i++)
+        forEachSite(parsed_files[i].second, [&sites, i](AstChild *node, int site) {
+            if (node->getIdentifier() == "FunctionDefinition")
+                sites[node] = std::to_string(i) + ":" + std::to_string(site);
+        });
+
+    stream << "acl-profile 1" << std::endl;
+
+    for (auto &[path, tree]: parsed_files) {
+        stream << "file " << hash(parsed_sources.at(path)) << " " << path << std::endl;
+
+        forEachSite(tree, [this, &stream, &sites](AstChild *node, int site) {
+            auto found = this->feedback.find(node);
+            auto read = this->carried.find(node);
+
+            if (found == this->feedback.end() && read == this->carried.end())
+                return;
+
+            auto item = found != this->feedback.end() ? found->second : Feedback();
+
+            if (read != this->carried.end()) {
+                item.operands |= read->second.operands;
+                item.count = std::max(item.count, read->second.count);
+            }
+            auto identifier = node->getIdentifier();
+
+            if (identifier == "Expression") {
+                auto types = item.operands == INTS ? "int" : item.operands == FLOATS ? "float" : "mixed";
+                stream << "operands " << site << " " << types << " " << item.count << std::endl;
+            } else if (identifier == "FunctionCall") {
+                auto target = item.target != nullptr && sites.contains(item.target) ? sites.at(item.target) : "*";
+                stream << "call " << site << " " << target << " " << item.count << std::endl;
+            } else if (identifier == "IfStatement") {
+                stream << "branch " << site << " " << item.count << " " << item.other << std::endl;
+            } else if (identifier == "WhileStatement") {
+                stream << "loop " << site << " " << item.count << std::endl;
+            } else if (identifier == "SwitchStatement") {
+                stream << "switch " << site;
+
+                for (auto &[index, count]: item.cases)
+                    stream << " " << index << ":" << count;
+
+                stream << std::endl;
+            }
+        });
+    }
+}
+
+void Profile::read(std::istream &stream) {
+    std::string word;
+    int version;
+
+    if (!(stream >> word >> version) || word != "acl-profile" || version != 1)
+        throw std::runtime_error("Not a profile written by --profile-out");
+
+    // Paths by the index of the file, calls can refer to files which come later
+    std::vector<std::string> paths;
+    std::vector<std::tuple<size_t, int, int64_t>> calls;
+    FileFeedback *current = nullptr;
+
+    while (stream >> word) {
+        std::string line;
+        std::getline(stream, line);
+        std::istringstream fields(line);
+
+        if (word == "file") {
+            uint64_t hash;
+            std::string path;
+
+            fields >> hash;
+            std::getline(fields >> std::ws, path);
+
+            paths.push_back(path);
+            current = &this->files[path];
+            current->hash = hash;
+            continue;
+        }
+
+        int site;
+
+        if (current == nullptr || !(fields >> site))
+            throw std::runtime_error("Broken profile, line: " + word + line);
+
+        if (word == "operands") {
+            std::string types;
+            fields >> types;
+            current->operands[site] = types == "int" ? INTS : types == "float" ? FLOATS : OTHERS;
+        } else if (word == "loop") {
+            fields >> current->iterations[site];
+        } else if (word == "call") {
+            std::string target;
+            int64_t count = 0;
+            fields >> target >> count;
+
+            auto colon = target.find(':');
+
+            if (colon != std::string::npos)
+                calls.emplace_back(std::stoul(target.substr(0, colon)), std::stoi(target.substr(colon + 1)), count);
+        }
+
+        // Branches and switches aren't used yet
+    }
+
+    for (auto &[file, site, count]: calls)
+        if (file < paths.size())
+            this->files[paths[file]].calls[site] += count;
+}
+
+void Profile::apply(AbstractSyntaxTree *tree, jit::Jit *jit) {
+    if (!this->applied.insert(tree).second)
+        return;
+
+    auto path = parsedPath(tree);
+    auto found = this->files.find(path);
+
+    if (found == this->files.end())
+        return;
+
+    auto &file = found->second;
+
+    if (file.hash != hash(parsed_sources.at(path))) {
+        this->ignoredFiles++;
+        return;
+    }
+
+    forEachSite(tree, [this, &file, jit](AstChild *node, int site) {
+        auto identifier = node->getIdentifier();
+
+        if (identifier == "Expression" && file.operands.contains(site)) {
+            auto expression = dynamic_cast<ExpressionNode *>(node);
+            auto types = file.operands.at(site);
+
+            if (expression->operands != StaticType::UNKNOWN || (types != INTS && types != FLOATS))
+                return;
+
+            expression->operands = types == INTS ? StaticType::INT : StaticType::FLOAT;
+            this->carried[node].operands = types;
+            this->specialized++;
+        } else if (identifier == "FunctionDefinition" && jit != nullptr && file.calls.contains(site)) {
+            auto &compiled = jit->function(dynamic_cast<FunctionDefinitionNode *>(node));
+
+            // Compiled at the next call
+            if (file.calls.at(site) >= jit->callThreshold && compiled.state == jit::CodeState::COLD) {
+                compiled.calls = std::max(compiled.calls, jit->callThreshold - 1);
+                this->compiledFunctions++;
+            }
+        } else if (identifier == "WhileStatement" && jit != nullptr && file.iterations.contains(site)) {
+            auto &compiled = jit->loop(dynamic_cast<WhileStatementNode *>(node));
+
+            // Compiled the next time it starts
+            if (file.iterations.at(site) >= jit->loopThreshold && compiled.state == jit::CodeState::COLD) {
+                compiled.iterations = std::max(compiled.iterations, jit->loopThreshold);
+                this->carried[node].count = file.iterations.at(site);
+                this->compiledLoops++;
+            }
+        }
+    });
+}
+
+void Profile::printStats(std::ostream &stream) const {
+    if (this->files.empty())
+        return;
+
+    stream << "profile: " << this->specialized << " expressions specialized, " << this->compiledFunctions
+           << " functions and " << this->compiledLoops << " loops compiled early, " << this->ignoredFiles
+           << " changed files ignored" << std::endl;
+}
+
+uint64_t Profile::hash(const std::string &source) {
+    // FNV-1a, the same in every build. The optimizations change the numbering of the sites.
+    uint64_t hash = 14695981039346656037ull;
+
+    for (unsigned char c: source + (optimize_files ? "1" : "0")) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
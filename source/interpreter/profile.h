@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_PROFILE_H
+#define ACL_PROFILE_H
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../parser/ast.h"
+#include "../jit/jit.h"
+#include "type.h"
+
+// Type feedback of a run, recorded per site with --profile-out and used by the next runs with
+// --profile-in:
+//
+// - The operand types of binary expressions. Expressions the type inference couldn't tell which only
+//   got ints (or floats) are specialized like inferred ones, the tags are still checked.
+// - The functions each call site called, functions which were called often are compiled at their
+//   first call.
+// - The iterations of while loops, loops which got hot are compiled the first time they run.
+// - Branches taken by if statements and cases selected by switch statements, only written for now.
+//
+// The feedback read for sites an earlier run specialized or compiled is written again, compiled
+// loops don't record their iterations.
+//
+// Sites are the nodes of a file numbered in preorder, which is the same in every run as long as the
+// source and the optimizations don't change. Files whose source changed are ignored.
+class Profile {
+public:
+    // Recording feedback while the program runs, only with --profile-out
+    bool recording = false;
+
+    void recordOperands(ExpressionNode *node, BasicValue::Type left, BasicValue::Type right);
+
+    void recordCall(FunctionCallNode *node, FunctionDefinitionNode *target);
+
+    void recordBranch(IfStatementNode *node, bool taken);
+
+    void recordIteration(WhileStatementNode *node);
+
+    void recordCase(SwitchStatementNode *node, SwitchCaseNode *selected);
+
+    // Writing the feedback of all parsed files
+    void write(std::ostream &stream) const;
+
+    // Reading feedback written by an earlier run, throws if it isn't a profile
+    void read(std::istream &stream);
+
+    // Using the feedback read for a file once it is parsed, jit is nullptr without compiler
+    void apply(AbstractSyntaxTree *tree, jit::Jit *jit);
+
+    void printStats(std::ostream &stream) const;
+
+private:
+    // What is recorded at one site
+    struct Feedback {
+        // Operand types seen by an expression, see OperandTypes
+        int operands = 0;
+
+        // Evaluations of an expression, calls made by a call site, iterations of a loop or branches taken
+        int64_t count = 0;
+
+        // Branches not taken
+        int64_t other = 0;
+
+        // The function a call site called, nullptr if it called different functions
+        FunctionDefinitionNode *target = nullptr;
+
+        // Times each case of a switch was selected, by index
+        std::map<int, int64_t> cases;
+    };
+
+    enum OperandTypes {
+        INTS = 1,
+        FLOATS = 2,
+        OTHERS = 4,
+    };
+
+    // Feedback read for a file
+    struct FileFeedback {
+        uint64_t hash;
+
+        // Operand types of expressions and iterations of loops, by site
+        std::unordered_map<int, int> operands;
+        std::unordered_map<int, int64_t> iterations;
+
+        // Calls of the functions defined in the file, from all call sites, by the site of the definition
+        std::unordered_map<int, int64_t> calls;
+    };
+
+    std::unordered_map<AstChild *, Feedback> feedback;
+
+    // Feedback read for the sites apply used, merged into the feedback of this run when it is written
+    std::unordered_map<AstChild *, Feedback> carried;
+
+    std::unordered_map<std::string, FileFeedback> files;
+    std::unordered_set<AbstractSyntaxTree *> applied;
+
+    // For --stats
+    int specialized = 0;
+    int compiledFunctions = 0;
+    int compiledLoops = 0;
+    int ignoredFiles = 0;
+
+    // Identifying the version of a file the feedback belongs to
+    static uint64_t hash(const std::string &source);
+};
+
+#endif //ACL_PROFILE_H
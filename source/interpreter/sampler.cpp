@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sampler.h"
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <csignal>
+#include <sys/time.h>
+
+std::atomic<int> Sampler::pending = 0;
+
+void Sampler::handleSignal(int) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Sampler::start() {
+    struct sigaction action{};
+    action.sa_handler = handleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+
+    struct itimerval timer{};
+    timer.it_interval.tv_usec = 1000000 / FREQUENCY;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+void Sampler::stop() {
+    struct itimerval timer{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    signal(SIGPROF, SIG_IGN);
+}
+
+void Sampler::sample(const std::vector<Frame> &stack) {
+    auto count = pending.exchange(0, std::memory_order_relaxed);
+
+    if (count == 0 || stack.empty())
+        return;
+
+    std::string collapsed;
+    std::set<std::string> seen;
+
+    for (auto &frame: stack) {
+        if (!collapsed.empty())
+            collapsed += ";";
+
+        collapsed += frame.name + ":" + std::to_string(frame.line + 1);
+
+        // Recursive functions are counted once per stack
+        if (seen.insert(frame.name).second)
+            this->functions[frame.name] += count;
+    }
+
+    auto &leaf = stack.back();
+
+    this->stacks[collapsed] += count;
+    this->lines[leaf.name + " (line " + std::to_string(leaf.line + 1) + ")"] += count;
+    this->samples += count;
+}
+
+void Sampler::writeCollapsed(std::ostream &stream) const {
+    for (auto &[stack, count]: this->stacks)
+        stream << stack << " " << count << std::endl;
+}
+
+// The entries with the most samples, most first
+static std::vector<std::pair<std::string, int64_t>> top(const std::map<std::string, int64_t> &counts) {
+    std::vector<std::pair<std::string, int64_t>> entries(counts.begin(), counts.end());
+
+    std::stable_sort(entries.begin(), entries.end(), [](auto &a, auto &b) { return a.second > b.second; });
+
+    if (entries.size() > Sampler::TOP)
+        entries.resize(Sampler::TOP);
+
+    return entries;
+}
+
+void Sampler::printSummary(std::ostream &stream) const {
+    stream << "profile: " << this->samples << " samples, " << 1000 / FREQUENCY << " ms of CPU time each" << std::endl;
+
+    if (this->samples == 0)
+        return;
+
+    auto print = [this, &stream](const std::string &title, const std::map<std::string, int64_t> &counts) {
+        stream << title << std::endl;
+
+        for (auto &[name, count]: top(counts))
+            stream << std::setw(8) << count << std::setw(7) << std::fixed << std::setprecision(1)
+                   << 100.0 * (double) count / (double) this->samples << "%  " << name << std::endl;
+    };
+
+    print("lines:", this->lines);
+    print("functions, with their calls:", this->functions);
+}
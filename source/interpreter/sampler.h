@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_SAMPLER_H
+#define ACL_SAMPLER_H
+
+#include <atomic>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Sampling the ACL call stack, turned on with --profile. A SIGPROF timer counts the samples which are
+// due, the interpreter takes them before its next statement or when a call returns, so the signal
+// handler doesn't touch the interpreter. The time until then (e.g. in builtins or compiled code) goes to
+// the line which was running.
+//
+// The stacks are written in the collapsed format of flamegraph tools, one line per stack:
+//
+//     main:12;fib:4;fib:6 17
+class Sampler {
+public:
+    // Samples per second of CPU time
+    static const int FREQUENCY = 1000;
+
+    // Lines and functions in the summary
+    static const int TOP = 10;
+
+    // A function on the stack and the line it is at, main for the code of the files
+    struct Frame {
+        std::string name;
+        int line;
+    };
+
+    // Starting the timer, only one sampler can run at a time
+    void start();
+
+    void stop();
+
+    // Whether samples are due
+    [[nodiscard]] static bool due() {
+        return pending.load(std::memory_order_relaxed) != 0;
+    }
+
+    // Taking the due samples with the stack, outermost frame first
+    void sample(const std::vector<Frame> &stack);
+
+    void writeCollapsed(std::ostream &stream) const;
+
+    // The lines with the most samples and the functions with the most samples under them
+    void printSummary(std::ostream &stream) const;
+
+private:
+    static std::atomic<int> pending;
+
+    static void handleSignal(int);
+
+    // Samples by collapsed stack
+    std::map<std::string, int64_t> stacks;
+
+    // Samples at a line, and samples of stacks a function is on
+    std::map<std::string, int64_t> lines;
+    std::map<std::string, int64_t> functions;
+
+    int64_t samples = 0;
+};
+
+#endif //ACL_SAMPLER_H
@@ -17,9 +17,53 @@
 #ifndef ACL_TYPE_H
 #define ACL_TYPE_H
 
+#include <concepts>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
 #include <vector>
+#include "cow.h"
+
+class BasicValue;
+
+class FileHandle;
+
+class ValueMap;
+
+class NumericArray;
+
+class ObjectInstance;
+
+class PersistentVector;
+
+class BigInt;
+
+// Text representation of a map, defined next to the map itself
+std::string mapToString(ValueMap &map);
+
+// Text representation of a numeric array, defined next to the array itself
+std::string arrayToString(NumericArray &array);
+
+// Text representation of a class instance, defined next to the object model
+std::string objectToString(ObjectInstance &object);
+
+// Text representation of a persistent vector, defined next to the vector itself
+std::string vectorToString(PersistentVector &vector);
+
+// Text representation of a big integer, defined next to the big integer itself
+std::string bigIntToString(BigInt &value);
+
+// A lazily evaluated sequence, for loops pull one element at a time out of it.
+class ValueIterator {
+public:
+    virtual ~ValueIterator() = default;
+
+    // Fetching the next element, returns false if there are no elements left
+    virtual bool next(BasicValue &value) = 0;
+};
 
 class BasicValue {
 public:
@@ -29,46 +73,132 @@ public:
         STRING,
         LIST,
         VOID,
+        ITERATOR,
+        HANDLE,
+        MAP,
+        ARRAY,
+        OBJECT,
+        VECTOR,
+        BIGINT,
     };
 
     Type type;
 
-    int intValue{};
-    float floatValue{};
-    std::string stringValue;
-    std::vector<BasicValue> listValue;
-    bool is_class_instance;
+    int64_t intValue{};
+    double floatValue{};
 
-    explicit BasicValue(int value) : type(INT), intValue(value) {}
+    // The payload of the other types, only the member of the type is alive. Strings and lists are
+    // shared between copies, and only copied when one of them changes.
+    union {
+        SharedString stringValue;
+        Cow<std::vector<BasicValue>> listValue;
+        std::shared_ptr<ValueIterator> iteratorValue;
+        std::shared_ptr<FileHandle> handleValue;
+        std::shared_ptr<ValueMap> mapValue;
+        std::shared_ptr<NumericArray> arrayValue;
+        std::shared_ptr<ObjectInstance> objectValue;
+        std::shared_ptr<PersistentVector> vectorValue;
+        std::shared_ptr<BigInt> bigValue;
+    };
 
-    explicit BasicValue(float value) : type(FLOAT), floatValue(value) {}
+    // Any integer type, sizes and counts included
+    template<std::integral T>
+    explicit BasicValue(T value) : type(INT), intValue((int64_t) value) {}
 
-    explicit BasicValue(std::string value, bool is_class_instance = false) : type(STRING), stringValue(std::move(value)), is_class_instance(is_class_instance) {
-        // Replacing all '\\n' with a new line character.
-        auto a = stringValue.find("\\n");
-        while (a != std::string::npos) {
-            stringValue.replace(a, 2, "\n");
-            a = stringValue.find("\\n");
-        }
-    }
+    // Conditions are ints, 1 for true and 0 for false
+    explicit BasicValue(bool value) : type(INT), intValue(value ? 1 : 0) {}
+
+    explicit BasicValue(double value) : type(FLOAT), floatValue(value) {}
 
-    explicit BasicValue() : type(VOID), stringValue("void"), intValue(0) {}
+    // Escape sequences are already replaced by the lexer
+    explicit BasicValue(std::string value) : type(STRING), stringValue(std::move(value)) {}
+
+    explicit BasicValue(SharedString value) : type(STRING), stringValue(std::move(value)) {}
+
+    explicit BasicValue() : type(VOID), intValue(0) {}
 
     explicit BasicValue(std::vector<BasicValue> value) : type(LIST), listValue(std::move(value)) {}
 
-    std::string getValue() {
+    explicit BasicValue(std::shared_ptr<ValueIterator> value) : type(ITERATOR), iteratorValue(std::move(value)) {}
+
+    explicit BasicValue(std::shared_ptr<FileHandle> value) : type(HANDLE), handleValue(std::move(value)) {}
+
+    // Maps are shared between all values referencing them, just like file handles
+    explicit BasicValue(std::shared_ptr<ValueMap> value) : type(MAP), mapValue(std::move(value)) {}
+
+    explicit BasicValue(std::shared_ptr<NumericArray> value) : type(ARRAY), arrayValue(std::move(value)) {}
+
+    // Instances are shared, changing a field is visible through every value referencing the instance
+    explicit BasicValue(std::shared_ptr<ObjectInstance> value) : type(OBJECT), objectValue(std::move(value)) {}
+
+    // Vectors are immutable, every change creates a new vector sharing most of its structure
+    explicit BasicValue(std::shared_ptr<PersistentVector> value) : type(VECTOR), vectorValue(std::move(value)) {}
+
+    // Big integers are immutable, arithmetic creates new ones
+    explicit BasicValue(std::shared_ptr<BigInt> value) : type(BIGINT), bigValue(std::move(value)) {}
+
+    BasicValue(const BasicValue &other) : type(other.type), intValue(other.intValue), floatValue(other.floatValue) {
+        forPayload(this->type, [this, &other](auto member) {
+            using T = std::remove_reference_t<decltype(this->*member)>;
+            new(&(this->*member)) T(other.*member);
+        });
+    }
+
+    // The value moved from keeps its type, with an empty payload
+    BasicValue(BasicValue &&other) noexcept
+            : type(other.type), intValue(other.intValue), floatValue(other.floatValue) {
+        forPayload(this->type, [this, &other](auto member) {
+            using T = std::remove_reference_t<decltype(this->*member)>;
+            new(&(this->*member)) T(std::move(other.*member));
+        });
+    }
+
+    // The other value can be part of this one (e.g. an element of its list), so it is copied before
+    // the payload is destroyed
+    BasicValue &operator=(const BasicValue &other) {
+        if (this != &other)
+            *this = BasicValue(other);
+
+        return *this;
+    }
+
+    BasicValue &operator=(BasicValue &&other) noexcept {
+        if (this == &other)
+            return *this;
+
+        // Moved out first, the other value can be part of this one as well
+        BasicValue moved(std::move(other));
+
+        this->destroy();
+        this->type = moved.type;
+        this->intValue = moved.intValue;
+        this->floatValue = moved.floatValue;
+
+        forPayload(this->type, [this, &moved](auto member) {
+            using T = std::remove_reference_t<decltype(this->*member)>;
+            new(&(this->*member)) T(std::move(moved.*member));
+        });
+
+        return *this;
+    }
+
+    ~BasicValue() {
+        this->destroy();
+    }
+
+    [[nodiscard]] std::string getValue() const {
         switch (type) {
             case INT:
                 return std::to_string(intValue);
             case FLOAT:
                 return std::to_string(floatValue);
             case STRING:
-                return stringValue;
+                return std::string(stringValue.view());
             case LIST: {
                 std::string os;
 
                 os += "[";
-                for (auto &v: listValue) {
+                for (auto &v: *listValue) {
                     os += v.getValue() + ", ";
                 }
                 os += "]";
@@ -77,10 +207,69 @@ public:
             }
             case VOID:
                 break;
+            case ITERATOR:
+                return "iterator";
+            case HANDLE:
+                return "file";
+            case MAP:
+                return mapToString(*mapValue);
+            case ARRAY:
+                return arrayToString(*arrayValue);
+            case OBJECT:
+                return objectToString(*objectValue);
+            case VECTOR:
+                return vectorToString(*vectorValue);
+            case BIGINT:
+                return bigIntToString(*bigValue);
         }
 
         return "void";
     }
+
+private:
+    // Calling f with a pointer to the member holding the payload of the type. Ints, floats and void
+    // don't have one.
+    template<typename F>
+    static void forPayload(Type type, F &&f) {
+        switch (type) {
+            case STRING:
+                f(&BasicValue::stringValue);
+                break;
+            case LIST:
+                f(&BasicValue::listValue);
+                break;
+            case ITERATOR:
+                f(&BasicValue::iteratorValue);
+                break;
+            case HANDLE:
+                f(&BasicValue::handleValue);
+                break;
+            case MAP:
+                f(&BasicValue::mapValue);
+                break;
+            case ARRAY:
+                f(&BasicValue::arrayValue);
+                break;
+            case OBJECT:
+                f(&BasicValue::objectValue);
+                break;
+            case VECTOR:
+                f(&BasicValue::vectorValue);
+                break;
+            case BIGINT:
+                f(&BasicValue::bigValue);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void destroy() {
+        forPayload(this->type, [this](auto member) {
+            using T = std::remove_reference_t<decltype(this->*member)>;
+            (this->*member).~T();
+        });
+    }
 };
 
 #endif //ACL_TYPE_H
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "vector.h"
+#include <algorithm>
+
+PersistentVector::PersistentVector() : root(std::make_shared<Node>()), tail(std::make_shared<Node>()) {}
+
+size_t PersistentVector::size() const {
+    return this->end - this->start;
+}
+
+const BasicValue &PersistentVector::get(size_t index) const {
+    index += this->start;
+
+    return this->leafAt(index).values[index & MASK];
+}
+
+const BasicValue *PersistentVector::elementsFrom(size_t index, size_t &available) const {
+    index += this->start;
+
+    auto &leaf = this->leafAt(index);
+    available = std::min(leaf.values.size() - (index & MASK), this->end - index);
+
+    return &leaf.values[index & MASK];
+}
+
+PersistentVector PersistentVector::with(size_t index, BasicValue value) const {
+    return this->assign(this->start + index, std::move(value));
+}
+
+PersistentVector PersistentVector::push(BasicValue value) const {
+    // Elements of the trie behind the end of the view aren't visible, so they can be replaced
+    if (this->end < this->count) {
+        auto result = this->assign(this->end, std::move(value));
+        result.end++;
+
+        return result;
+    }
+
+    return this->append(std::move(value));
+}
+
+PersistentVector PersistentVector::slice(size_t from, size_t to) const {
+    auto result = *this;
+    result.start = this->start + from;
+    result.end = this->start + to;
+
+    return result;
+}
+
+size_t PersistentVector::tailOffset() const {
+    return this->count < WIDTH ? 0 : ((this->count - 1) >> BITS) << BITS;
+}
+
+const PersistentVector::Node &PersistentVector::leafAt(size_t index) const {
+    if (index >= this->tailOffset())
+        return *this->tail;
+
+    auto node = this->root.get();
+
+    for (int level = this->shift; level > 0; level -= BITS)
+        node = node->children[(index >> level) & MASK].get();
+
+    return *node;
+}
+
+PersistentVector PersistentVector::assign(size_t index, BasicValue value) const {
+    auto result = *this;
+
+    if (index >= this->tailOffset()) {
+        auto tail = std::make_shared<Node>(*this->tail);
+        tail->values[index & MASK] = std::move(value);
+        result.tail = tail;
+    } else {
+        result.root = assignInNode(this->shift, this->root, index, std::move(value));
+    }
+
+    return result;
+}
+
+PersistentVector PersistentVector::append(BasicValue value) const {
+    auto result = *this;
+
+    if (this->count - this->tailOffset() < WIDTH) {
+        // There is still room in the tail
+        auto tail = std::make_shared<Node>(*this->tail);
+        tail->values.push_back(std::move(value));
+        result.tail = tail;
+    } else {
+        // The full tail moves into the trie, which gets a new level if the root is full
+        if ((this->count >> BITS) > ((size_t) 1 << this->shift)) {
+            auto root = std::make_shared<Node>();
+            root->children.push_back(this->root);
+            root->children.push_back(newPath(this->shift, this->tail));
+
+            result.root = root;
+            result.shift += BITS;
+        } else {
+            result.root = this->pushTail(this->shift, this->root, this->tail);
+        }
+
+        auto tail = std::make_shared<Node>();
+        tail->values.push_back(std::move(value));
+        result.tail = tail;
+    }
+
+    result.count++;
+    result.end++;
+
+    return result;
+}
+
+PersistentVector::NodePointer PersistentVector::assignInNode(int level, const NodePointer &node, size_t index,
+                                                             BasicValue value) {
+    auto copy = std::make_shared<Node>(*node);
+
+    if (level == 0)
+        copy->values[index & MASK] = std::move(value);
+    else {
+        auto child = (index >> level) & MASK;
+        copy->children[child] = assignInNode(level - BITS, node->children[child], index, std::move(value));
+    }
+
+    return copy;
+}
+
+PersistentVector::NodePointer PersistentVector::pushTail(int level, const NodePointer &parent,
+                                                         const NodePointer &leaf) const {
+    auto child = ((this->count - 1) >> level) & MASK;
+    auto copy = std::make_shared<Node>(*parent);
+    NodePointer inserted;
+
+    if (level == BITS)
+        inserted = leaf;
+    else if (child < parent->children.size())
+        inserted = this->pushTail(level - BITS, parent->children[child], leaf);
+    else
+        inserted = newPath(level - BITS, leaf);
+
+    if (child < copy->children.size())
+        copy->children[child] = inserted;
+    else
+        copy->children.push_back(inserted);
+
+    return copy;
+}
+
+PersistentVector::NodePointer PersistentVector::newPath(int level, const NodePointer &leaf) {
+    if (level == 0)
+        return leaf;
+
+    auto node = std::make_shared<Node>();
+    node->children.push_back(newPath(level - BITS, leaf));
+
+    return node;
+}
+
+bool VectorIterator::next(BasicValue &value) {
+    if (this->index >= this->vector->size())
+        return false;
+
+    // Looking up the leaf only once per leaf, not once per element
+    if (this->available == 0)
+        this->element = this->vector->elementsFrom(this->index, this->available);
+
+    value = *this->element++;
+    this->available--;
+    this->index++;
+
+    return true;
+}
+
+std::string vectorToString(PersistentVector &vector) {
+    std::string result = "vector(";
+
+    for (size_t i = 0; i < vector.size(); i++) {
+        if (i > 0)
+            result += ", ";
+
+        result += vector.get(i).getValue();
+    }
+
+    return result + ")";
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_VECTOR_H
+#define ACL_VECTOR_H
+
+#include <memory>
+#include <vector>
+#include "type.h"
+
+// Immutable vector with structural sharing, a 32-way trie plus a tail holding the last
+// (up to) 32 elements. Changing an element or appending copies only the path from the
+// root to the changed leaf, O(log32 n), and every older version stays valid.
+//
+// A vector can also be a view on a range of a larger trie, which makes slicing O(1).
+// Views keep the whole trie alive.
+class PersistentVector {
+public:
+    PersistentVector();
+
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] const BasicValue &get(size_t index) const;
+
+    // A copy with one element replaced
+    [[nodiscard]] PersistentVector with(size_t index, BasicValue value) const;
+
+    // A copy with a value added to the end
+    [[nodiscard]] PersistentVector push(BasicValue value) const;
+
+    // A view on the elements from `from` up to (not including) `to`
+    [[nodiscard]] PersistentVector slice(size_t from, size_t to) const;
+
+    // Pointer to an element, and in `available` how many elements follow it in the same leaf (including itself)
+    [[nodiscard]] const BasicValue *elementsFrom(size_t index, size_t &available) const;
+
+private:
+    static const int BITS = 5;
+    static const size_t WIDTH = 1 << BITS;
+    static const size_t MASK = WIDTH - 1;
+
+    struct Node {
+        // Children of an inner node, or the elements of a leaf
+        std::vector<std::shared_ptr<const Node>> children;
+        std::vector<BasicValue> values;
+    };
+
+    typedef std::shared_ptr<const Node> NodePointer;
+
+    // The whole trie, `count` elements of which the view shows `start` up to `end`
+    NodePointer root;
+    NodePointer tail;
+    size_t count = 0;
+    int shift = BITS;
+    size_t start = 0;
+    size_t end = 0;
+
+    // Index of the first element in the tail
+    [[nodiscard]] size_t tailOffset() const;
+
+    // Indices below are relative to the whole trie, not the view
+    [[nodiscard]] const Node &leafAt(size_t index) const;
+
+    [[nodiscard]] PersistentVector assign(size_t index, BasicValue value) const;
+
+    [[nodiscard]] PersistentVector append(BasicValue value) const;
+
+    static NodePointer assignInNode(int level, const NodePointer &node, size_t index, BasicValue value);
+
+    [[nodiscard]] NodePointer pushTail(int level, const NodePointer &parent, const NodePointer &leaf) const;
+
+    static NodePointer newPath(int level, const NodePointer &leaf);
+};
+
+// Iterating over the elements of a persistent vector, one leaf at a time. Used by `for x in vector`.
+class VectorIterator : public ValueIterator {
+    std::shared_ptr<PersistentVector> vector;
+    const BasicValue *element = nullptr;
+    size_t available = 0;
+    size_t index = 0;
+
+public:
+    explicit VectorIterator(std::shared_ptr<PersistentVector> vector) : vector(std::move(vector)) {}
+
+    bool next(BasicValue &value) override;
+};
+
+#endif //ACL_VECTOR_H
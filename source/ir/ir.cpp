@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ir.h"
+#include <algorithm>
+
+namespace ir {
+
+std::string opcodeName(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::CONSTANT: return "const";
+        case Opcode::UNDEFINED: return "undefined";
+        case Opcode::PARAMETER: return "parameter";
+        case Opcode::PHI: return "phi";
+        case Opcode::BINARY: return "binary";
+        case Opcode::NEGATE: return "neg";
+        case Opcode::LOAD: return "load";
+        case Opcode::STORE: return "store";
+        case Opcode::DEFINE: return "define";
+        case Opcode::CALL: return "call";
+        case Opcode::CHANGED: return "changed";
+        case Opcode::METHOD_CALL: return "callmethod";
+        case Opcode::RESOLVES: return "resolves";
+        case Opcode::GET_FIELD: return "getfield";
+        case Opcode::SET_FIELD: return "setfield";
+        case Opcode::INDEX: return "index";
+        case Opcode::SET_INDEX: return "setindex";
+        case Opcode::LIST: return "list";
+        case Opcode::MAP: return "map";
+        case Opcode::MATCHES: return "matches";
+        case Opcode::ITERATE: return "iterate";
+        case Opcode::NEXT: return "next";
+        case Opcode::ELEMENT: return "element";
+        case Opcode::DEFINE_FUNCTION: return "function";
+        case Opcode::DEFINE_CLASS: return "class";
+        case Opcode::IMPORT: return "import";
+        case Opcode::JUMP: return "jump";
+        case Opcode::BRANCH: return "branch";
+        case Opcode::RETURN: return "return";
+    }
+
+    return "?";
+}
+
+std::string operatorName(Operator op) {
+    switch (op) {
+        case Operator::ADD: return "add";
+        case Operator::SUBTRACT: return "sub";
+        case Operator::MULTIPLY: return "mul";
+        case Operator::DIVIDE: return "div";
+        case Operator::MODULO: return "mod";
+        case Operator::EQUAL: return "eq";
+        case Operator::NOT_EQUAL: return "ne";
+        case Operator::LESS: return "lt";
+        case Operator::GREATER: return "gt";
+        case Operator::LESS_EQUAL: return "le";
+        case Operator::GREATER_EQUAL: return "ge";
+        case Operator::AND: return "and";
+        case Operator::OR: return "or";
+        default: return "?";
+    }
+}
+
+bool Instruction::isTerminator() const {
+    return this->opcode == Opcode::JUMP || this->opcode == Opcode::BRANCH || this->opcode == Opcode::RETURN;
+}
+
+bool Instruction::hasSideEffects() const {
+    switch (this->opcode) {
+        // Operators and indexing throw for values they don't support, those errors have to be kept
+        case Opcode::CONSTANT:
+        case Opcode::UNDEFINED:
+        case Opcode::PARAMETER:
+        case Opcode::PHI:
+        case Opcode::RESOLVES:
+        case Opcode::CHANGED:
+        case Opcode::LIST:
+        case Opcode::ELEMENT:
+            return false;
+        case Opcode::BINARY: {
+            auto left = this->operands[0]->type;
+            auto right = this->operands[1]->type;
+
+            // Ints overflow into big integers, only dividing by zero fails. Floats have no other
+            // operators than the arithmetic ones and comparisons.
+            if (left == StaticType::INT && right == StaticType::INT)
+                return this->op == Operator::DIVIDE || this->op == Operator::MODULO || this->op == Operator::UNKNOWN;
+
+            if (left == StaticType::FLOAT && right == StaticType::FLOAT)
+                return this->op != Operator::ADD && this->op != Operator::SUBTRACT &&
+                       this->op != Operator::MULTIPLY && !isComparison(this->op);
+
+            return true;
+        }
+        case Opcode::NEGATE:
+            return this->operands[0]->type != StaticType::INT && this->operands[0]->type != StaticType::FLOAT;
+        default:
+            return true;
+    }
+}
+
+// Values are written as %<id>
+static void printValue(std::ostream &stream, const Instruction *value) {
+    stream << "%" << value->id;
+}
+
+void Instruction::print(std::ostream &stream) const {
+    auto hasValue = this->opcode != Opcode::STORE && this->opcode != Opcode::DEFINE &&
+                    this->opcode != Opcode::SET_FIELD && this->opcode != Opcode::DEFINE_FUNCTION &&
+                    this->opcode != Opcode::DEFINE_CLASS && this->opcode != Opcode::IMPORT && !this->isTerminator();
+
+    stream << "    ";
+
+    if (hasValue) {
+        printValue(stream, this);
+
+        if (this->type != StaticType::UNKNOWN)
+            stream << ": " << typeName(this->type);
+
+        stream << " = ";
+    }
+
+    auto list = [&stream](const std::vector<Instruction *> &values, size_t from) {
+        for (size_t i = from; i < values.size(); i++) {
+            if (i > from)
+                stream << ", ";
+
+            printValue(stream, values[i]);
+        }
+    };
+
+    switch (this->opcode) {
+        case Opcode::CONSTANT:
+            stream << "const ";
+
+            if (this->type == StaticType::INT)
+                stream << this->intValue;
+            else if (this->type == StaticType::FLOAT)
+                stream << std::to_string(this->floatValue);
+            else if (this->type == StaticType::STRING)
+                stream << "\"" << this->text << "\"";
+            else
+                stream << this->text;
+            break;
+        case Opcode::PARAMETER:
+            stream << "parameter " << this->intValue << " " << this->name;
+            break;
+        case Opcode::PHI:
+            stream << "phi ";
+
+            for (size_t i = 0; i < this->operands.size(); i++) {
+                if (i > 0)
+                    stream << ", ";
+
+                printValue(stream, this->operands[i]);
+                stream << " b" << this->block->predecessors[i]->id;
+            }
+            break;
+        case Opcode::BINARY:
+            stream << operatorName(this->op) << " ";
+            list(this->operands, 0);
+            break;
+        case Opcode::DEFINE_FUNCTION:
+            stream << "function " << this->name;
+
+            // External functions are implemented by the interpreter
+            if (this->function == nullptr)
+                stream << " external";
+            break;
+        case Opcode::LOAD:
+        case Opcode::RESOLVES:
+        case Opcode::DEFINE_CLASS:
+            stream << opcodeName(this->opcode) << " " << this->name;
+            break;
+        case Opcode::STORE:
+        case Opcode::DEFINE:
+            stream << opcodeName(this->opcode) << " " << this->name << ", ";
+            printValue(stream, this->operands[0]);
+            break;
+        case Opcode::CALL:
+            stream << "call " << this->name << "(";
+            list(this->operands, 0);
+            stream << ")";
+            break;
+        case Opcode::METHOD_CALL:
+            stream << "call ";
+            printValue(stream, this->operands[0]);
+            stream << "." << this->name << "(";
+            list(this->operands, 1);
+            stream << ")";
+            break;
+        case Opcode::GET_FIELD:
+            stream << "getfield ";
+            printValue(stream, this->operands[0]);
+            stream << "." << this->name;
+            break;
+        case Opcode::SET_FIELD:
+            stream << "setfield ";
+            printValue(stream, this->operands[0]);
+            stream << "." << this->name << ", ";
+            printValue(stream, this->operands[1]);
+            break;
+        case Opcode::IMPORT:
+            stream << "import \"" << this->text << "\"";
+            break;
+        case Opcode::JUMP:
+            stream << "jump b" << this->targets[0]->id;
+            break;
+        case Opcode::BRANCH:
+            stream << "branch ";
+            printValue(stream, this->operands[0]);
+            stream << ", b" << this->targets[0]->id << ", b" << this->targets[1]->id;
+            break;
+        case Opcode::RETURN:
+            stream << (this->tailCall ? "return tail" : "return");
+
+            if (!this->operands.empty()) {
+                stream << " ";
+                printValue(stream, this->operands[0]);
+            }
+            break;
+        default:
+            stream << opcodeName(this->opcode);
+
+            if (!this->operands.empty()) {
+                stream << " ";
+                list(this->operands, 0);
+            }
+    }
+
+    stream << std::endl;
+}
+
+Instruction *Block::terminator() const {
+    if (this->instructions.empty() || !this->instructions.back()->isTerminator())
+        return nullptr;
+
+    return this->instructions.back().get();
+}
+
+std::vector<Block *> Block::successors() const {
+    auto terminator = this->terminator();
+
+    if (terminator == nullptr || terminator->opcode == Opcode::RETURN)
+        return {};
+
+    if (terminator->opcode == Opcode::JUMP)
+        return {terminator->targets[0]};
+
+    return {terminator->targets[0], terminator->targets[1]};
+}
+
+void Block::removePredecessor(Block *predecessor) {
+    auto found = std::find(this->predecessors.begin(), this->predecessors.end(), predecessor);
+
+    if (found == this->predecessors.end())
+        return;
+
+    auto index = found - this->predecessors.begin();
+
+    this->predecessors.erase(found);
+
+    for (auto &instruction: this->instructions) {
+        if (instruction->opcode != Opcode::PHI)
+            break;
+
+        instruction->operands.erase(instruction->operands.begin() + index);
+    }
+}
+
+Block *Function::addBlock() {
+    this->blocks.push_back(std::make_unique<Block>(this->nextBlock++));
+
+    return this->blocks.back().get();
+}
+
+std::unique_ptr<Instruction> Function::create(Opcode opcode) {
+    return std::make_unique<Instruction>(opcode, this->nextValue++);
+}
+
+void Function::replaceUses(Instruction *value, Instruction *replacement) {
+    for (auto &block: this->blocks)
+        for (auto &instruction: block->instructions)
+            std::replace(instruction->operands.begin(), instruction->operands.end(), value, replacement);
+}
+
+std::vector<int> Function::countUses() const {
+    std::vector<int> uses(this->nextValue, 0);
+
+    for (auto &block: this->blocks)
+        for (auto &instruction: block->instructions)
+            for (auto operand: instruction->operands)
+                uses[operand->id]++;
+
+    return uses;
+}
+
+void Function::print(std::ostream &stream) const {
+    stream << "function " << this->name << "(";
+
+    for (size_t i = 0; i < this->parameters.size(); i++)
+        stream << (i > 0 ? ", " : "") << this->parameters[i];
+
+    stream << ") {" << std::endl;
+
+    for (auto &block: this->blocks) {
+        stream << "b" << block->id << ":";
+
+        if (!block->predecessors.empty()) {
+            stream << " ; from";
+
+            for (auto predecessor: block->predecessors)
+                stream << " b" << predecessor->id;
+        }
+
+        stream << std::endl;
+
+        for (auto &instruction: block->instructions)
+            instruction->print(stream);
+    }
+
+    stream << "}" << std::endl;
+}
+
+void Module::print(std::ostream &stream) const {
+    for (size_t i = 0; i < this->functions.size(); i++) {
+        if (i > 0)
+            stream << std::endl;
+
+        this->functions[i]->print(stream);
+    }
+}
+
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_IR_H
+#define ACL_IR_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../parser/ast.h"
+
+// A mid-level representation of a parsed file, between the tree and whatever runs it. Every function
+// is a graph of basic blocks ending in explicit jumps, and every value is defined exactly once (SSA),
+// so passes can follow values from their definitions to their uses without knowing about scopes.
+//
+// Variables a function defines itself are SSA values. Variables of the file, of enclosing functions or
+// fields seen from methods are read and written by name with LOAD and STORE, like the interpreter does.
+namespace ir {
+
+enum class Opcode {
+    // Values
+    CONSTANT,
+    UNDEFINED,
+    PARAMETER,
+    PHI,
+    BINARY,
+    NEGATE,
+
+    // Variables which aren't SSA values, looked up by name in the scopes when the code runs
+    LOAD,
+    STORE,
+    DEFINE,
+
+    // Calls of functions, builtins and constructors by name, and of methods
+    CALL,
+    CHANGED,
+    METHOD_CALL,
+    RESOLVES,
+
+    // Fields, elements and literals of lists and maps
+    GET_FIELD,
+    SET_FIELD,
+    INDEX,
+    SET_INDEX,
+    LIST,
+    MAP,
+
+    // Cases of switch statements, and iterating in for loops
+    MATCHES,
+    ITERATE,
+    NEXT,
+    ELEMENT,
+
+    // Definitions and imports
+    DEFINE_FUNCTION,
+    DEFINE_CLASS,
+    IMPORT,
+
+    // Terminators, the last instruction of every block
+    JUMP,
+    BRANCH,
+    RETURN,
+};
+
+class Block;
+
+class Function;
+
+class Instruction {
+public:
+    Opcode opcode;
+
+    // Number of the value, unique in its function
+    int id;
+
+    // What the value is known to be, UNKNOWN if it could be anything
+    StaticType type = StaticType::UNKNOWN;
+
+    std::vector<Instruction *> operands;
+
+    // Block the instruction is in
+    Block *block = nullptr;
+
+    // Constants, CONSTANT holds the digits of big integers in text
+    int64_t intValue = 0;
+    double floatValue = 0;
+    std::string text;
+
+    // The operator of BINARY
+    Operator op = Operator::UNKNOWN;
+
+    // Names of variables, called functions, fields and methods. PARAMETER holds its index in intValue.
+    Symbol name;
+
+    // Successors of JUMP (first) and BRANCH (first if the condition is 1, second otherwise)
+    Block *targets[2] = {nullptr, nullptr};
+
+    // The function DEFINE_FUNCTION defines, or RESOLVES checks the name for. RESOLVES always has the
+    // definition, the function only if it was lowered into the same module.
+    Function *function = nullptr;
+    FunctionDefinitionNode *definition = nullptr;
+
+    // RETURN of a CALL made in tail position
+    bool tailCall = false;
+
+    int line = 0;
+
+    Instruction(Opcode opcode, int id) : opcode(opcode), id(id) {}
+
+    [[nodiscard]] bool isTerminator() const;
+
+    // Whether the instruction does anything but compute its value, so it can't be removed if the
+    // value isn't used. Calls could also change any variable that isn't an SSA value.
+    [[nodiscard]] bool hasSideEffects() const;
+
+    [[nodiscard]] bool isConstant() const { return this->opcode == Opcode::CONSTANT; }
+
+    void print(std::ostream &stream) const;
+};
+
+class Block {
+public:
+    int id;
+
+    // Phis first, then the other instructions, then exactly one terminator
+    std::vector<std::unique_ptr<Instruction>> instructions;
+
+    // In the order of the operands of the phis
+    std::vector<Block *> predecessors;
+
+    explicit Block(int id) : id(id) {}
+
+    [[nodiscard]] Instruction *terminator() const;
+
+    [[nodiscard]] std::vector<Block *> successors() const;
+
+    // Removing a predecessor and the matching operand of every phi
+    void removePredecessor(Block *predecessor);
+};
+
+class Function {
+public:
+    Symbol name;
+    std::vector<Symbol> parameters;
+
+    // The first block is the entry
+    std::vector<std::unique_ptr<Block>> blocks;
+
+    // The definition lowered into the function, nullptr for the code of the file
+    FunctionDefinitionNode *definition = nullptr;
+
+    int nextValue = 0;
+    int nextBlock = 0;
+
+    Block *addBlock();
+
+    // Creating an instruction, appended to a block by the caller
+    std::unique_ptr<Instruction> create(Opcode opcode);
+
+    // Replacing every use of a value by another value
+    void replaceUses(Instruction *value, Instruction *replacement);
+
+    // Number of uses of every value, indexed by id
+    [[nodiscard]] std::vector<int> countUses() const;
+
+    void print(std::ostream &stream) const;
+};
+
+class Module {
+public:
+    // The code of the file first, then the functions, methods and class bodies in the order they are defined in
+    std::vector<std::unique_ptr<Function>> functions;
+
+    void print(std::ostream &stream) const;
+};
+
+// Name of an opcode in the text form
+std::string opcodeName(Opcode opcode);
+
+// Name of a binary operator in the text form, e.g. "add"
+std::string operatorName(Operator op);
+
+}
+
+#endif //ACL_IR_H
@@ -0,0 +1,911 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lowering.h"
+#include <algorithm>
+#include "../interpreter/functions.h"
+
+namespace ir {
+
+std::unique_ptr<Module> Lowering::lower(AbstractSyntaxTree *ast) {
+    this->module = std::make_unique<Module>();
+
+    std::vector<std::unique_ptr<AstChild>> body;
+
+    // The tree keeps owning its nodes, they are only borrowed for the lowering
+    for (auto child: ast->children)
+        body.emplace_back(child);
+
+    try {
+        this->lowerFunction("main", {}, body, nullptr);
+    } catch (...) {
+        for (auto &child: body)
+            child.release();
+
+        throw;
+    }
+
+    for (auto &child: body)
+        child.release();
+
+    for (auto [instruction, definition]: this->unresolved) {
+        auto function = this->lowered.find(definition);
+
+        if (function != this->lowered.end())
+            instruction->function = function->second;
+    }
+
+    return std::move(this->module);
+}
+
+std::unique_ptr<Module> Lowering::lower(FunctionDefinitionNode *definition) {
+    this->module = std::make_unique<Module>();
+    this->lowerFunction(definition->name, definition->parameters, definition->body, definition);
+
+    return std::move(this->module);
+}
+
+std::unique_ptr<Module> Lowering::lower(WhileStatementNode *loop, const std::vector<Symbol> &variables) {
+    this->module = std::make_unique<Module>();
+    this->module->functions.push_back(std::make_unique<Function>());
+
+    auto function = this->module->functions.back().get();
+    function->name = "while";
+    function->parameters = variables;
+
+    this->state = State();
+    this->state.function = function;
+    this->state.promote = !definesFunctions(loop);
+    this->state.current = function->addBlock();
+    this->state.sealed.insert(this->state.current);
+    this->state.scopes.emplace_back();
+
+    for (size_t i = 0; i < variables.size(); i++) {
+        auto instruction = function->create(Opcode::PARAMETER);
+        instruction->intValue = (int64_t) i;
+        instruction->name = variables[i];
+
+        this->define(variables[i], this->emit(std::move(instruction), loop->line), true, loop->line);
+    }
+
+    // Whatever runs the loop can go on from the stored values at the start of any iteration
+    auto store = [this, &variables, loop]() {
+        for (auto &variable: variables)
+            this->emit(Opcode::STORE, {this->read(variable, loop->line)}, loop->line)->name = variable;
+    };
+
+    auto header = function->addBlock();
+    auto body = function->addBlock();
+    auto exit = function->addBlock();
+
+    this->jump(header);
+    this->state.current = header;
+    store();
+    this->branch(this->expression(loop->condition.get()), body, exit);
+    this->sealBlock(body);
+
+    this->state.loops.push_back({header, exit});
+    this->state.current = body;
+    this->scopedBlock(loop->body);
+    this->state.loops.pop_back();
+
+    if (this->state.current != nullptr)
+        this->jump(header);
+
+    this->sealBlock(header);
+    this->sealBlock(exit);
+    this->state.current = exit;
+    store();
+    this->emit(Opcode::RETURN, {}, loop->line);
+
+    return std::move(this->module);
+}
+
+Function *Lowering::lowerFunction(const Symbol &name, const std::vector<Symbol> &parameters,
+                                  std::vector<std::unique_ptr<AstChild>> &body, FunctionDefinitionNode *definition,
+                                  bool promote) {
+    auto outer = std::move(this->state);
+
+    this->module->functions.push_back(std::make_unique<Function>());
+    this->state = State();
+
+    auto function = this->module->functions.back().get();
+    function->name = name;
+    function->parameters = parameters;
+    function->definition = definition;
+
+    this->state.function = function;
+    this->state.file = outer.function == nullptr && definition == nullptr;
+    this->state.promote = promote;
+    this->state.current = function->addBlock();
+    this->state.sealed.insert(this->state.current);
+    this->state.scopes.emplace_back();
+
+    // The functions of the file can't see the variables in the blocks of the file, only those
+    // defined in the blocks can
+    for (auto &statement: body) {
+        auto identifier = statement->getIdentifier();
+
+        if (!this->state.file || (identifier != "FunctionDefinition" && identifier != "ClassDefinition"))
+            this->state.promote = this->state.promote && !definesFunctions(statement.get());
+    }
+
+    auto line = definition != nullptr ? definition->line : 0;
+
+    for (size_t i = 0; i < parameters.size(); i++) {
+        auto instruction = function->create(Opcode::PARAMETER);
+        instruction->intValue = (int64_t) i;
+        instruction->name = parameters[i];
+
+        // Annotated parameters are checked by the call, assignments to them later on by their variable
+        auto annotated = definition != nullptr && definition->parameterTypes[i] != StaticType::UNKNOWN;
+
+        if (annotated)
+            instruction->type = definition->parameterTypes[i];
+
+        this->define(parameters[i], this->emit(std::move(instruction), line), !annotated, line);
+    }
+
+    this->block(body);
+
+    if (this->state.current != nullptr)
+        this->emit(Opcode::RETURN, {}, 0);
+
+    this->state = std::move(outer);
+
+    return function;
+}
+
+bool Lowering::definesFunctions(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+    auto any = [](std::vector<std::unique_ptr<AstChild>> &body) {
+        return std::any_of(body.begin(), body.end(),
+                           [](std::unique_ptr<AstChild> &child) { return definesFunctions(child.get()); });
+    };
+
+    if (identifier == "FunctionDefinition" || identifier == "ClassDefinition")
+        return true;
+
+    if (identifier == "IfStatement") {
+        auto realNode = dynamic_cast<IfStatementNode *>(node);
+
+        return any(realNode->thenBranch) || any(realNode->elseBranch);
+    }
+
+    if (identifier == "WhileStatement")
+        return any(dynamic_cast<WhileStatementNode *>(node)->body);
+
+    if (identifier == "ForStatement")
+        return any(dynamic_cast<ForStatementNode *>(node)->body);
+
+    if (identifier == "SwitchStatement") {
+        for (auto &caseNode: dynamic_cast<SwitchStatementNode *>(node)->cases)
+            if (any(caseNode->body))
+                return true;
+    }
+
+    return false;
+}
+
+void Lowering::lowerClass(ClassDefinitionNode *node) {
+    std::vector<std::unique_ptr<AstChild>> fields;
+
+    // The body of the class runs for every instance, it initializes the fields. Methods are functions
+    // whose variables include the fields.
+    for (auto &child: node->body) {
+        if (child->getIdentifier() == "VariableDefinition")
+            fields.emplace_back(child.get());
+    }
+
+    Function *initializer;
+
+    // Fields become the slots of the instance, they are never SSA variables
+    try {
+        initializer = this->lowerFunction(node->name, node->constructor, fields, nullptr, false);
+    } catch (...) {
+        for (auto &field: fields)
+            field.release();
+
+        throw;
+    }
+
+    for (auto &field: fields)
+        field.release();
+
+    auto instruction = this->state.function->create(Opcode::DEFINE_CLASS);
+    instruction->name = node->name;
+    instruction->function = initializer;
+    this->emit(std::move(instruction), node->line);
+
+    for (auto &child: node->body) {
+        if (child->getIdentifier() != "FunctionDefinition")
+            continue;
+
+        auto method = dynamic_cast<FunctionDefinitionNode *>(child.get());
+
+        this->lowered[method] = this->lowerFunction(node->name + "." + method->name, method->parameters,
+                                                    method->body, method);
+    }
+}
+
+Instruction *Lowering::emit(std::unique_ptr<Instruction> instruction, int line) {
+    auto block = this->state.current;
+
+    instruction->line = line;
+    instruction->block = block;
+
+    if (instruction->opcode == Opcode::PHI) {
+        auto position = std::find_if(block->instructions.begin(), block->instructions.end(),
+                                     [](const std::unique_ptr<Instruction> &item) {
+                                         return item->opcode != Opcode::PHI;
+                                     });
+
+        return block->instructions.insert(position, std::move(instruction))->get();
+    }
+
+    block->instructions.push_back(std::move(instruction));
+
+    if (block->instructions.back()->isTerminator())
+        this->state.current = nullptr;
+
+    return block->instructions.back().get();
+}
+
+Instruction *Lowering::emit(Opcode opcode, std::vector<Instruction *> operands, int line) {
+    auto instruction = this->state.function->create(opcode);
+    instruction->operands = std::move(operands);
+
+    return this->emit(std::move(instruction), line);
+}
+
+Instruction *Lowering::constant(int64_t value, int line) {
+    auto instruction = this->state.function->create(Opcode::CONSTANT);
+    instruction->type = StaticType::INT;
+    instruction->intValue = value;
+
+    return this->emit(std::move(instruction), line);
+}
+
+void Lowering::removeBlock(Block *block) {
+    this->state.sealed.erase(block);
+    std::erase_if(this->state.function->blocks, [block](const std::unique_ptr<Block> &item) { return item.get() == block; });
+}
+
+void Lowering::jump(Block *target) {
+    auto instruction = this->state.function->create(Opcode::JUMP);
+    instruction->targets[0] = target;
+
+    target->predecessors.push_back(this->state.current);
+    this->emit(std::move(instruction), 0);
+}
+
+void Lowering::branch(Instruction *condition, Block *then, Block *otherwise) {
+    auto instruction = this->state.function->create(Opcode::BRANCH);
+    instruction->operands.push_back(condition);
+    instruction->targets[0] = then;
+    instruction->targets[1] = otherwise;
+
+    then->predecessors.push_back(this->state.current);
+    otherwise->predecessors.push_back(this->state.current);
+    this->emit(std::move(instruction), condition->line);
+}
+
+void Lowering::pushScope() {
+    this->state.scopes.emplace_back();
+}
+
+void Lowering::popScope() {
+    this->state.scopes.pop_back();
+}
+
+void Lowering::block(std::vector<std::unique_ptr<AstChild>> &body) {
+    for (auto &statement: body) {
+        // Nothing after a return, break or continue runs
+        if (this->state.current == nullptr)
+            return;
+
+        this->statement(statement.get());
+    }
+}
+
+void Lowering::scopedBlock(std::vector<std::unique_ptr<AstChild>> &body) {
+    this->pushScope();
+    this->block(body);
+    this->popScope();
+}
+
+void Lowering::statement(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "VariableDefinition") {
+        auto realNode = dynamic_cast<VariableDefinitionNode *>(node);
+        auto value = this->expression(realNode->value.get());
+
+        // Annotated variables and constants are checked when they are assigned to
+        this->define(realNode->name, value, !realNode->constant && realNode->type == StaticType::UNKNOWN,
+                     realNode->line);
+    } else if (identifier == "VariableAssignment") {
+        auto realNode = dynamic_cast<VariableAssignmentNode *>(node);
+        auto value = this->expression(realNode->value.get());
+
+        if (!realNode->indices.empty()) {
+            // Assigning an element gives the changed list, map or array
+            std::vector<Instruction *> operands = {this->read(realNode->name, realNode->line)};
+
+            for (auto &index: realNode->indices)
+                operands.push_back(this->expression(index.get()));
+
+            operands.push_back(value);
+            value = this->emit(Opcode::SET_INDEX, std::move(operands), realNode->line);
+        }
+
+        this->assign(realNode->name, value, realNode->line);
+    } else if (identifier == "MemberAssignment") {
+        auto realNode = dynamic_cast<MemberAssignmentNode *>(node);
+        auto object = this->expression(realNode->object.get());
+        auto value = this->expression(realNode->value.get());
+
+        this->emit(Opcode::SET_FIELD, {object, value}, realNode->line)->name = realNode->name;
+    } else if (identifier == "IfStatement") {
+        this->ifStatement(dynamic_cast<IfStatementNode *>(node));
+    } else if (identifier == "WhileStatement") {
+        this->whileStatement(dynamic_cast<WhileStatementNode *>(node));
+    } else if (identifier == "ForStatement") {
+        this->forStatement(dynamic_cast<ForStatementNode *>(node));
+    } else if (identifier == "SwitchStatement") {
+        this->switchStatement(dynamic_cast<SwitchStatementNode *>(node));
+    } else if (identifier == "BreakStatement" || identifier == "ContinueStatement") {
+        // Outside of loops they end the function, like a return without a value
+        if (this->state.loops.empty())
+            this->emit(Opcode::RETURN, {}, node->line);
+        else if (identifier == "BreakStatement")
+            this->jump(this->state.loops.back().breakTarget);
+        else
+            this->jump(this->state.loops.back().continueTarget);
+    } else if (identifier == "ReturnStatement") {
+        auto realNode = dynamic_cast<ReturnStatementNode *>(node);
+        std::vector<Instruction *> operands;
+
+        if (realNode->value != nullptr)
+            operands.push_back(this->expression(realNode->value.get()));
+
+        auto instruction = this->state.function->create(Opcode::RETURN);
+        instruction->operands = std::move(operands);
+        instruction->tailCall = realNode->tailCall;
+        this->emit(std::move(instruction), realNode->line);
+    } else if (identifier == "FunctionDefinition") {
+        auto realNode = dynamic_cast<FunctionDefinitionNode *>(node);
+        Function *function = nullptr;
+
+        // External functions declare builtins, they have no body
+        if (!realNode->isExternal) {
+            function = this->lowerFunction(realNode->name, realNode->parameters, realNode->body, realNode);
+            this->lowered[realNode] = function;
+        }
+
+        auto instruction = this->state.function->create(Opcode::DEFINE_FUNCTION);
+        instruction->name = realNode->name;
+        instruction->function = function;
+        this->emit(std::move(instruction), realNode->line);
+    } else if (identifier == "ClassDefinition") {
+        this->lowerClass(dynamic_cast<ClassDefinitionNode *>(node));
+    } else if (identifier == "ImportStatement") {
+        auto instruction = this->state.function->create(Opcode::IMPORT);
+        instruction->text = dynamic_cast<ImportStatementNode *>(node)->path;
+        this->emit(std::move(instruction), node->line);
+    } else {
+        this->expression(node);
+    }
+}
+
+void Lowering::ifStatement(IfStatementNode *node) {
+    auto condition = this->expression(node->condition.get());
+    auto function = this->state.function;
+    auto then = function->addBlock();
+    auto otherwise = function->addBlock();
+    auto join = function->addBlock();
+
+    this->branch(condition, then, otherwise);
+
+    for (auto [block, body]: {std::make_pair(then, &node->thenBranch), std::make_pair(otherwise, &node->elseBranch)}) {
+        this->sealBlock(block);
+        this->state.current = block;
+        this->scopedBlock(*body);
+
+        if (this->state.current != nullptr)
+            this->jump(join);
+    }
+
+    this->sealBlock(join);
+
+    // Both branches returned or left the loop
+    if (join->predecessors.empty()) {
+        this->removeBlock(join);
+        return;
+    }
+
+    this->state.current = join;
+}
+
+void Lowering::whileStatement(WhileStatementNode *node) {
+    auto function = this->state.function;
+    auto header = function->addBlock();
+    auto body = function->addBlock();
+    auto exit = function->addBlock();
+
+    // The header isn't sealed before the body is lowered, the end of the body jumps back to it
+    this->jump(header);
+    this->state.current = header;
+
+    auto condition = this->expression(node->condition.get());
+
+    this->branch(condition, body, exit);
+    this->sealBlock(body);
+
+    this->state.loops.push_back({header, exit});
+    this->state.current = body;
+    this->scopedBlock(node->body);
+    this->state.loops.pop_back();
+
+    if (this->state.current != nullptr)
+        this->jump(header);
+
+    this->sealBlock(header);
+    this->sealBlock(exit);
+    this->state.current = exit;
+}
+
+void Lowering::forStatement(ForStatementNode *node) {
+    auto function = this->state.function;
+    auto location = this->expression(node->location.get());
+    auto iterator = this->emit(Opcode::ITERATE, {location}, node->line);
+    auto header = function->addBlock();
+    auto body = function->addBlock();
+    auto exit = function->addBlock();
+
+    this->jump(header);
+    this->state.current = header;
+    this->branch(this->emit(Opcode::NEXT, {iterator}, node->line), body, exit);
+    this->sealBlock(body);
+
+    this->state.loops.push_back({header, exit});
+    this->state.current = body;
+    this->pushScope();
+    this->define(node->initializer, this->emit(Opcode::ELEMENT, {iterator}, node->line), true, node->line);
+    this->block(node->body);
+    this->popScope();
+    this->state.loops.pop_back();
+
+    if (this->state.current != nullptr)
+        this->jump(header);
+
+    this->sealBlock(header);
+    this->sealBlock(exit);
+    this->state.current = exit;
+}
+
+void Lowering::switchStatement(SwitchStatementNode *node) {
+    auto function = this->state.function;
+    auto value = this->expression(node->condition.get());
+    auto join = function->addBlock();
+    SwitchCaseNode *defaultCase = nullptr;
+
+    // The labels are compared one after another, the first matching case runs
+    for (auto &caseNode: node->cases) {
+        if (caseNode->condition == nullptr) {
+            defaultCase = caseNode.get();
+            continue;
+        }
+
+        auto label = this->expression(caseNode->condition.get());
+        auto body = function->addBlock();
+        auto next = function->addBlock();
+
+        this->branch(this->emit(Opcode::MATCHES, {value, label}, caseNode->condition->line), body, next);
+        this->sealBlock(body);
+        this->sealBlock(next);
+
+        this->state.current = body;
+        this->scopedBlock(caseNode->body);
+
+        if (this->state.current != nullptr)
+            this->jump(join);
+
+        this->state.current = next;
+    }
+
+    if (defaultCase != nullptr)
+        this->scopedBlock(defaultCase->body);
+
+    if (this->state.current != nullptr)
+        this->jump(join);
+
+    this->sealBlock(join);
+
+    if (join->predecessors.empty()) {
+        this->removeBlock(join);
+        return;
+    }
+
+    this->state.current = join;
+}
+
+Instruction *Lowering::expression(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+    auto function = this->state.function;
+
+    if (identifier == "IntegerLiteral") {
+        auto realNode = dynamic_cast<IntegerLiteralNode *>(node);
+
+        if (realNode->digits.empty())
+            return this->constant(realNode->value, realNode->line);
+
+        // Big integers are kept as their digits
+        auto instruction = function->create(Opcode::CONSTANT);
+        instruction->text = realNode->digits;
+
+        return this->emit(std::move(instruction), realNode->line);
+    } else if (identifier == "FloatLiteral") {
+        auto instruction = function->create(Opcode::CONSTANT);
+        instruction->type = StaticType::FLOAT;
+        instruction->floatValue = dynamic_cast<FloatLiteralNode *>(node)->value;
+
+        return this->emit(std::move(instruction), node->line);
+    } else if (identifier == "StringLiteral") {
+        auto instruction = function->create(Opcode::CONSTANT);
+        instruction->type = StaticType::STRING;
+        instruction->text = dynamic_cast<StringLiteralNode *>(node)->value.str();
+
+        return this->emit(std::move(instruction), node->line);
+    } else if (identifier == "VariableReference") {
+        return this->read(dynamic_cast<VariableReferenceNode *>(node)->name, node->line);
+    } else if (identifier == "Expression") {
+        auto realNode = dynamic_cast<ExpressionNode *>(node);
+        auto left = this->expression(realNode->left.get());
+        auto right = this->expression(realNode->right.get());
+        auto instruction = this->emit(Opcode::BINARY, {left, right}, realNode->line);
+
+        instruction->op = realNode->opcode;
+        instruction->text = realNode->op;
+
+        return instruction;
+    } else if (identifier == "Unary") {
+        auto realNode = dynamic_cast<UnaryExpressionNode *>(node);
+        auto value = this->expression(realNode->child.get());
+
+        // Other unary operators give their operand
+        if (realNode->op != "-")
+            return value;
+
+        return this->emit(Opcode::NEGATE, {value}, realNode->line);
+    } else if (identifier == "FunctionCall") {
+        return this->call(dynamic_cast<FunctionCallNode *>(node));
+    } else if (identifier == "InlinedCall") {
+        return this->inlinedCall(dynamic_cast<InlinedCallNode *>(node));
+    } else if (identifier == "Invariant") {
+        // Evaluating the value once per loop is up to the passes
+        return this->expression(dynamic_cast<InvariantNode *>(node)->value.get());
+    } else if (identifier == "Array") {
+        std::vector<Instruction *> elements;
+
+        for (auto &element: dynamic_cast<ArrayNode *>(node)->elements)
+            elements.push_back(this->expression(element.get()));
+
+        return this->emit(Opcode::LIST, std::move(elements), node->line);
+    } else if (identifier == "Map") {
+        std::vector<Instruction *> entries;
+
+        for (auto &[key, value]: dynamic_cast<MapNode *>(node)->entries) {
+            entries.push_back(this->expression(key.get()));
+            entries.push_back(this->expression(value.get()));
+        }
+
+        return this->emit(Opcode::MAP, std::move(entries), node->line);
+    } else if (identifier == "ArrayAccess") {
+        auto realNode = dynamic_cast<ArrayAccessNode *>(node);
+        auto array = this->expression(realNode->array.get());
+        auto index = this->expression(realNode->index.get());
+
+        return this->emit(Opcode::INDEX, {array, index}, realNode->line);
+    } else if (identifier == "MemberAccess") {
+        auto realNode = dynamic_cast<MemberAccessNode *>(node);
+        auto instruction = this->emit(Opcode::GET_FIELD, {this->expression(realNode->object.get())}, realNode->line);
+
+        instruction->name = realNode->name;
+
+        return instruction;
+    } else if (identifier == "MethodCall") {
+        auto realNode = dynamic_cast<MethodCallNode *>(node);
+        std::vector<Instruction *> operands = {this->expression(realNode->object.get())};
+
+        for (auto &argument: realNode->args)
+            operands.push_back(this->expression(argument.get()));
+
+        auto instruction = this->emit(Opcode::METHOD_CALL, std::move(operands), realNode->line);
+        instruction->name = realNode->name;
+
+        return instruction;
+    }
+
+    throw std::runtime_error("Cannot lower expression: " + identifier);
+}
+
+Instruction *Lowering::call(FunctionCallNode *node) {
+    std::vector<Instruction *> arguments;
+
+    for (auto &argument: node->args)
+        arguments.push_back(this->expression(argument.get()));
+
+    auto instruction = this->emit(Opcode::CALL, arguments, node->line);
+    instruction->name = node->name;
+
+    // Builtins like append() change the list in their first argument. The variable or field the list
+    // came from gets the changed list, the argument itself for other functions. Elements of lists
+    // and maps are put back into their containers first.
+    if (function_mutates(node->name) && !node->args.empty()) {
+        auto argument = node->args[0].get();
+        auto value = arguments[0];
+        std::vector<Instruction *> elements;
+
+        while (argument->getIdentifier() == "ArrayAccess") {
+            elements.push_back(value);
+            value = value->operands[0];
+            argument = dynamic_cast<ArrayAccessNode *>(argument)->array.get();
+        }
+
+        if (argument->getIdentifier() == "VariableReference" || argument->getIdentifier() == "MemberAccess") {
+            auto changed = this->emit(Opcode::CHANGED, {instruction}, node->line);
+
+            for (auto element: elements)
+                changed = this->emit(Opcode::SET_INDEX, {element->operands[0], element->operands[1], changed},
+                                     node->line);
+
+            if (argument->getIdentifier() == "VariableReference")
+                this->assign(dynamic_cast<VariableReferenceNode *>(argument)->name, changed, node->line);
+            else
+                this->emit(Opcode::SET_FIELD, {value->operands[0], changed}, node->line)->name =
+                        dynamic_cast<MemberAccessNode *>(argument)->name;
+        }
+    }
+
+    return instruction;
+}
+
+Instruction *Lowering::inlinedCall(InlinedCallNode *node) {
+    auto function = this->state.function;
+
+    // The body is only evaluated while the name still refers to the function it was copied from
+    auto resolves = function->create(Opcode::RESOLVES);
+    resolves->name = node->call->name;
+
+    auto condition = this->emit(std::move(resolves), node->line);
+    auto inlined = function->addBlock();
+    auto called = function->addBlock();
+    auto join = function->addBlock();
+
+    condition->definition = node->function;
+    this->unresolved.emplace_back(condition, node->function);
+    this->branch(condition, inlined, called);
+    this->sealBlock(inlined);
+    this->sealBlock(called);
+
+    std::vector<Instruction *> values;
+
+    for (auto [block, body]: {std::make_pair(inlined, node->body.get()), std::make_pair(called, (AstChild *) node->call.get())}) {
+        this->state.current = block;
+        values.push_back(this->expression(body));
+        this->jump(join);
+    }
+
+    this->sealBlock(join);
+    this->state.current = join;
+
+    auto phi = this->addPhi(join);
+    phi->operands = std::move(values);
+
+    return phi;
+}
+
+void Lowering::define(const Symbol &name, Instruction *value, bool promote, int line) {
+    auto &scope = this->state.scopes.back();
+
+    // Variables of the file are seen by its functions, they are always stored by name
+    if (!promote || !this->state.promote || (this->state.file && this->state.scopes.size() == 1)) {
+        scope.erase(name);
+        this->emit(Opcode::DEFINE, {value}, line)->name = name;
+        return;
+    }
+
+    // Defining a variable again in the same scope leaves the first definition visible
+    if (scope.contains(name))
+        return;
+
+    scope[name] = (int) this->state.definitions.size();
+    this->state.definitions.emplace_back();
+    this->writeVariable(scope[name], this->state.current, value);
+}
+
+Instruction *Lowering::read(const Symbol &name, int line) {
+    auto variable = this->findVariable(name);
+
+    if (variable != -1)
+        return this->readVariable(variable, this->state.current);
+
+    auto instruction = this->emit(Opcode::LOAD, {}, line);
+    instruction->name = name;
+
+    return instruction;
+}
+
+void Lowering::assign(const Symbol &name, Instruction *value, int line) {
+    auto variable = this->findVariable(name);
+
+    if (variable != -1) {
+        this->writeVariable(variable, this->state.current, value);
+        return;
+    }
+
+    this->emit(Opcode::STORE, {value}, line)->name = name;
+}
+
+int Lowering::findVariable(const Symbol &name) {
+    for (auto scope = this->state.scopes.rbegin(); scope != this->state.scopes.rend(); scope++) {
+        auto found = scope->find(name);
+
+        if (found != scope->end())
+            return found->second;
+    }
+
+    return -1;
+}
+
+Instruction *Lowering::undefined() {
+    if (this->state.undefined == nullptr) {
+        auto entry = this->state.function->blocks[0].get();
+        auto instruction = this->state.function->create(Opcode::UNDEFINED);
+
+        instruction->block = entry;
+        this->state.undefined = instruction.get();
+        entry->instructions.insert(entry->instructions.begin(), std::move(instruction));
+    }
+
+    return this->state.undefined;
+}
+
+void Lowering::writeVariable(int variable, Block *block, Instruction *value) {
+    this->state.definitions[variable][block] = value;
+}
+
+Instruction *Lowering::readVariable(int variable, Block *block) {
+    auto &definitions = this->state.definitions[variable];
+    auto found = definitions.find(block);
+
+    if (found != definitions.end())
+        return found->second;
+
+    return this->readVariableRecursive(variable, block);
+}
+
+Instruction *Lowering::readVariableRecursive(int variable, Block *block) {
+    Instruction *value;
+
+    if (!this->state.sealed.contains(block)) {
+        // Not all predecessors are known yet, the phi gets its operands when they are
+        value = this->addPhi(block);
+        this->state.incompletePhis[block].emplace_back(variable, value);
+    } else if (block->predecessors.empty()) {
+        value = this->undefined();
+    } else if (block->predecessors.size() == 1) {
+        value = this->readVariable(variable, block->predecessors[0]);
+    } else {
+        // The phi is written first, so loops reading the variable end at it
+        auto phi = this->addPhi(block);
+
+        this->writeVariable(variable, block, phi);
+        value = this->addPhiOperands(variable, phi);
+    }
+
+    this->writeVariable(variable, block, value);
+
+    return value;
+}
+
+Instruction *Lowering::addPhi(Block *block) {
+    auto current = this->state.current;
+
+    this->state.current = block;
+
+    auto phi = this->emit(Opcode::PHI, {}, 0);
+
+    this->state.current = current;
+
+    return phi;
+}
+
+Instruction *Lowering::addPhiOperands(int variable, Instruction *phi) {
+    for (auto predecessor: phi->block->predecessors)
+        phi->operands.push_back(this->readVariable(variable, predecessor));
+
+    return this->removeTrivialPhi(phi);
+}
+
+Instruction *Lowering::removeTrivialPhi(Instruction *phi) {
+    Instruction *same = nullptr;
+
+    for (auto operand: phi->operands) {
+        if (operand == same || operand == phi)
+            continue;
+
+        // Merging at least two values
+        if (same != nullptr)
+            return phi;
+
+        same = operand;
+    }
+
+    // Only reachable through itself
+    if (same == nullptr)
+        same = this->undefined();
+
+    std::vector<Instruction *> users;
+
+    for (auto &block: this->state.function->blocks)
+        for (auto &instruction: block->instructions)
+            if (instruction.get() != phi && std::find(instruction->operands.begin(), instruction->operands.end(), phi) !=
+                                            instruction->operands.end())
+                users.push_back(instruction.get());
+
+    this->state.function->replaceUses(phi, same);
+
+    for (auto &definitions: this->state.definitions)
+        for (auto &[block, value]: definitions)
+            if (value == phi)
+                value = same;
+
+    auto &instructions = phi->block->instructions;
+    auto position = std::find_if(instructions.begin(), instructions.end(),
+                                 [phi](const std::unique_ptr<Instruction> &item) { return item.get() == phi; });
+
+    this->removed.push_back(std::move(*position));
+    instructions.erase(position);
+    phi->block = nullptr;
+
+    // Users which were phis may have become trivial now
+    for (auto user: users)
+        if (user->opcode == Opcode::PHI && user->block != nullptr)
+            this->removeTrivialPhi(user);
+
+    return same;
+}
+
+void Lowering::sealBlock(Block *block) {
+    auto phis = this->state.incompletePhis.find(block);
+
+    // Sealed first, reading the variables through the block doesn't add more phis
+    this->state.sealed.insert(block);
+
+    if (phis == this->state.incompletePhis.end())
+        return;
+
+    auto pending = std::move(phis->second);
+
+    this->state.incompletePhis.erase(phis);
+
+    for (auto [variable, phi]: pending)
+        this->addPhiOperands(variable, phi);
+}
+
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_LOWERING_H
+#define ACL_LOWERING_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include "ir.h"
+
+namespace ir {
+
+// Translating a parsed file into IR. The SSA form is built while the statements are translated, by
+// looking up the definitions of variables through the predecessors of the blocks and placing phis
+// where definitions meet (Braun et al., "Simple and Efficient Construction of Static Single Assignment
+// Form"). Phis which turn out to merge only one value are removed again right away.
+class Lowering {
+public:
+    std::unique_ptr<Module> lower(AbstractSyntaxTree *ast);
+
+    // Lowering a single function, without the code around it
+    std::unique_ptr<Module> lower(FunctionDefinitionNode *definition);
+
+    // Lowering a while loop on its own. The given variables from outside of the loop become parameters,
+    // their values are stored by name whenever the loop checks its condition and when it ends. Any other
+    // variable from outside is loaded and stored by name.
+    std::unique_ptr<Module> lower(WhileStatementNode *loop, const std::vector<Symbol> &variables);
+
+private:
+    // Targets of break and continue statements
+    struct Loop {
+        Block *continueTarget;
+        Block *breakTarget;
+    };
+
+    // Everything about the function being lowered, saved while a nested function is lowered
+    struct State {
+        Function *function = nullptr;
+
+        // Block new instructions are added to, nullptr after a jump until the next block starts
+        Block *current = nullptr;
+
+        // Whether the variables the function defines become SSA values. They can't if a function or class
+        // is defined inside of it, the definition could read and assign them while it runs.
+        bool promote = true;
+
+        // Whether the function is the code of the file, whose own variables are those of every function
+        bool file = false;
+
+        // Variables in scope, by name, one map per block, innermost last. The values are indices into
+        // definitions.
+        std::vector<std::unordered_map<Symbol, int>> scopes;
+
+        // The value of every SSA variable at the end of each block it is defined in
+        std::vector<std::unordered_map<Block *, Instruction *>> definitions;
+
+        // Blocks whose predecessors are all known
+        std::unordered_set<Block *> sealed;
+
+        // Phis in blocks which aren't sealed yet, they get their operands when the block is sealed
+        std::unordered_map<Block *, std::vector<std::pair<int, Instruction *>>> incompletePhis;
+
+        std::vector<Loop> loops;
+
+        Instruction *undefined = nullptr;
+    };
+
+    std::unique_ptr<Module> module;
+
+    State state;
+
+    // The function every definition was lowered into, and inlined calls waiting for the function they
+    // were inlined from
+    std::unordered_map<FunctionDefinitionNode *, Function *> lowered;
+    std::vector<std::pair<Instruction *, FunctionDefinitionNode *>> unresolved;
+
+    // Phis removed while the SSA form was built, kept until the end because they may still be referenced
+    std::vector<std::unique_ptr<Instruction>> removed;
+
+    // Lowering a function, the statements are borrowed. Unless promote is set, all variables of the
+    // function are stored by name.
+    Function *lowerFunction(const Symbol &name, const std::vector<Symbol> &parameters,
+                            std::vector<std::unique_ptr<AstChild>> &body, FunctionDefinitionNode *definition,
+                            bool promote = true);
+
+    // Whether a statement is or contains the definition of a function or class
+    static bool definesFunctions(AstChild *node);
+
+    void lowerClass(ClassDefinitionNode *node);
+
+    Instruction *emit(std::unique_ptr<Instruction> instruction, int line);
+
+    Instruction *emit(Opcode opcode, std::vector<Instruction *> operands, int line);
+
+    Instruction *constant(int64_t value, int line);
+
+    // Removing a block nothing jumps to
+    void removeBlock(Block *block);
+
+    void jump(Block *target);
+
+    void branch(Instruction *condition, Block *then, Block *otherwise);
+
+    void pushScope();
+
+    void popScope();
+
+    void block(std::vector<std::unique_ptr<AstChild>> &body);
+
+    void scopedBlock(std::vector<std::unique_ptr<AstChild>> &body);
+
+    void statement(AstChild *node);
+
+    void ifStatement(IfStatementNode *node);
+
+    void whileStatement(WhileStatementNode *node);
+
+    void forStatement(ForStatementNode *node);
+
+    void switchStatement(SwitchStatementNode *node);
+
+    Instruction *expression(AstChild *node);
+
+    Instruction *call(FunctionCallNode *node);
+
+    Instruction *inlinedCall(InlinedCallNode *node);
+
+    // Defining a variable in the innermost scope, an SSA variable unless it has to be stored by name
+    void define(const Symbol &name, Instruction *value, bool promote, int line);
+
+    // Reading and assigning variables, SSA variables or by name
+    Instruction *read(const Symbol &name, int line);
+
+    void assign(const Symbol &name, Instruction *value, int line);
+
+    // The SSA variable with the given name in scope, -1 if there is none
+    int findVariable(const Symbol &name);
+
+    Instruction *undefined();
+
+    // Building the SSA form
+    void writeVariable(int variable, Block *block, Instruction *value);
+
+    Instruction *readVariable(int variable, Block *block);
+
+    Instruction *readVariableRecursive(int variable, Block *block);
+
+    Instruction *addPhi(Block *block);
+
+    Instruction *addPhiOperands(int variable, Instruction *phi);
+
+    Instruction *removeTrivialPhi(Instruction *phi);
+
+    void sealBlock(Block *block);
+};
+
+}
+
+#endif //ACL_LOWERING_H
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "passes.h"
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+#include "../interpreter/interpreter.h"
+
+namespace ir {
+
+// Passes enabling each other again and again would be a bug, this ends it
+const int MAX_ROUNDS = 16;
+
+void PassManager::add(std::unique_ptr<Pass> pass) {
+    this->passes.push_back(std::move(pass));
+}
+
+void PassManager::run(Module &module) {
+    for (auto &function: module.functions) {
+        for (int round = 0; round < MAX_ROUNDS; round++) {
+            auto changed = false;
+
+            for (auto &pass: this->passes) {
+                changed = pass->run(*function) || changed;
+
+                if (!this->verifying)
+                    continue;
+
+                try {
+                    verify(*function);
+                } catch (const std::exception &error) {
+                    throw std::runtime_error(std::string(error.what()) + ", after " + pass->name());
+                }
+            }
+
+            if (!changed)
+                break;
+        }
+    }
+}
+
+PassManager PassManager::standard() {
+    PassManager manager;
+
+    manager.add(std::make_unique<InferTypes>());
+    manager.add(std::make_unique<FoldConstants>());
+    manager.add(std::make_unique<SimplifyControlFlow>());
+    manager.add(std::make_unique<EliminateDeadCode>());
+
+    return manager;
+}
+
+// Type of a value as far as it is known, nullopt while nothing reaching it is known yet
+using TypeState = std::optional<StaticType>;
+
+static TypeState join(TypeState a, TypeState b) {
+    if (!a)
+        return b;
+
+    if (!b || *a == *b)
+        return a;
+
+    return StaticType::UNKNOWN;
+}
+
+static TypeState inferType(const Instruction &instruction, const std::vector<TypeState> &types) {
+    switch (instruction.opcode) {
+        case Opcode::CONSTANT:
+        case Opcode::PARAMETER:
+            // Set when they were created, parameters have the type they are annotated with
+            return instruction.type;
+        case Opcode::PHI: {
+            TypeState type;
+
+            for (auto operand: instruction.operands)
+                type = join(type, types[operand->id]);
+
+            return type;
+        }
+        case Opcode::BINARY: {
+            auto left = types[instruction.operands[0]->id];
+            auto right = types[instruction.operands[1]->id];
+
+            if (!left || !right)
+                return std::nullopt;
+
+            auto same = *left == *right && (*left == StaticType::INT || *left == StaticType::FLOAT) ? *left
+                                                                                                   : StaticType::UNKNOWN;
+
+            switch (instruction.op) {
+                case Operator::ADD:
+                    // Anything known added to a string is a string
+                    if ((*left == StaticType::STRING && *right != StaticType::UNKNOWN) ||
+                        (*right == StaticType::STRING && *left != StaticType::UNKNOWN))
+                        return StaticType::STRING;
+
+                    return same;
+                case Operator::SUBTRACT:
+                case Operator::MULTIPLY:
+                case Operator::DIVIDE:
+                    return same;
+                case Operator::MODULO:
+                    return same == StaticType::INT ? StaticType::INT : StaticType::UNKNOWN;
+                case Operator::UNKNOWN:
+                    return StaticType::UNKNOWN;
+                default:
+                    // Comparisons and logical operators give 0 or 1
+                    return StaticType::INT;
+            }
+        }
+        case Opcode::NEGATE: {
+            auto type = types[instruction.operands[0]->id];
+
+            if (!type)
+                return std::nullopt;
+
+            return *type == StaticType::INT || *type == StaticType::FLOAT ? *type : StaticType::UNKNOWN;
+        }
+        case Opcode::MATCHES:
+        case Opcode::NEXT:
+        case Opcode::RESOLVES:
+            return StaticType::INT;
+        default:
+            return StaticType::UNKNOWN;
+    }
+}
+
+bool InferTypes::run(Function &function) {
+    // Starting with nothing known and only ever generalizing, so a loop whose values stay ints is found
+    // to stay ints instead of being given up on at its first phi
+    std::vector<TypeState> types(function.nextValue);
+    auto changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (auto &block: function.blocks) {
+            for (auto &instruction: block->instructions) {
+                auto type = join(types[instruction->id], inferType(*instruction, types));
+
+                if (type != types[instruction->id]) {
+                    types[instruction->id] = type;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    auto result = false;
+
+    for (auto &block: function.blocks) {
+        for (auto &instruction: block->instructions) {
+            auto type = types[instruction->id].value_or(StaticType::UNKNOWN);
+
+            result = result || instruction->type != type;
+            instruction->type = type;
+        }
+    }
+
+    return result;
+}
+
+static void makeInt(Instruction *instruction, int64_t value) {
+    instruction->opcode = Opcode::CONSTANT;
+    instruction->operands.clear();
+    instruction->type = StaticType::INT;
+    instruction->intValue = value;
+}
+
+static void makeFloat(Instruction *instruction, double value) {
+    instruction->opcode = Opcode::CONSTANT;
+    instruction->operands.clear();
+    instruction->type = StaticType::FLOAT;
+    instruction->floatValue = value;
+}
+
+// Evaluating an instruction whose operands are all constants, in place. Returns false if it can't be.
+static bool fold(Instruction *instruction) {
+    if (instruction->operands.empty() ||
+        !std::all_of(instruction->operands.begin(), instruction->operands.end(),
+                     [](Instruction *operand) { return operand->isConstant(); }))
+        return false;
+
+    auto left = instruction->operands[0];
+
+    if (instruction->opcode == Opcode::NEGATE) {
+        if (left->type == StaticType::INT && left->intValue != INT64_MIN)
+            makeInt(instruction, -left->intValue);
+        else if (left->type == StaticType::FLOAT)
+            makeFloat(instruction, -left->floatValue);
+        else
+            return false;
+
+        return true;
+    }
+
+    if (instruction->opcode != Opcode::BINARY && instruction->opcode != Opcode::MATCHES)
+        return false;
+
+    auto right = instruction->operands[1];
+
+    if (left->type != right->type)
+        return false;
+
+    // Switch labels are compared by their text, for ints and strings that is comparing the values
+    if (instruction->opcode == Opcode::MATCHES) {
+        if (left->type == StaticType::INT)
+            makeInt(instruction, left->intValue == right->intValue);
+        else if (left->type == StaticType::STRING)
+            makeInt(instruction, left->text == right->text);
+        else
+            return false;
+
+        return true;
+    }
+
+    if (left->type == StaticType::INT) {
+        int64_t result;
+
+        // Results which overflow are big integers, they are computed when the code runs
+        if (!applyIntOperator(left->intValue, right->intValue, instruction->op, result))
+            return false;
+
+        makeInt(instruction, result);
+        return true;
+    }
+
+    if (left->type == StaticType::FLOAT) {
+        double result;
+
+        if (!applyFloatOperator(left->floatValue, right->floatValue, instruction->op, result))
+            return false;
+
+        if (isComparison(instruction->op))
+            makeInt(instruction, result != 0.0);
+        else
+            makeFloat(instruction, result);
+
+        return true;
+    }
+
+    if (left->type == StaticType::STRING && instruction->op == Operator::ADD) {
+        auto text = left->text + right->text;
+
+        instruction->opcode = Opcode::CONSTANT;
+        instruction->operands.clear();
+        instruction->type = StaticType::STRING;
+        instruction->text = std::move(text);
+        return true;
+    }
+
+    return false;
+}
+
+bool FoldConstants::run(Function &function) {
+    auto changed = false;
+
+    for (auto &block: function.blocks) {
+        for (auto &instruction: block->instructions)
+            changed = fold(instruction.get()) || changed;
+
+        auto terminator = block->terminator();
+
+        if (terminator == nullptr || terminator->opcode != Opcode::BRANCH)
+            continue;
+
+        auto condition = terminator->operands[0];
+
+        if (!condition->isConstant() || condition->type != StaticType::INT)
+            continue;
+
+        // Only 1 is true, like in the interpreter
+        auto taken = terminator->targets[condition->intValue == 1 ? 0 : 1];
+        auto skipped = terminator->targets[condition->intValue == 1 ? 1 : 0];
+
+        skipped->removePredecessor(block.get());
+
+        terminator->opcode = Opcode::JUMP;
+        terminator->operands.clear();
+        terminator->targets[0] = taken;
+        terminator->targets[1] = nullptr;
+        changed = true;
+    }
+
+    return changed;
+}
+
+// Removing phis which only merge one value (or themselves), returns whether there were any
+static bool removeTrivialPhis(Function &function) {
+    auto changed = false;
+
+    for (auto &block: function.blocks) {
+        for (size_t i = 0; i < block->instructions.size() && block->instructions[i]->opcode == Opcode::PHI;) {
+            auto phi = block->instructions[i].get();
+            Instruction *same = nullptr;
+            auto trivial = true;
+
+            for (auto operand: phi->operands) {
+                if (operand == phi || operand == same)
+                    continue;
+
+                if (same != nullptr)
+                    trivial = false;
+
+                same = operand;
+            }
+
+            if (!trivial || same == nullptr) {
+                i++;
+                continue;
+            }
+
+            function.replaceUses(phi, same);
+            block->instructions.erase(block->instructions.begin() + (long) i);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static void eraseBlocks(Function &function, const std::unordered_set<Block *> &blocks) {
+    std::erase_if(function.blocks, [&blocks](const std::unique_ptr<Block> &block) {
+        return blocks.contains(block.get());
+    });
+}
+
+bool SimplifyControlFlow::run(Function &function) {
+    auto changed = false;
+
+    // Blocks which can't be reached from the entry
+    std::unordered_set<Block *> reachable;
+    std::vector<Block *> work = {function.blocks[0].get()};
+
+    while (!work.empty()) {
+        auto block = work.back();
+        work.pop_back();
+
+        if (!reachable.insert(block).second)
+            continue;
+
+        for (auto successor: block->successors())
+            work.push_back(successor);
+    }
+
+    std::unordered_set<Block *> unreachable;
+
+    for (auto &block: function.blocks) {
+        if (reachable.contains(block.get()))
+            continue;
+
+        for (auto successor: block->successors())
+            successor->removePredecessor(block.get());
+
+        unreachable.insert(block.get());
+    }
+
+    if (!unreachable.empty()) {
+        eraseBlocks(function, unreachable);
+        changed = true;
+    }
+
+    changed = removeTrivialPhis(function) || changed;
+
+    // Merging blocks into their only predecessor, if it always jumps to them
+    std::unordered_set<Block *> merged;
+
+    for (size_t i = 1; i < function.blocks.size(); i++) {
+        auto block = function.blocks[i].get();
+
+        if (block->predecessors.size() != 1 || merged.contains(block))
+            continue;
+
+        auto predecessor = block->predecessors[0];
+        auto terminator = predecessor->terminator();
+
+        if (predecessor == block || terminator->opcode != Opcode::JUMP)
+            continue;
+
+        // The phis have a single operand
+        while (!block->instructions.empty() && block->instructions[0]->opcode == Opcode::PHI) {
+            function.replaceUses(block->instructions[0].get(), block->instructions[0]->operands[0]);
+            block->instructions.erase(block->instructions.begin());
+        }
+
+        predecessor->instructions.pop_back();
+
+        for (auto &instruction: block->instructions) {
+            instruction->block = predecessor;
+            predecessor->instructions.push_back(std::move(instruction));
+        }
+
+        block->instructions.clear();
+
+        for (auto successor: predecessor->successors())
+            std::replace(successor->predecessors.begin(), successor->predecessors.end(), block, predecessor);
+
+        merged.insert(block);
+        changed = true;
+    }
+
+    if (!merged.empty())
+        eraseBlocks(function, merged);
+
+    // Skipping blocks which only jump on, if the block they jump to doesn't have to tell its
+    // predecessors apart
+    std::unordered_set<Block *> skipped;
+
+    for (size_t i = 1; i < function.blocks.size(); i++) {
+        auto block = function.blocks[i].get();
+
+        if (block->instructions.size() != 1 || block->instructions[0]->opcode != Opcode::JUMP)
+            continue;
+
+        auto target = block->instructions[0]->targets[0];
+
+        if (target == block || (!target->instructions.empty() && target->instructions[0]->opcode == Opcode::PHI))
+            continue;
+
+        for (auto predecessor: block->predecessors) {
+            auto terminator = predecessor->terminator();
+
+            for (auto &successor: terminator->targets)
+                if (successor == block)
+                    successor = target;
+
+            target->predecessors.push_back(predecessor);
+        }
+
+        target->removePredecessor(block);
+        block->predecessors.clear();
+        skipped.insert(block);
+        changed = true;
+    }
+
+    if (!skipped.empty())
+        eraseBlocks(function, skipped);
+
+    return changed;
+}
+
+bool EliminateDeadCode::run(Function &function) {
+    auto changed = false;
+    auto removed = true;
+
+    while (removed) {
+        removed = false;
+
+        // Phis referring to themselves in loops don't count as used by that
+        std::vector<int> uses(function.nextValue, 0);
+
+        for (auto &block: function.blocks)
+            for (auto &instruction: block->instructions)
+                for (auto operand: instruction->operands)
+                    if (operand != instruction.get())
+                        uses[operand->id]++;
+
+        for (auto &block: function.blocks) {
+            auto count = block->instructions.size();
+
+            std::erase_if(block->instructions, [&uses](const std::unique_ptr<Instruction> &instruction) {
+                return uses[instruction->id] == 0 && !instruction->isTerminator() && !instruction->hasSideEffects();
+            });
+
+            removed = removed || block->instructions.size() != count;
+        }
+
+        changed = changed || removed;
+    }
+
+    return changed;
+}
+
+void verify(const Function &function) {
+    auto fail = [&function](const std::string &message) {
+        throw std::runtime_error("Invalid IR in function " + function.name + ": " + message);
+    };
+
+    std::unordered_set<const Instruction *> defined;
+    std::unordered_set<const Block *> blocks;
+
+    for (auto &block: function.blocks) {
+        blocks.insert(block.get());
+
+        for (auto &instruction: block->instructions)
+            defined.insert(instruction.get());
+    }
+
+    for (auto &block: function.blocks) {
+        auto name = "b" + std::to_string(block->id);
+
+        if (block->terminator() == nullptr)
+            fail(name + " doesn't end in a terminator");
+
+        auto phis = true;
+
+        for (auto &instruction: block->instructions) {
+            if (instruction->block != block.get())
+                fail("%" + std::to_string(instruction->id) + " is in " + name + " but doesn't know it");
+
+            if (instruction->isTerminator() && instruction != block->instructions.back())
+                fail(name + " has a terminator before its end");
+
+            if (instruction->opcode != Opcode::PHI)
+                phis = false;
+            else if (!phis)
+                fail(name + " has a phi after other instructions");
+            else if (instruction->operands.size() != block->predecessors.size())
+                fail("%" + std::to_string(instruction->id) + " doesn't have an operand for every predecessor");
+
+            for (auto operand: instruction->operands)
+                if (!defined.contains(operand))
+                    fail("%" + std::to_string(instruction->id) + " uses a value which isn't in the function");
+        }
+
+        // Every edge is in the predecessors of its target, as often as it is in the terminator
+        auto successors = block->successors();
+
+        for (auto successor: successors) {
+            if (!blocks.contains(successor))
+                fail(name + " jumps to a block which isn't in the function");
+
+            auto edges = std::count(successors.begin(), successors.end(), successor);
+            auto recorded = std::count(successor->predecessors.begin(), successor->predecessors.end(), block.get());
+
+            if (edges != recorded)
+                fail("the predecessors of b" + std::to_string(successor->id) + " don't match the jumps from " + name);
+        }
+
+        for (auto predecessor: block->predecessors) {
+            auto targets = predecessor->successors();
+
+            if (!blocks.contains(predecessor) ||
+                std::find(targets.begin(), targets.end(), block.get()) == targets.end())
+                fail(name + " has a predecessor which doesn't jump to it");
+        }
+    }
+}
+
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_PASSES_H
+#define ACL_PASSES_H
+
+#include "ir.h"
+
+namespace ir {
+
+// A transformation of the functions of a module, or an analysis storing its results in them
+class Pass {
+public:
+    virtual ~Pass() = default;
+
+    [[nodiscard]] virtual std::string name() const = 0;
+
+    // Returns whether the function was changed
+    virtual bool run(Function &function) = 0;
+};
+
+// Running passes over every function of a module, again and again until none of them changes
+// anything. The passes enable each other, e.g. folding a branch leaves blocks to remove.
+class PassManager {
+public:
+    void add(std::unique_ptr<Pass> pass);
+
+    void run(Module &module);
+
+    // Checking the functions after every pass, with verify()
+    bool verifying = false;
+
+    // The passes every module goes through
+    static PassManager standard();
+
+private:
+    std::vector<std::unique_ptr<Pass>> passes;
+};
+
+// Finding the types of the values. Int arithmetic is assumed to give ints, like in the type inference
+// of the tree, code running the IR has to check for results which overflowed into big integers.
+class InferTypes : public Pass {
+public:
+    [[nodiscard]] std::string name() const override { return "infer-types"; }
+
+    bool run(Function &function) override;
+};
+
+// Evaluating operators on constants, and replacing branches on constants by jumps
+class FoldConstants : public Pass {
+public:
+    [[nodiscard]] std::string name() const override { return "fold-constants"; }
+
+    bool run(Function &function) override;
+};
+
+// Removing unreachable blocks, phis with a single value and jumps to blocks with no other predecessor
+class SimplifyControlFlow : public Pass {
+public:
+    [[nodiscard]] std::string name() const override { return "simplify-control-flow"; }
+
+    bool run(Function &function) override;
+};
+
+// Removing instructions whose values are never used and which have no side effects
+class EliminateDeadCode : public Pass {
+public:
+    [[nodiscard]] std::string name() const override { return "eliminate-dead-code"; }
+
+    bool run(Function &function) override;
+};
+
+// Checking that a function is well formed: every block ends in its only terminator, the predecessors
+// match the jumps, phis have one operand per predecessor and every operand is defined in the function.
+// Throws if it isn't.
+void verify(const Function &function);
+
+}
+
+#endif //ACL_PASSES_H
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "assembler.h"
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace jit {
+
+static uint8_t number(Register reg) {
+    return static_cast<uint8_t>(reg);
+}
+
+Label Assembler::newLabel() {
+    this->labels.push_back(-1);
+
+    return Label{(int) this->labels.size() - 1};
+}
+
+void Assembler::bind(Label label) {
+    this->labels[label.id] = (int64_t) this->code.size();
+}
+
+void Assembler::byte(uint8_t value) {
+    this->code.push_back(value);
+}
+
+void Assembler::int32(int32_t value) {
+    for (int i = 0; i < 4; i++)
+        this->byte((uint8_t) ((uint32_t) value >> (8 * i)));
+}
+
+void Assembler::rex() {
+    this->byte(0x48);
+}
+
+void Assembler::registers(uint8_t reg, Register rm) {
+    this->byte(0xC0 | (reg << 3) | number(rm));
+}
+
+void Assembler::memory(uint8_t reg, Register base, int32_t offset) {
+    // Always with a 32-bit displacement, the short forms would save a few bytes at most
+    this->byte(0x80 | (reg << 3) | number(base));
+    this->int32(offset);
+}
+
+void Assembler::load(Register reg, Register base, int32_t offset) {
+    this->rex();
+    this->byte(0x8B);
+    this->memory(number(reg), base, offset);
+}
+
+void Assembler::store(Register base, int32_t offset, Register reg) {
+    this->rex();
+    this->byte(0x89);
+    this->memory(number(reg), base, offset);
+}
+
+void Assembler::storeImmediate(Register base, int32_t offset, int32_t value) {
+    this->rex();
+    this->byte(0xC7);
+    this->memory(0, base, offset);
+    this->int32(value);
+}
+
+void Assembler::compareMemory(Register base, int32_t offset, int32_t value) {
+    this->rex();
+    this->byte(0x81);
+    this->memory(7, base, offset);
+    this->int32(value);
+}
+
+void Assembler::moveImmediate(Register reg, int64_t value) {
+    this->rex();
+    this->byte(0xB8 + number(reg));
+
+    for (int i = 0; i < 8; i++)
+        this->byte((uint8_t) ((uint64_t) value >> (8 * i)));
+}
+
+void Assembler::move(Register destination, Register source) {
+    this->rex();
+    this->byte(0x89);
+    this->registers(number(source), destination);
+}
+
+void Assembler::loadAddress(Register reg, Register base, int32_t offset) {
+    this->rex();
+    this->byte(0x8D);
+    this->memory(number(reg), base, offset);
+}
+
+void Assembler::add(Register destination, Register source) {
+    this->rex();
+    this->byte(0x01);
+    this->registers(number(source), destination);
+}
+
+void Assembler::subtract(Register destination, Register source) {
+    this->rex();
+    this->byte(0x29);
+    this->registers(number(source), destination);
+}
+
+void Assembler::multiply(Register destination, Register source) {
+    this->rex();
+    this->byte(0x0F);
+    this->byte(0xAF);
+    this->registers(number(destination), source);
+}
+
+void Assembler::signedDivide(Register source) {
+    this->rex();
+    this->byte(0xF7);
+    this->registers(7, source);
+}
+
+void Assembler::signExtend() {
+    this->rex();
+    this->byte(0x99);
+}
+
+void Assembler::compare(Register left, Register right) {
+    this->rex();
+    this->byte(0x39);
+    this->registers(number(right), left);
+}
+
+void Assembler::compareImmediate(Register reg, int8_t value) {
+    this->rex();
+    this->byte(0x83);
+    this->registers(7, reg);
+    this->byte((uint8_t) value);
+}
+
+void Assembler::test(Register left, Register right) {
+    this->rex();
+    this->byte(0x85);
+    this->registers(number(right), left);
+}
+
+void Assembler::negate(Register reg) {
+    this->rex();
+    this->byte(0xF7);
+    this->registers(3, reg);
+}
+
+void Assembler::bitwiseAnd(Register destination, Register source) {
+    this->rex();
+    this->byte(0x21);
+    this->registers(number(source), destination);
+}
+
+void Assembler::bitwiseOr(Register destination, Register source) {
+    this->rex();
+    this->byte(0x09);
+    this->registers(number(source), destination);
+}
+
+void Assembler::setIf(Condition condition, Register reg) {
+    // setcc on the low byte, then movzx to clear the rest of the register
+    this->byte(0x0F);
+    this->byte(0x90 | static_cast<uint8_t>(condition));
+    this->registers(0, reg);
+    this->byte(0x0F);
+    this->byte(0xB6);
+    this->registers(number(reg), reg);
+}
+
+void Assembler::addMemory(Register base, int8_t value) {
+    this->rex();
+    this->byte(0x83);
+    this->memory(0, base, 0);
+    this->byte((uint8_t) value);
+}
+
+void Assembler::jump(Label target) {
+    this->byte(0xE9);
+    this->fixups.emplace_back(this->code.size(), target.id);
+    this->int32(0);
+}
+
+void Assembler::jumpIf(Condition condition, Label target) {
+    this->byte(0x0F);
+    this->byte(0x80 | static_cast<uint8_t>(condition));
+    this->fixups.emplace_back(this->code.size(), target.id);
+    this->int32(0);
+}
+
+void Assembler::callIndirect(Register base) {
+    this->byte(0xFF);
+    this->memory(2, base, 0);
+}
+
+void Assembler::push(Register reg) {
+    this->byte(0x50 + number(reg));
+}
+
+void Assembler::pop(Register reg) {
+    this->byte(0x58 + number(reg));
+}
+
+void Assembler::reserveStack(int32_t size) {
+    this->rex();
+    this->byte(0x81);
+    this->registers(5, Register::RSP);
+    this->int32(size);
+}
+
+void Assembler::ret() {
+    this->byte(0xC3);
+}
+
+void Assembler::finish() {
+    for (auto [offset, label]: this->fixups) {
+        if (this->labels[label] == -1)
+            throw std::runtime_error("Jump to an unbound label");
+
+        // Relative to the end of the displacement, which is the end of the jump
+        auto distance = (int32_t) (this->labels[label] - (int64_t) (offset + 4));
+
+        std::memcpy(&this->code[offset], &distance, 4);
+    }
+
+    this->fixups.clear();
+}
+
+ExecutableMemory::~ExecutableMemory() {
+    if (this->address != nullptr)
+        munmap(this->address, this->size);
+}
+
+void ExecutableMemory::load(const std::vector<uint8_t> &code) {
+    auto page = (size_t) sysconf(_SC_PAGESIZE);
+    auto size = (code.size() + page - 1) / page * page;
+    auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (address == MAP_FAILED)
+        throw std::runtime_error("Could not map memory for compiled code");
+
+    std::memcpy(address, code.data(), code.size());
+
+    // Never writable and executable at the same time
+    if (mprotect(address, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(address, size);
+        throw std::runtime_error("Could not make compiled code executable");
+    }
+
+    this->address = address;
+    this->size = size;
+}
+
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_ASSEMBLER_H
+#define ACL_ASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jit {
+
+// The registers the compiled code uses. Only the first eight, so no instruction needs the REX bits
+// extending the register numbers.
+enum class Register : uint8_t {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+};
+
+// Conditions of jumps and setcc, the low nibble of their opcodes
+enum class Condition : uint8_t {
+    OVERFLOW = 0x0,
+    EQUAL = 0x4,
+    NOT_EQUAL = 0x5,
+    LESS = 0xC,
+    GREATER_EQUAL = 0xD,
+    LESS_EQUAL = 0xE,
+    GREATER = 0xF,
+};
+
+// A position in the code, jumps to it are patched once it is bound
+struct Label {
+    int id;
+};
+
+// Encoding x86-64 instructions into a buffer. Memory operands are a base register and a 32-bit
+// displacement, the bases RSP and R12 would need a SIB byte and aren't supported.
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    Label newLabel();
+
+    void bind(Label label);
+
+    // mov reg, [base + offset] and mov [base + offset], reg
+    void load(Register reg, Register base, int32_t offset);
+
+    void store(Register base, int32_t offset, Register reg);
+
+    // mov qword [base + offset], value (sign extended)
+    void storeImmediate(Register base, int32_t offset, int32_t value);
+
+    // cmp qword [base + offset], value (sign extended)
+    void compareMemory(Register base, int32_t offset, int32_t value);
+
+    // mov reg, value
+    void moveImmediate(Register reg, int64_t value);
+
+    void move(Register destination, Register source);
+
+    // lea reg, [base + offset]
+    void loadAddress(Register reg, Register base, int32_t offset);
+
+    void add(Register destination, Register source);
+
+    void subtract(Register destination, Register source);
+
+    void multiply(Register destination, Register source);
+
+    // rdx:rax / source, the quotient in rax and the remainder in rdx
+    void signedDivide(Register source);
+
+    // Sign extending rax into rdx, before a division
+    void signExtend();
+
+    void compare(Register left, Register right);
+
+    // cmp reg, value (sign extended)
+    void compareImmediate(Register reg, int8_t value);
+
+    void test(Register left, Register right);
+
+    void negate(Register reg);
+
+    void bitwiseAnd(Register destination, Register source);
+
+    void bitwiseOr(Register destination, Register source);
+
+    // Setting a register to 1 if the condition holds and 0 otherwise
+    void setIf(Condition condition, Register reg);
+
+    // add qword [base], value and sub qword [base], value
+    void addMemory(Register base, int8_t value);
+
+    void jump(Label target);
+
+    void jumpIf(Condition condition, Label target);
+
+    // call [base], through a function pointer in memory
+    void callIndirect(Register base);
+
+    void push(Register reg);
+
+    void pop(Register reg);
+
+    // sub rsp, size
+    void reserveStack(int32_t size);
+
+    void ret();
+
+    // Patching the jumps to labels, all labels have to be bound
+    void finish();
+
+private:
+    // Offsets of the labels, -1 while unbound
+    std::vector<int64_t> labels;
+
+    // Offsets of 32-bit displacements to patch, with the label they jump to
+    std::vector<std::pair<size_t, int>> fixups;
+
+    void byte(uint8_t value);
+
+    void int32(int32_t value);
+
+    // REX prefix with the W bit, for 64-bit operands
+    void rex();
+
+    // ModRM byte for two registers
+    void registers(uint8_t reg, Register rm);
+
+    // ModRM byte and displacement for [base + offset]
+    void memory(uint8_t reg, Register base, int32_t offset);
+};
+
+// Memory holding compiled code. It is writable until the code is copied into it, and only
+// executable after that.
+class ExecutableMemory {
+public:
+    ExecutableMemory() = default;
+
+    ExecutableMemory(const ExecutableMemory &) = delete;
+
+    ExecutableMemory &operator=(const ExecutableMemory &) = delete;
+
+    ~ExecutableMemory();
+
+    // Mapping pages for the code and copying it into them, throws if the memory can't be mapped
+    void load(const std::vector<uint8_t> &code);
+
+    [[nodiscard]] void *start() const { return this->address; }
+
+private:
+    void *address = nullptr;
+    size_t size = 0;
+};
+
+}
+
+#endif //ACL_ASSEMBLER_H
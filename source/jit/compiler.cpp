@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compiler.h"
+#include <algorithm>
+#include "../interpreter/type.h"
+
+namespace jit {
+
+// Tag of the values compiled code works with
+const int32_t INT_TAG = BasicValue::Type::INT;
+
+bool Compiler::supported() {
+    this->parameters.assign(this->function->parameters.size(), nullptr);
+
+    for (auto &block: this->function->blocks) {
+        int phis = 0;
+
+        for (auto &item: block->instructions) {
+            auto instruction = item.get();
+
+            switch (instruction->opcode) {
+                case ir::Opcode::CONSTANT:
+                    // Big integers don't fit into a register
+                    if (instruction->type != StaticType::INT)
+                        return false;
+                    break;
+                case ir::Opcode::PARAMETER:
+                    this->parameters[instruction->intValue] = instruction;
+                    break;
+                case ir::Opcode::PHI:
+                    phis++;
+                    break;
+                case ir::Opcode::BINARY:
+                    if (instruction->op == Operator::UNKNOWN)
+                        return false;
+                    break;
+                case ir::Opcode::NEGATE:
+                case ir::Opcode::RESOLVES:
+                case ir::Opcode::JUMP:
+                    break;
+                case ir::Opcode::CALL: {
+                    auto definition = this->resolve(instruction->name);
+
+                    if (definition == nullptr || definition->parameters.size() != instruction->operands.size())
+                        return false;
+
+                    auto target = this->callee(definition);
+
+                    if (target == nullptr)
+                        return false;
+
+                    this->targets[instruction->id] = target;
+                    this->calls.emplace_back(instruction->name, definition);
+                    this->callSlots = std::max(this->callSlots, (int) instruction->operands.size());
+                    break;
+                }
+                case ir::Opcode::STORE: {
+                    auto &names = this->function->parameters;
+
+                    if (this->mode != Mode::LOOP || std::find(names.begin(), names.end(), instruction->name) == names.end())
+                        return false;
+                    break;
+                }
+                case ir::Opcode::BRANCH:
+                    // The phis of the target couldn't tell the two edges apart
+                    if (instruction->targets[0] == instruction->targets[1])
+                        return false;
+                    break;
+                case ir::Opcode::RETURN:
+                    if (instruction->operands.size() != (this->mode == Mode::FUNCTION ? 1 : 0))
+                        return false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+
+        this->phiSlots = std::max(this->phiSlots, phis);
+    }
+
+    // Functions without parameters still get a slot for their result
+    this->callSlots = std::max(this->callSlots, 1);
+
+    return true;
+}
+
+int32_t Compiler::valueOffset(const ir::Instruction *value) const {
+    return -16 - 8 * value->id;
+}
+
+int32_t Compiler::phiOffset(int index) const {
+    return -16 - 8 * this->function->nextValue - 8 * index;
+}
+
+int32_t Compiler::callOffset(int index) const {
+    return this->phiOffset(this->phiSlots - 1) - 16 * this->callSlots + 16 * index;
+}
+
+bool Compiler::compile(const ir::Function &function, ExecutableMemory &memory) {
+    this->function = &function;
+
+    if (!this->supported())
+        return false;
+
+    auto locals = 8 * (function.nextValue + this->phiSlots) + 16 * this->callSlots;
+
+    if (locals > MAX_FRAME)
+        return false;
+
+    auto &assembler = this->assembler;
+
+    this->deoptimize = assembler.newLabel();
+    this->exit = assembler.newLabel();
+    this->start = assembler.newLabel();
+
+    for (int i = 0; i < function.nextBlock; i++)
+        this->blocks.push_back(assembler.newLabel());
+
+    // The return address and the two saved registers leave rsp aligned to 16 bytes if the frame is 8 more
+    this->prologue(((locals + 8 + 15) & ~15) - 8);
+
+    for (size_t index = 0; index < function.blocks.size(); index++) {
+        auto &block = function.blocks[index];
+        auto skipNext = false;
+
+        assembler.bind(this->blocks[block->id]);
+
+        for (size_t i = 0; i < block->instructions.size(); i++) {
+            auto instruction = block->instructions[i].get();
+
+            if (skipNext) {
+                skipNext = false;
+                continue;
+            }
+
+            if (instruction->opcode == ir::Opcode::PHI || instruction->opcode == ir::Opcode::PARAMETER)
+                continue;
+
+            auto next = i + 1 < block->instructions.size() ? block->instructions[i + 1].get() : nullptr;
+
+            this->instruction(instruction, next, skipNext);
+        }
+    }
+
+    assembler.bind(this->deoptimize);
+    assembler.moveImmediate(Register::RAX, DEOPTIMIZED);
+    assembler.bind(this->exit);
+    this->epilogue();
+    assembler.finish();
+
+    memory.load(assembler.code);
+
+    return true;
+}
+
+void Compiler::prologue(int32_t frame) {
+    auto &assembler = this->assembler;
+
+    assembler.push(Register::RBP);
+    assembler.move(Register::RBP, Register::RSP);
+    assembler.push(Register::RBX);
+    assembler.reserveStack(frame);
+    assembler.move(Register::RBX, Register::RDI);
+
+    // Counting the call, like a frame of the interpreter
+    if (this->mode == Mode::FUNCTION) {
+        assembler.moveImmediate(Register::RCX, (int64_t) this->runtime);
+        assembler.addMemory(Register::RCX, 1);
+        assembler.load(Register::RAX, Register::RCX, offsetof(Runtime, depth));
+        assembler.load(Register::RDX, Register::RCX, offsetof(Runtime, limit));
+        assembler.compare(Register::RAX, Register::RDX);
+        assembler.jumpIf(Condition::GREATER, this->deoptimize);
+    }
+
+    // Every parameter which is used has to be an int
+    for (size_t i = 0; i < this->parameters.size(); i++) {
+        if (this->parameters[i] == nullptr)
+            continue;
+
+        auto slot = (int32_t) (16 * i);
+
+        assembler.compareMemory(Register::RBX, slot + (int32_t) offsetof(Slot, tag), INT_TAG);
+        assembler.jumpIf(Condition::NOT_EQUAL, this->deoptimize);
+        assembler.load(Register::RAX, Register::RBX, slot + (int32_t) offsetof(Slot, value));
+        assembler.store(Register::RBP, this->valueOffset(this->parameters[i]), Register::RAX);
+    }
+
+    assembler.bind(this->start);
+}
+
+void Compiler::epilogue() {
+    auto &assembler = this->assembler;
+
+    if (this->mode == Mode::FUNCTION) {
+        assembler.moveImmediate(Register::RCX, (int64_t) this->runtime);
+        assembler.addMemory(Register::RCX, -1);
+    }
+
+    assembler.load(Register::RBX, Register::RBP, -8);
+    assembler.move(Register::RSP, Register::RBP);
+    assembler.pop(Register::RBP);
+    assembler.ret();
+}
+
+void Compiler::instruction(const ir::Instruction *instruction, const ir::Instruction *next, bool &skipNext) {
+    auto &assembler = this->assembler;
+
+    switch (instruction->opcode) {
+        case ir::Opcode::CONSTANT:
+            assembler.moveImmediate(Register::RAX, instruction->intValue);
+            assembler.store(Register::RBP, this->valueOffset(instruction), Register::RAX);
+            break;
+        case ir::Opcode::BINARY:
+            this->binary(instruction);
+            break;
+        case ir::Opcode::NEGATE:
+            // Only the smallest int overflows
+            assembler.load(Register::RAX, Register::RBP, this->valueOffset(instruction->operands[0]));
+            assembler.negate(Register::RAX);
+            assembler.jumpIf(Condition::OVERFLOW, this->deoptimize);
+            assembler.store(Register::RBP, this->valueOffset(instruction), Register::RAX);
+            break;
+        case ir::Opcode::RESOLVES:
+            // Functions of the file don't change once they are defined, so the name is resolved once
+            assembler.moveImmediate(Register::RAX, this->resolve(instruction->name) == instruction->definition);
+            assembler.store(Register::RBP, this->valueOffset(instruction), Register::RAX);
+            break;
+        case ir::Opcode::CALL: {
+            // Calling the function itself in tail position starts it over instead
+            auto tailCall = this->mode == Mode::FUNCTION && next != nullptr && next->opcode == ir::Opcode::RETURN &&
+                            next->tailCall && next->operands[0] == instruction &&
+                            this->resolve(instruction->name) == this->function->definition;
+
+            this->call(instruction, tailCall);
+            skipNext = tailCall;
+            break;
+        }
+        case ir::Opcode::STORE: {
+            auto &names = this->function->parameters;
+            auto index = std::find(names.begin(), names.end(), instruction->name) - names.begin();
+
+            assembler.load(Register::RAX, Register::RBP, this->valueOffset(instruction->operands[0]));
+            assembler.store(Register::RBX, (int32_t) (16 * index + offsetof(Slot, value)), Register::RAX);
+            break;
+        }
+        case ir::Opcode::JUMP:
+            this->edge(instruction->block, instruction->targets[0]);
+            break;
+        case ir::Opcode::BRANCH: {
+            auto otherwise = assembler.newLabel();
+
+            assembler.load(Register::RAX, Register::RBP, this->valueOffset(instruction->operands[0]));
+            assembler.compareImmediate(Register::RAX, 1);
+            assembler.jumpIf(Condition::NOT_EQUAL, otherwise);
+            this->edge(instruction->block, instruction->targets[0]);
+            assembler.bind(otherwise);
+            this->edge(instruction->block, instruction->targets[1]);
+            break;
+        }
+        case ir::Opcode::RETURN:
+            if (this->mode == Mode::FUNCTION) {
+                assembler.load(Register::RAX, Register::RBP, this->valueOffset(instruction->operands[0]));
+                assembler.storeImmediate(Register::RBX, offsetof(Slot, tag), INT_TAG);
+                assembler.store(Register::RBX, offsetof(Slot, value), Register::RAX);
+            }
+
+            assembler.moveImmediate(Register::RAX, FINISHED);
+            assembler.jump(this->exit);
+            break;
+        default:
+            throw std::runtime_error("Cannot compile instruction " + ir::opcodeName(instruction->opcode));
+    }
+}
+
+void Compiler::binary(const ir::Instruction *instruction) {
+    auto &assembler = this->assembler;
+
+    assembler.load(Register::RAX, Register::RBP, this->valueOffset(instruction->operands[0]));
+    assembler.load(Register::RCX, Register::RBP, this->valueOffset(instruction->operands[1]));
+
+    switch (instruction->op) {
+        // Results which don't fit into 64 bits become big integers in the interpreter
+        case Operator::ADD:
+            assembler.add(Register::RAX, Register::RCX);
+            assembler.jumpIf(Condition::OVERFLOW, this->deoptimize);
+            break;
+        case Operator::SUBTRACT:
+            assembler.subtract(Register::RAX, Register::RCX);
+            assembler.jumpIf(Condition::OVERFLOW, this->deoptimize);
+            break;
+        case Operator::MULTIPLY:
+            assembler.multiply(Register::RAX, Register::RCX);
+            assembler.jumpIf(Condition::OVERFLOW, this->deoptimize);
+            break;
+        case Operator::DIVIDE:
+        case Operator::MODULO: {
+            // The interpreter reports the division by zero, and divides the smallest int by -1
+            auto divide = assembler.newLabel();
+
+            assembler.test(Register::RCX, Register::RCX);
+            assembler.jumpIf(Condition::EQUAL, this->deoptimize);
+            assembler.compareImmediate(Register::RCX, -1);
+            assembler.jumpIf(Condition::NOT_EQUAL, divide);
+            assembler.moveImmediate(Register::RDX, INT64_MIN);
+            assembler.compare(Register::RAX, Register::RDX);
+            assembler.jumpIf(Condition::EQUAL, this->deoptimize);
+            assembler.bind(divide);
+            assembler.signExtend();
+            assembler.signedDivide(Register::RCX);
+
+            if (instruction->op == Operator::MODULO)
+                assembler.move(Register::RAX, Register::RDX);
+            break;
+        }
+        case Operator::EQUAL:
+        case Operator::NOT_EQUAL:
+        case Operator::LESS:
+        case Operator::GREATER:
+        case Operator::LESS_EQUAL:
+        case Operator::GREATER_EQUAL: {
+            static const std::unordered_map<Operator, Condition> conditions = {
+                    {Operator::EQUAL, Condition::EQUAL},
+                    {Operator::NOT_EQUAL, Condition::NOT_EQUAL},
+                    {Operator::LESS, Condition::LESS},
+                    {Operator::GREATER, Condition::GREATER},
+                    {Operator::LESS_EQUAL, Condition::LESS_EQUAL},
+                    {Operator::GREATER_EQUAL, Condition::GREATER_EQUAL},
+            };
+
+            assembler.compare(Register::RAX, Register::RCX);
+            assembler.setIf(conditions.at(instruction->op), Register::RAX);
+            break;
+        }
+        case Operator::AND:
+            assembler.test(Register::RAX, Register::RAX);
+            assembler.setIf(Condition::NOT_EQUAL, Register::RAX);
+            assembler.test(Register::RCX, Register::RCX);
+            assembler.setIf(Condition::NOT_EQUAL, Register::RCX);
+            assembler.bitwiseAnd(Register::RAX, Register::RCX);
+            break;
+        case Operator::OR:
+            assembler.bitwiseOr(Register::RAX, Register::RCX);
+            assembler.setIf(Condition::NOT_EQUAL, Register::RAX);
+            break;
+        default:
+            throw std::runtime_error("Cannot compile operator " + ir::operatorName(instruction->op));
+    }
+
+    assembler.store(Register::RBP, this->valueOffset(instruction), Register::RAX);
+}
+
+void Compiler::call(const ir::Instruction *instruction, bool tailCall) {
+    auto &assembler = this->assembler;
+    auto &operands = instruction->operands;
+
+    // The arguments are copied before any parameter changes, they may be computed from the parameters
+    for (size_t i = 0; i < operands.size(); i++) {
+        auto slot = this->callOffset((int) i);
+
+        assembler.load(Register::RAX, Register::RBP, this->valueOffset(operands[i]));
+        assembler.store(Register::RBP, slot + (int32_t) offsetof(Slot, value), Register::RAX);
+
+        if (!tailCall)
+            assembler.storeImmediate(Register::RBP, slot + (int32_t) offsetof(Slot, tag), INT_TAG);
+    }
+
+    if (tailCall) {
+        for (size_t i = 0; i < operands.size(); i++) {
+            if (this->parameters[i] == nullptr)
+                continue;
+
+            assembler.load(Register::RAX, Register::RBP, this->callOffset((int) i) + (int32_t) offsetof(Slot, value));
+            assembler.store(Register::RBP, this->valueOffset(this->parameters[i]), Register::RAX);
+        }
+
+        assembler.jump(this->start);
+        return;
+    }
+
+    assembler.loadAddress(Register::RDI, Register::RBP, this->callOffset(0));
+    assembler.moveImmediate(Register::RAX, (int64_t) &this->targets[instruction->id]->entry);
+    assembler.callIndirect(Register::RAX);
+
+    // A callee which bailed out leaves the whole call to the interpreter
+    assembler.test(Register::RAX, Register::RAX);
+    assembler.jumpIf(Condition::NOT_EQUAL, this->deoptimize);
+    assembler.load(Register::RAX, Register::RBP, this->callOffset(0) + (int32_t) offsetof(Slot, value));
+    assembler.store(Register::RBP, this->valueOffset(instruction), Register::RAX);
+}
+
+void Compiler::edge(const ir::Block *from, const ir::Block *to) {
+    auto &assembler = this->assembler;
+    auto index = std::find(to->predecessors.begin(), to->predecessors.end(), from) - to->predecessors.begin();
+
+    std::vector<const ir::Instruction *> phis;
+
+    for (auto &instruction: to->instructions) {
+        if (instruction->opcode != ir::Opcode::PHI)
+            break;
+
+        phis.push_back(instruction.get());
+    }
+
+    // The phis get their values at once, one may be the operand of another
+    if (phis.size() == 1) {
+        assembler.load(Register::RAX, Register::RBP, this->valueOffset(phis[0]->operands[index]));
+        assembler.store(Register::RBP, this->valueOffset(phis[0]), Register::RAX);
+    } else {
+        for (size_t i = 0; i < phis.size(); i++) {
+            assembler.load(Register::RAX, Register::RBP, this->valueOffset(phis[i]->operands[index]));
+            assembler.store(Register::RBP, this->phiOffset((int) i), Register::RAX);
+        }
+
+        for (size_t i = 0; i < phis.size(); i++) {
+            assembler.load(Register::RAX, Register::RBP, this->phiOffset((int) i));
+            assembler.store(Register::RBP, this->valueOffset(phis[i]), Register::RAX);
+        }
+    }
+
+    assembler.jump(this->blocks[to->id]);
+}
+
+}
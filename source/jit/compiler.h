@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_COMPILER_H
+#define ACL_COMPILER_H
+
+#include "../ir/ir.h"
+#include "assembler.h"
+#include "jit.h"
+
+namespace jit {
+
+// Translating an IR function into machine code, one fixed sequence of instructions per IR instruction.
+// Every value has its own stack slot: an instruction loads its operands into registers, computes and
+// stores its value. Conditions are true if they are 1, like in the interpreter.
+//
+// The code is called with a pointer to the slots of its parameters (rdi). It keeps the pointer in rbx,
+// and rbp points to its frame:
+//
+//     [rbp - 8]                        saved rbx
+//     [rbp - 16 - 8 * id]              value with the given id
+//     below                            copies of phi values, then the slots of calls
+class Compiler {
+public:
+    enum class Mode {
+        // A function, returning its result in the first slot
+        FUNCTION,
+        // A loop lowered on its own, storing to its variables in the slots
+        LOOP,
+    };
+
+    // A called function, nullptr if compiled code can't call it
+    using Callee = std::function<CompiledFunction *(FunctionDefinitionNode *)>;
+
+    // Largest frame, the calls of compiled code don't check the native stack
+    static const int MAX_FRAME = 8 * 1024;
+
+    Compiler(Mode mode, Runtime *runtime, Jit::Resolver resolve, Callee callee)
+            : mode(mode), runtime(runtime), resolve(std::move(resolve)), callee(std::move(callee)) {}
+
+    // The functions the code calls, by name, once it is compiled
+    std::vector<std::pair<Symbol, FunctionDefinitionNode *>> calls;
+
+    // Compiling into the memory. Returns false if the function does anything but compute with ints
+    // and call functions which can be compiled.
+    bool compile(const ir::Function &function, ExecutableMemory &memory);
+
+private:
+    Mode mode;
+    Runtime *runtime;
+    Jit::Resolver resolve;
+    Callee callee;
+
+    const ir::Function *function = nullptr;
+    Assembler assembler;
+
+    // Labels of the blocks, by id
+    std::vector<Label> blocks;
+
+    // Taken by every failed check, and the end of the code
+    Label deoptimize{};
+    Label exit{};
+
+    // After the checks of the parameters, where calls of the function itself in tail position continue
+    Label start{};
+
+    // The parameters by index, nullptr for those which aren't used
+    std::vector<const ir::Instruction *> parameters;
+
+    // Callees of the calls, by the id of the call
+    std::unordered_map<int, CompiledFunction *> targets;
+
+    int phiSlots = 0;
+    int callSlots = 0;
+
+    // Whether every instruction can be compiled, resolving the calls
+    bool supported();
+
+    [[nodiscard]] int32_t valueOffset(const ir::Instruction *value) const;
+
+    [[nodiscard]] int32_t phiOffset(int index) const;
+
+    [[nodiscard]] int32_t callOffset(int index) const;
+
+    void prologue(int32_t frame);
+
+    void epilogue();
+
+    void instruction(const ir::Instruction *instruction, const ir::Instruction *next, bool &skipNext);
+
+    void binary(const ir::Instruction *instruction);
+
+    void call(const ir::Instruction *instruction, bool tailCall);
+
+    // Jumping along an edge, setting the phis of the target first
+    void edge(const ir::Block *from, const ir::Block *to);
+};
+
+}
+
+#endif //ACL_COMPILER_H
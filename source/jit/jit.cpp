@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jit.h"
+#include "compiler.h"
+#include "../ir/lowering.h"
+#include "../ir/passes.h"
+
+namespace jit {
+
+// Where calls of functions which aren't compiled go
+static int64_t bailOut(Slot *) {
+    return DEOPTIMIZED;
+}
+
+CompiledFunction::CompiledFunction() : entry(bailOut) {}
+
+CompiledFunction &Jit::function(FunctionDefinitionNode *definition) {
+    auto &function = this->functions[definition];
+
+    if (function == nullptr) {
+        function = std::make_unique<CompiledFunction>();
+        function->name = definition->name;
+        function->line = definition->line;
+    }
+
+    return *function;
+}
+
+CompiledLoop &Jit::loop(WhileStatementNode *node) {
+    auto &loop = this->loops[node];
+
+    if (loop == nullptr) {
+        loop = std::make_unique<CompiledLoop>();
+        loop->line = node->line;
+    }
+
+    return *loop;
+}
+
+bool Jit::prepare(CompiledFunction &function, FunctionDefinitionNode *definition) {
+    if (function.state == CodeState::COLD && ++function.calls >= this->callThreshold)
+        this->compile(function, definition);
+
+    return function.state == CodeState::COMPILED;
+}
+
+bool Jit::prepare(CompiledLoop &loop, WhileStatementNode *node, const VariableCheck &isVariable,
+                  const Resolver &resolve) {
+    if (loop.state == CodeState::COLD && loop.iterations >= this->loopThreshold)
+        this->compile(loop, node, isVariable, resolve);
+
+    return loop.state == CodeState::COMPILED;
+}
+
+int64_t Jit::run(NativeCode code, Slot *slots, int64_t limit) {
+    this->runtime.depth = 0;
+    this->runtime.limit = limit;
+
+    return code(slots);
+}
+
+void Jit::ran(CompiledFunction &function) {
+    function.compiledCalls++;
+}
+
+void Jit::ran(CompiledLoop &loop, bool replacement) {
+    loop.compiledRuns++;
+
+    if (replacement)
+        loop.replacements++;
+}
+
+void Jit::deoptimized(CompiledFunction &function) {
+    this->deoptimizations++;
+
+    if (++function.deoptimizations >= MAX_DEOPTIMIZATIONS) {
+        function.state = CodeState::FAILED;
+        function.entry = bailOut;
+        this->transition("function " + function.name, function.line,
+                         "compiled -> interpreter, after " + std::to_string(function.compiledCalls) +
+                         " compiled calls and " + std::to_string(MAX_DEOPTIMIZATIONS) + " deoptimizations");
+    }
+}
+
+void Jit::deoptimized(CompiledLoop &loop) {
+    this->deoptimizations++;
+
+    if (++loop.deoptimizations >= MAX_DEOPTIMIZATIONS) {
+        loop.state = CodeState::FAILED;
+        this->transition("loop", loop.line,
+                         "compiled -> interpreter, after " + std::to_string(loop.compiledRuns) +
+                         " compiled runs and " + std::to_string(MAX_DEOPTIMIZATIONS) + " deoptimizations");
+    }
+}
+
+void Jit::printStats(std::ostream &stream) const {
+    int64_t compiledCalls = 0;
+    int64_t compiledRuns = 0;
+    int64_t replacements = 0;
+
+    for (auto &function: this->functions)
+        compiledCalls += function.second->compiledCalls;
+
+    for (auto &loop: this->loops) {
+        compiledRuns += loop.second->compiledRuns;
+        replacements += loop.second->replacements;
+    }
+
+    stream << "jit: " << this->compiledFunctions << " functions and " << this->compiledLoops << " loops compiled, "
+           << this->failures << " not compilable, " << this->deoptimizations << " deoptimizations" << std::endl;
+    stream << "jit: " << compiledCalls << " compiled calls, " << compiledRuns << " compiled loop runs, "
+           << replacements << " on-stack replacements" << std::endl;
+
+    for (auto &transition: this->transitions)
+        stream << "tier: " << transition.what << " (line " << transition.line + 1 << "): " << transition.change
+               << std::endl;
+}
+
+void Jit::transition(std::string what, int line, std::string change) {
+    this->transitions.push_back({std::move(what), line, std::move(change)});
+}
+
+bool Jit::compilable(FunctionDefinitionNode *definition) {
+    if (definition->isExternal || definition->memoized)
+        return false;
+
+    if (definition->returnType != StaticType::UNKNOWN && definition->returnType != StaticType::INT)
+        return false;
+
+    return std::all_of(definition->parameterTypes.begin(), definition->parameterTypes.end(),
+                       [](StaticType type) { return type == StaticType::UNKNOWN; });
+}
+
+// Lowering code and compiling the first function of the module, false if it can't be compiled
+static bool compileModule(const std::function<std::unique_ptr<ir::Module>()> &lower, Compiler &compiler,
+                          ExecutableMemory &memory) {
+    try {
+        auto module = lower();
+
+        ir::PassManager::standard().run(*module);
+
+        return compiler.compile(*module->functions[0], memory);
+    } catch (const std::exception &) {
+        // Code the lowering doesn't know, or no memory for the code
+        return false;
+    }
+}
+
+bool Jit::compile(CompiledFunction &function, FunctionDefinitionNode *definition) {
+    function.state = CodeState::COMPILING;
+
+    Compiler compiler(Compiler::Mode::FUNCTION, &this->runtime, this->global,
+                      [this](FunctionDefinitionNode *callee) { return this->callee(callee); });
+
+    auto compiled = compilable(definition) &&
+                    compileModule([definition]() { return ir::Lowering().lower(definition); }, compiler,
+                                  function.memory);
+
+    if (!compiled) {
+        function.state = CodeState::FAILED;
+        this->failures++;
+        this->transition("function " + function.name, function.line, "not compilable");
+        return false;
+    }
+
+    function.state = CodeState::COMPILED;
+    function.entry = (NativeCode) function.memory.start();
+    this->compiledFunctions++;
+    // Functions called by compiled code are compiled with it, however often the interpreter called them
+    this->transition("function " + function.name, function.line,
+                     function.calls >= this->callThreshold
+                     ? "interpreter -> compiled, after " + std::to_string(function.calls) + " calls"
+                     : "interpreter -> compiled, called by compiled code");
+
+    return true;
+}
+
+bool Jit::compile(CompiledLoop &loop, WhileStatementNode *node, const VariableCheck &isVariable,
+                  const Resolver &resolve) {
+    loop.state = CodeState::FAILED;
+
+    // Lowered without any variables, the loop loads and stores the variables from outside by name
+    std::unique_ptr<ir::Module> outside;
+
+    try {
+        outside = ir::Lowering().lower(node, {});
+    } catch (const std::exception &) {
+        this->failures++;
+        this->transition("loop", loop.line, "not compilable");
+        return false;
+    }
+
+    auto returns = 0;
+
+    for (auto &block: outside->functions[0]->blocks) {
+        for (auto &instruction: block->instructions) {
+            auto opcode = instruction->opcode;
+            auto &name = instruction->name;
+
+            if (opcode == ir::Opcode::RETURN)
+                returns++;
+
+            if (opcode != ir::Opcode::LOAD && opcode != ir::Opcode::STORE)
+                continue;
+
+            if (std::find(loop.variables.begin(), loop.variables.end(), name) == loop.variables.end())
+                loop.variables.push_back(name);
+
+            if (opcode == ir::Opcode::STORE)
+                loop.assigned.insert(name);
+        }
+    }
+
+    // Return statements would end the function the loop is in, only the end of the loop returns
+    auto compiled = returns == 1 && std::all_of(loop.variables.begin(), loop.variables.end(), isVariable);
+
+    // The interpreter checks the condition while the variables of the last iteration are still defined,
+    // so a variable of the body hiding one from outside would be read by it
+    for (auto &statement: node->body) {
+        auto definition = dynamic_cast<VariableDefinitionNode *>(statement.get());
+
+        if (definition != nullptr && std::find(loop.variables.begin(), loop.variables.end(), definition->name) !=
+                                     loop.variables.end())
+            compiled = false;
+    }
+
+    Compiler compiler(Compiler::Mode::LOOP, &this->runtime, resolve,
+                      [this](FunctionDefinitionNode *callee) { return this->callee(callee); });
+
+    compiled = compiled && compileModule([node, &loop]() { return ir::Lowering().lower(node, loop.variables); },
+                                         compiler, loop.memory);
+
+    if (!compiled) {
+        this->failures++;
+        this->transition("loop", loop.line, "not compilable");
+        return false;
+    }
+
+    loop.state = CodeState::COMPILED;
+    loop.entry = (NativeCode) loop.memory.start();
+    loop.calls = compiler.calls;
+    this->compiledLoops++;
+    this->transition("loop", loop.line,
+                     "interpreter -> compiled, after " + std::to_string(loop.iterations) + " iterations");
+
+    return true;
+}
+
+CompiledFunction *Jit::callee(FunctionDefinitionNode *definition) {
+    auto &function = this->function(definition);
+
+    // Functions which are being compiled, i.e. recursive calls, are called through their entry once
+    // they are done
+    if (function.state == CodeState::COLD)
+        this->compile(function, definition);
+
+    return function.state == CodeState::FAILED ? nullptr : &function;
+}
+
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_JIT_H
+#define ACL_JIT_H
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../parser/ast.h"
+#include "assembler.h"
+
+// Compiling hot functions and while loops to x86-64 machine code. Code starts in the interpreter and
+// moves up to compiled code once it is hot: functions with their next call, loops at the start of their
+// next iteration, also in the middle of a run (on-stack replacement). Turned off with --no-jit.
+//
+// Only code computing with ints is compiled: int literals, variables, operators and calls of other
+// functions like that. The compiled code checks the type tags of the values it gets, and bails out
+// (deoptimizes) whenever it meets something it can't do itself, e.g. a result which doesn't fit into
+// 64 bits or a division by zero. Such code doesn't change anything but its own variables, so the
+// interpreter can always run it again:
+//
+// - A function which bailed out is called again by the interpreter, with the same arguments.
+// - A loop stores its variables whenever it checks its condition, so the interpreter goes on with
+//   the iteration which bailed out.
+namespace jit {
+
+// Whether the compiled code can run on this machine
+#if defined(__x86_64__) && defined(__linux__)
+const bool SUPPORTED = true;
+#else
+const bool SUPPORTED = false;
+#endif
+
+// A value passed to or from compiled code: the type of a BasicValue and the int it holds
+struct Slot {
+    int64_t tag;
+    int64_t value;
+};
+
+// Compiled code, called with the slots of its arguments or variables. A function returns its result
+// in the first slot.
+using NativeCode = int64_t (*)(Slot *slots);
+
+// What compiled code returns
+const int64_t FINISHED = 0;
+const int64_t DEOPTIMIZED = 1;
+
+enum class CodeState {
+    // Not hot enough to be compiled yet
+    COLD,
+    COMPILING,
+    COMPILED,
+    // Can't be compiled, or bailed out too often
+    FAILED,
+};
+
+// Shared by all compiled code. The calls compiled code makes don't create interpreter frames, they
+// are counted here so the stack limit still holds.
+struct Runtime {
+    int64_t depth = 0;
+    int64_t limit = 0;
+};
+
+struct CompiledFunction {
+    // Other compiled code calls the function through this pointer, so it has to be the first member.
+    // It points to code which always bails out unless the function is compiled.
+    NativeCode entry;
+
+    CodeState state = CodeState::COLD;
+    int64_t calls = 0;
+    int deoptimizations = 0;
+    ExecutableMemory memory;
+
+    // For --stats
+    std::string name;
+    int line = 0;
+    int64_t compiledCalls = 0;
+
+    CompiledFunction();
+};
+
+struct CompiledLoop {
+    NativeCode entry = nullptr;
+
+    CodeState state = CodeState::COLD;
+    int64_t iterations = 0;
+    int deoptimizations = 0;
+    ExecutableMemory memory;
+
+    // For --stats: runs of compiled code from the start of the loop, and from the middle of a run
+    int line = 0;
+    int64_t compiledRuns = 0;
+    int64_t replacements = 0;
+
+    // Variables from outside of the loop in the order of the slots, and those of them the loop assigns
+    std::vector<Symbol> variables;
+    std::unordered_set<Symbol> assigned;
+
+    // Functions the loop calls, with the definitions their names resolved to when it was compiled
+    std::vector<std::pair<Symbol, FunctionDefinitionNode *>> calls;
+};
+
+class Jit {
+public:
+    // Bailouts after which compiled code isn't used anymore
+    static const int MAX_DEOPTIMIZATIONS = 10;
+
+    // The function a called name refers to, nullptr unless it is a function defined in ACL at the top
+    // of a file
+    using Resolver = std::function<FunctionDefinitionNode *(const Symbol &)>;
+
+    // Whether a variable is defined where a loop runs
+    using VariableCheck = std::function<bool(const Symbol &)>;
+
+    // The functions the compiled functions call are resolved in the scope of the file
+    explicit Jit(Resolver global) : global(std::move(global)) {}
+
+    // Running the interpreter after compiled code and comparing the results, set with --jit-diff
+    bool differential = false;
+
+    // Calls of a function, and iterations of a loop over all its runs, before it is compiled. Set with
+    // --jit-call-threshold and --jit-loop-threshold.
+    int64_t callThreshold = 100;
+    int64_t loopThreshold = 1000;
+
+    // Compiled code isn't run while set, e.g. while the interpreter runs code again to compare
+    bool paused = false;
+
+    Runtime runtime;
+
+    CompiledFunction &function(FunctionDefinitionNode *definition);
+
+    CompiledLoop &loop(WhileStatementNode *node);
+
+    // Counting a call of a function, it is compiled once it is hot. Returns whether it is compiled.
+    bool prepare(CompiledFunction &function, FunctionDefinitionNode *definition);
+
+    // Compiling a loop once it is hot, the names it calls are resolved where it runs. Returns whether
+    // it is compiled.
+    bool prepare(CompiledLoop &loop, WhileStatementNode *node, const VariableCheck &isVariable,
+                 const Resolver &resolve);
+
+    // Running compiled code, which may make up to limit nested calls
+    int64_t run(NativeCode code, Slot *slots, int64_t limit);
+
+    // Counting runs of compiled code, for --stats
+    void ran(CompiledFunction &function);
+
+    void ran(CompiledLoop &loop, bool replacement);
+
+    // Counting a bailout, the code is given up after too many
+    void deoptimized(CompiledFunction &function);
+
+    void deoptimized(CompiledLoop &loop);
+
+    void printStats(std::ostream &stream) const;
+
+private:
+    Resolver global;
+
+    std::unordered_map<FunctionDefinitionNode *, std::unique_ptr<CompiledFunction>> functions;
+    std::unordered_map<WhileStatementNode *, std::unique_ptr<CompiledLoop>> loops;
+
+    // For --stats
+    int compiledFunctions = 0;
+    int compiledLoops = 0;
+    int failures = 0;
+    int64_t deoptimizations = 0;
+
+    // Moves of functions and loops between the interpreter and compiled code, in order
+    struct Transition {
+        std::string what;
+        int line;
+        std::string change;
+    };
+
+    void transition(std::string what, int line, std::string change);
+
+    std::vector<Transition> transitions;
+
+    // Whether compiled code can call a function the way the interpreter would: no memoization and no
+    // annotations which the call would have to check
+    static bool compilable(FunctionDefinitionNode *definition);
+
+    bool compile(CompiledFunction &function, FunctionDefinitionNode *definition);
+
+    bool compile(CompiledLoop &loop, WhileStatementNode *node, const VariableCheck &isVariable,
+                 const Resolver &resolve);
+
+    // A function called by compiled code, compiled first if it isn't yet. nullptr if it can't be.
+    CompiledFunction *callee(FunctionDefinitionNode *definition);
+};
+
+}
+
+#endif //ACL_JIT_H
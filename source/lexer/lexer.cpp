@@ -87,7 +87,8 @@ std::vector<Token> Lexer::tokenize(std::istream &input) {
                          identifier == "func" || identifier == "return" || identifier == "let" || identifier == "for" ||
                          identifier == "in" || identifier == "break" || identifier == "continue" ||
                          identifier == "import" || identifier == "const" || identifier == "external" ||
-                         identifier == "switch" || identifier == "case" || identifier == "default" || identifier == "class")
+                         identifier == "switch" || identifier == "case" || identifier == "default" || identifier == "class" ||
+                         identifier == "memo")
                     tokens.emplace_back(Token::Type::KEYWORD, identifier, line_index);
                 else tokens.emplace_back(Token::Type::IDENTIFIER, identifier, line_index);
 
@@ -143,6 +144,13 @@ std::vector<Token> Lexer::tokenize(std::istream &input) {
                 continue;
             }
 
+            // The arrow in front of the return type of a function
+            if (c == '-' && i + 1 < line.size() && line[i + 1] == '>') {
+                tokens.emplace_back(Token::Type::ARROW, "->", line_index);
+                i++;
+                continue;
+            }
+
             // If the char is an operator character
             if (c == '+' || c == '-' || c == '*' || c == '/' || c == '%') {
                 tokens.emplace_back(Token::Type::OPERATOR, std::string(1, c), line_index);
@@ -200,6 +208,20 @@ std::vector<Token> Lexer::tokenize(std::istream &input) {
                 i++;
 
                 while (i < line.size() && line[i] != '"') {
+                    // Escape sequences are replaced here once, so strings are never scanned again at runtime
+                    if (line[i] == '\\' && i + 1 < line.size()) {
+                        auto next = line[i + 1];
+
+                        if (next == 'n') string += '\n';
+                        else if (next == 't') string += '\t';
+                        else if (next == '"') string += '"';
+                        else if (next == '\\') string += '\\';
+                        else string += std::string(1, '\\') + next;
+
+                        i += 2;
+                        continue;
+                    }
+
                     string += line[i];
                     i++;
                 }
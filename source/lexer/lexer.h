@@ -29,7 +29,7 @@ class Token {
 public:
     enum Type {
         OPERATOR, LEFT_PAREN, RIGHT_PAREN,
-        LEFT_BRACE, RIGHT_BRACE, DOT, COMMA, COLON,
+        LEFT_BRACE, RIGHT_BRACE, DOT, COMMA, COLON, ARROW,
         LEFT_BRACKET, RIGHT_BRACKET,
 
         IDENTIFIER, STRING, INT, FLOAT, EQUALS,
@@ -15,99 +15,80 @@
  */
 
 #include "main.h"
-#include <filesystem>
-#include "utils.h"
-#include "error.h"
-
-// A list of all parsed files.
-std::vector<std::pair<std::string, AbstractSyntaxTree *>> parsed_files;
-
-// The default path to the source directory.
-std::string source_path;
+#include "runtime.h"
+#include "build.h"
+#include "ir/lowering.h"
+#include "ir/passes.h"
 
 int main(int argv, char **args) {
+    // `ACL build <file> -o <output>` compiles the program into an executable instead of running it
+    auto building = argv > 1 && std::string(args[1]) == "build";
+
+    std::string file;
+    std::string output;
+    RunOptions options;
+    auto dumpIr = false;
+
+    for (int i = building ? 2 : 1; i < argv; i++) {
+        auto argument = std::string(args[i]);
+
+        if (parseRunOption(argv, args, i, options)) {
+            continue;
+        } else if (argument == "--dump-ir") {
+            dumpIr = true;
+        } else if (building && argument == "-o" && i + 1 < argv) {
+            output = args[++i];
+        } else if (file.empty()) {
+            file = argument;
+        }
+    }
+
     // throwError(ErrorType::WARNING, "test", "test", "test", "sdf", "sdfsdf", 2, 2);
-    if (argv < 2) {
-        std::cout << "Usage: " << args[0] << " <file>" << std::endl;
+    if (file.empty()) {
+        std::cout << "Usage: " << args[0] << " " << RUN_OPTIONS_USAGE << " [--dump-ir] <file>" << std::endl;
+        std::cout << "       " << args[0] << " build " << RUN_OPTIONS_USAGE << " <file> [-o <output>]" << std::endl;
         return 1;
     }
 
+    optimize_files = options.optimize;
+
     // The source path is the path of the first argument, without the file.
-    const size_t last_slash_idx = std::string(args[1]).rfind('/');
+    const size_t last_slash_idx = file.rfind('/');
 
     if (std::string::npos != last_slash_idx) {
-        source_path = std::string(args[1]).substr(0, last_slash_idx);
+        source_path = file.substr(0, last_slash_idx);
     }
 
-    auto code = parse_file(std::string(args[1]), true)[0];
-
-    // code->print();
-
-    Interpreter interpreter(code);
+    if (building)
+        return buildProgram(file, output, options);
 
-    // Interpret the AST
-    interpreter.interpret();
-
-    return 0;
-}
+    AbstractSyntaxTree *code;
 
-std::vector<AbstractSyntaxTree *> parse_file(std::string file_path, bool is_main_file) {
-    vector<AbstractSyntaxTree *> trees;
-    if (!file_path.ends_with(".acl"))
-        file_path += ".acl";
-
-    // Checking if we already have the file parsed in out files vector
-    for (auto &file: parsed_files) {
-        if (file.first == file_path) {
-            trees.push_back(file.second);
-            return trees;
-        }
-    }
-
-    // Checking if it's a file from the default
-    std::string std_path_raw = std::string(getenv("HOME")) + "/.acl/std/" + file_path;
-    std::ifstream std_path(std_path_raw);
-
-
-    // We have an absolute path, because of the home directory, so we can check if it exists
-    if (std_path.good() || std_path.is_open()) {
-        std_path.close();
-        return parse_file(std_path_raw, true);
+    try {
+        code = parse_file(file, true)[0];
+    } catch (const std::exception &error) {
+        printError(error.what());
+        return 1;
     }
 
-    std::ifstream file((is_main_file ? "" : source_path + "/") + file_path);
+    // code->print();
 
-    if (!file.is_open()) {
-        auto splitPath = splitString(file_path, "/");
-        auto fileName = splitPath[splitPath.size() - 1];
-        if (!fileName.starts_with("*")) {
-            throw std::runtime_error("File not found: " + (is_main_file ? "" : source_path + "/") + file_path);
-        }
-        splitPath.pop_back();
-        std::string restPath;
-        for (const auto &item: splitPath)
-            restPath += item + "/";
-
-        for (const auto &entry: std::filesystem::directory_iterator(source_path + "/" + restPath)) {
-            string foundFile = entry.path();
-            trees.push_back(parse_file(foundFile, true)[0]);
+    // Printing the IR of the file instead of running it
+    if (dumpIr) {
+        try {
+            auto module = ir::Lowering().lower(code);
+            auto passes = ir::PassManager::standard();
+
+            passes.verifying = true;
+            passes.run(*module);
+            module->print(std::cout);
+        } catch (const std::exception &error) {
+            printError(error.what());
+            return 1;
         }
-        return trees;
-    }
 
-    //   /test/test/*   /test/test/utils.acl /test/test/main.acl
-
-    std::vector<Token> tokens = Lexer::tokenize(file);
-
-    // Parsing
-    Parser parser(tokens);
-
-    // Parse the tokens
-    auto ast = parser.parse();
-
-    parsed_files.emplace_back(file_path, ast);
+        return 0;
+    }
 
-    file.close();
-    trees.push_back(ast);
-    return trees;
-}
\ No newline at end of file
+    return runProgram(code, options);
+}
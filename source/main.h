@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
 #include "lexer/lexer.h"
 #include "parser/parser.h"
 #include "interpreter/interpreter.h"
@@ -27,4 +28,17 @@
 // Parsing a file and add it to the list of parsed files
 std::vector<AbstractSyntaxTree*> parse_file(std::string file_path, bool is_main_file = false);
 
+// Parsing the source of a file, the path is the one the file is known by
+AbstractSyntaxTree *parse_source(const std::string &file_path, const std::string &source);
+
+// The parsed files and their sources, by the path they were parsed with
+extern std::vector<std::pair<std::string, AbstractSyntaxTree *>> parsed_files;
+extern std::unordered_map<std::string, std::string> parsed_sources;
+
+// The directory of the main file, imports are relative to it
+extern std::string source_path;
+
+// Whether parsed files are optimized before they run, turned off with --no-optimize
+extern bool optimize_files;
+
 #endif //ACL_MAIN_H
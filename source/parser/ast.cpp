@@ -15,6 +15,9 @@
  */
 
 #include "ast.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
 
 void AbstractSyntaxTree::print() {
     std::cout << "AbstractSyntaxTree" << std::endl;
@@ -25,4 +28,159 @@ void AbstractSyntaxTree::print() {
         item->print();
         std::cout << std::endl;
     }
-}
\ No newline at end of file
+}
+
+// All method names seen so far and their selectors
+std::unordered_map<std::string, int> methodSelectors;
+
+int getMethodSelector(const std::string &name) {
+    auto selector = methodSelectors.find(name);
+
+    if (selector != methodSelectors.end())
+        return selector->second;
+
+    auto next = (int) methodSelectors.size();
+    methodSelectors[name] = next;
+
+    return next;
+}
+
+int getMethodSelectorCount() {
+    return (int) methodSelectors.size();
+}
+
+Operator decodeOperator(const std::string &op) {
+    static const std::unordered_map<std::string, Operator> operators = {
+            {"+",  Operator::ADD},
+            {"-",  Operator::SUBTRACT},
+            {"*",  Operator::MULTIPLY},
+            {"/",  Operator::DIVIDE},
+            {"%",  Operator::MODULO},
+            {"==", Operator::EQUAL},
+            {"!=", Operator::NOT_EQUAL},
+            {"<",  Operator::LESS},
+            {">",  Operator::GREATER},
+            {"<=", Operator::LESS_EQUAL},
+            {">=", Operator::GREATER_EQUAL},
+            {"&&", Operator::AND},
+            {"||", Operator::OR},
+    };
+
+    auto found = operators.find(op);
+
+    return found == operators.end() ? Operator::UNKNOWN : found->second;
+}
+
+bool isComparison(Operator op) {
+    return op == Operator::EQUAL || op == Operator::NOT_EQUAL || op == Operator::LESS || op == Operator::GREATER ||
+           op == Operator::LESS_EQUAL || op == Operator::GREATER_EQUAL;
+}
+
+StaticType decodeType(const std::string &name) {
+    if (name == "int") return StaticType::INT;
+    if (name == "float") return StaticType::FLOAT;
+    if (name == "string") return StaticType::STRING;
+
+    return StaticType::UNKNOWN;
+}
+
+std::string typeName(StaticType type) {
+    switch (type) {
+        case StaticType::INT:
+            return "int";
+        case StaticType::FLOAT:
+            return "float";
+        case StaticType::STRING:
+            return "string";
+        default:
+            return "any";
+    }
+}
+
+// The label of a case as text and, for integers, as number. Returns false if the label isn't a literal.
+bool getLiteralLabel(AstChild *label, std::string &text, bool &isInteger, int64_t &integer) {
+    auto negative = false;
+
+    // Negative numbers are parsed as a unary minus
+    if (label->getIdentifier() == "Unary") {
+        auto unary = dynamic_cast<UnaryExpressionNode *>(label);
+
+        if (unary->op != "-" || unary->child->getIdentifier() != "IntegerLiteral")
+            return false;
+
+        negative = true;
+        label = unary->child.get();
+    }
+
+    isInteger = label->getIdentifier() == "IntegerLiteral";
+
+    if (isInteger) {
+        auto literal = dynamic_cast<IntegerLiteralNode *>(label);
+
+        // Big integer labels are compared like any other expression
+        if (!literal->digits.empty())
+            return false;
+
+        // Negating through unsigned, the negation of the smallest int64 wraps to itself
+        integer = negative ? (int64_t) (0 - (uint64_t) literal->value) : literal->value;
+        text = std::to_string(integer);
+    } else if (label->getIdentifier() == "StringLiteral")
+        text = dynamic_cast<StringLiteralNode *>(label)->value.str();
+    else if (label->getIdentifier() == "FloatLiteral")
+        text = std::to_string(dynamic_cast<FloatLiteralNode *>(label)->value);
+    else
+        return false;
+
+    return true;
+}
+
+void SwitchStatementNode::buildTable() {
+    auto table = std::make_unique<SwitchTable>();
+    auto literals = true;
+    int64_t maximum = 0;
+
+    for (auto &caseNode: this->cases) {
+        if (caseNode->condition == nullptr) {
+            if (this->defaultCase != nullptr)
+                throw std::runtime_error("Multiple default cases");
+
+            this->defaultCase = caseNode.get();
+            continue;
+        }
+
+        std::string text;
+        bool isInteger;
+        int64_t integer;
+
+        if (!getLiteralLabel(caseNode->condition.get(), text, isInteger, integer)) {
+            literals = false;
+            continue;
+        }
+
+        if (!table->byText.emplace(text, caseNode.get()).second)
+            throw std::runtime_error("Multiple cases with the same value: " + text + ", line: " +
+                                     std::to_string(caseNode->condition->line + 1));
+
+        if (isInteger) {
+            table->minimum = table->byInteger.empty() ? integer : std::min(table->minimum, integer);
+            maximum = table->byInteger.empty() ? integer : std::max(maximum, integer);
+            table->byInteger[integer] = caseNode.get();
+        } else
+            table->integers = false;
+    }
+
+    if (!literals)
+        return;
+
+    // Dense enough labels are dispatched through an array, gaps go to the default case. The
+    // distances are unsigned, so labels far apart don't overflow.
+    if (table->integers && !table->byInteger.empty() &&
+        (uint64_t) maximum - (uint64_t) table->minimum < 4 * table->byInteger.size() + 16) {
+        table->jumpTable.resize((uint64_t) maximum - (uint64_t) table->minimum + 1, nullptr);
+
+        for (auto &[integer, caseNode]: table->byInteger)
+            table->jumpTable[(uint64_t) integer - (uint64_t) table->minimum] = caseNode;
+    }
+
+    this->table = std::move(table);
+}
@@ -17,10 +17,80 @@
 #ifndef ACL_AST_H
 #define ACL_AST_H
 
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <utility>
 #include <memory>
+#include <unordered_map>
+#include "symbol.h"
+
+class Shape;
+
+class FunctionDefinitionNode;
+
+class BasicValue;
+
+// Remembering the last shape seen at a member access, so the next access with the same
+// shape is just a compare and an indexed load
+struct InlineCache {
+    Shape *shape = nullptr;
+    int slot = -1;
+};
+
+// The shapes seen at a method call together with the method they resolved to. Sites
+// which see more shapes than fit in here use the method table of the class directly.
+struct PolymorphicInlineCache {
+    static const int SIZE = 4;
+
+    Shape *shapes[SIZE] = {};
+    FunctionDefinitionNode *methods[SIZE] = {};
+    int count = 0;
+};
+
+// Method names are numbered while parsing, the number indexes the method table of a class
+int getMethodSelector(const std::string &name);
+
+// Number of method names numbered so far
+int getMethodSelectorCount();
+
+// Binary operators, decoded once while parsing so evaluating them doesn't compare strings
+enum class Operator {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MODULO,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    GREATER,
+    LESS_EQUAL,
+    GREATER_EQUAL,
+    AND,
+    OR,
+    UNKNOWN,
+};
+
+Operator decodeOperator(const std::string &op);
+
+// ==, !=, <, >, <= and >=, which give 0 or 1 for any operands
+bool isComparison(Operator op);
+
+// Type of a value as far as the type inference can tell before running the program, also
+// the types a variable, parameter or return value can be annotated with
+enum class StaticType {
+    UNKNOWN,
+    INT,
+    FLOAT,
+    STRING,
+};
+
+// The type named in an annotation, UNKNOWN for names which aren't types
+StaticType decodeType(const std::string &name);
+
+// Name of a type as written in annotations
+std::string typeName(StaticType type);
 
 class AstChild {
 public:
@@ -31,7 +101,7 @@ public:
     virtual void print() = 0;
 
     // the line where the node is defined
-    int line;
+    int line = 0;
 };
 
 class ExpressionNode : public AstChild {
@@ -41,12 +111,21 @@ public:
     std::unique_ptr<AstChild> left;
     std::unique_ptr<AstChild> right;
     std::string op;
+    Operator opcode;
+
+    // Set by the type inference if both operands are always ints or always floats
+    StaticType operands = StaticType::UNKNOWN;
+
+    // Set by the type inference to the type of the result if the expression only reads literals and
+    // variables, the interpreter evaluates it without boxing the intermediate values
+    StaticType unboxed = StaticType::UNKNOWN;
 
     // Constructor requires a left and right child and an operator
     ExpressionNode(std::unique_ptr<AstChild> left, std::unique_ptr<AstChild> right, std::string op) {
         this->left = std::move(left);
         this->right = std::move(right);
         this->op = std::move(op);
+        this->opcode = decodeOperator(this->op);
     }
 
     [[nodiscard]] std::string getIdentifier() override {
@@ -67,10 +146,13 @@ class IntegerLiteralNode : public AstChild {
 public:
     ~IntegerLiteralNode() override = default;
 
-    int value;
+    int64_t value;
+
+    // The digits of literals too large for 64 bits, they become big integers
+    std::string digits;
 
     // Constructor requires a value
-    explicit IntegerLiteralNode(int value) : value(value) {}
+    explicit IntegerLiteralNode(int64_t value) : value(value) {}
 
     [[nodiscard]] std::string getIdentifier() override {
         return "IntegerLiteral";
@@ -85,10 +167,10 @@ class FloatLiteralNode : public AstChild {
 public:
     ~FloatLiteralNode() override = default;
 
-    float value;
+    double value;
 
     // Constructor requires a value
-    explicit FloatLiteralNode(float value) : value(value) {}
+    explicit FloatLiteralNode(double value) : value(value) {}
 
     [[nodiscard]] std::string getIdentifier() override {
         return "FloatLiteral";
@@ -127,10 +209,13 @@ class StringLiteralNode : public AstChild {
 public:
     ~StringLiteralNode() override = default;
 
-    std::string value;
+    Symbol value;
+
+    // Every evaluation of the literal shares this buffer
+    std::shared_ptr<std::string> buffer;
 
     // Constructor requires a value
-    explicit StringLiteralNode(std::string value) : value(std::move(value)) {}
+    explicit StringLiteralNode(const std::string &value) : value(value), buffer(std::make_shared<std::string>(value)) {}
 
     [[nodiscard]] std::string getIdentifier() override {
         return "StringLiteral";
@@ -145,10 +230,13 @@ class VariableDefinitionNode : public AstChild {
 public:
     ~VariableDefinitionNode() override = default;
 
-    std::string name;
+    Symbol name;
     std::unique_ptr<AstChild> value;
     bool constant;
 
+    // Annotated with `let name: type`, UNKNOWN if the variable can hold anything
+    StaticType type = StaticType::UNKNOWN;
+
     // Constructor requires a name and a value
     VariableDefinitionNode(std::string name, std::unique_ptr<AstChild> value, bool constant) {
         this->name = std::move(name);
@@ -171,7 +259,7 @@ class VariableReferenceNode : public AstChild {
 public:
     ~VariableReferenceNode() override = default;
 
-    std::string name;
+    Symbol name;
 
     // Constructor requires a name
     explicit VariableReferenceNode(std::string name) : name(std::move(name)) {}
@@ -189,9 +277,16 @@ class VariableAssignmentNode : public AstChild {
 public:
     ~VariableAssignmentNode() override = default;
 
-    std::string name;
+    Symbol name;
     std::unique_ptr<AstChild> value;
 
+    // Set for assignments to an element, e.g. `a[i][j] = x`
+    std::vector<std::unique_ptr<AstChild>> indices;
+
+    // Whether `s = s + ...` can append to the string in place, checked on the first evaluation
+    bool appendChecked = false;
+    bool appendable = false;
+
     // Constructor requires a name and a value
     VariableAssignmentNode(std::string name, std::unique_ptr<AstChild> value) {
         this->name = std::move(name);
@@ -204,6 +299,13 @@ public:
 
     void print() override {
         std::cout << this->getIdentifier() << "(" << name << " ";
+
+        for (auto &index: indices) {
+            std::cout << "[";
+            index->print();
+            std::cout << "] ";
+        }
+
         value->print();
         std::cout << ")";
     }
@@ -213,7 +315,7 @@ class FunctionCallNode : public AstChild {
 public:
     ~FunctionCallNode() override = default;
 
-    std::string name;
+    Symbol name;
     std::vector<std::unique_ptr<AstChild>> args;
 
     // Constructor requires a name and a vector of arguments
@@ -235,6 +337,76 @@ public:
     }
 };
 
+// A call the optimizer replaced by the body of the called function, with the arguments put in
+// place of the parameters. The call is kept, it runs instead if the name turns out to resolve to
+// another function (e.g. one of an imported file).
+class InlinedCallNode : public AstChild {
+public:
+    ~InlinedCallNode() override = default;
+
+    std::unique_ptr<FunctionCallNode> call;
+    std::unique_ptr<AstChild> body;
+    FunctionDefinitionNode *function;
+
+    enum State {
+        UNCHECKED,
+        INLINED,
+        CALLED,
+    };
+
+    // Whether the name resolves to the inlined function, checked on the first evaluation
+    State state = UNCHECKED;
+
+    InlinedCallNode(std::unique_ptr<FunctionCallNode> call, std::unique_ptr<AstChild> body,
+                    FunctionDefinitionNode *function) {
+        this->call = std::move(call);
+        this->body = std::move(body);
+        this->function = function;
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "InlinedCall";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        body->print();
+        std::cout << ")";
+    }
+};
+
+// An expression which gives the same value in every iteration of a loop. It is evaluated the first
+// time it is needed after the loop started, later iterations use that value.
+class InvariantNode : public AstChild {
+public:
+    ~InvariantNode() override = default;
+
+    std::unique_ptr<AstChild> value;
+
+    // Builtins the expression calls, it is only cached if the names resolve to the builtins
+    std::vector<Symbol> builtins;
+    bool checked = false;
+    bool cacheable = false;
+
+    // Value in the current run of the loop, reset by the loop whenever it starts
+    std::shared_ptr<BasicValue> cached;
+
+    explicit InvariantNode(std::unique_ptr<AstChild> value) {
+        this->line = value->line;
+        this->value = std::move(value);
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "Invariant";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        value->print();
+        std::cout << ")";
+    }
+};
+
 class IfStatementNode : public AstChild {
 public:
     ~IfStatementNode() override = default;
@@ -277,6 +449,9 @@ public:
     std::unique_ptr<AstChild> condition;
     std::vector<std::unique_ptr<AstChild>> body;
 
+    // Invariant expressions in the loop, their values are forgotten whenever the loop starts
+    std::vector<InvariantNode *> invariants;
+
     // Constructor requires a condition and a body
     WhileStatementNode(std::unique_ptr<AstChild> condition, std::vector<std::unique_ptr<AstChild>> body) {
         this->condition = std::move(condition);
@@ -303,10 +478,13 @@ class ForStatementNode : public AstChild {
 public:
     ~ForStatementNode() override = default;
 
-    std::string initializer;
+    Symbol initializer;
     std::unique_ptr<AstChild> location;
     std::vector<std::unique_ptr<AstChild>> body;
 
+    // Invariant expressions in the loop, their values are forgotten whenever the loop starts
+    std::vector<InvariantNode *> invariants;
+
     ForStatementNode(std::string initializer, std::unique_ptr<AstChild> location,
                      std::vector<std::unique_ptr<AstChild>> body) {
         this->initializer = std::move(initializer);
@@ -362,13 +540,21 @@ class FunctionDefinitionNode : public AstChild {
 public:
     ~FunctionDefinitionNode() override = default;
 
-    std::string name;
-    std::vector<std::string> parameters;
+    Symbol name;
+    std::vector<Symbol> parameters;
     std::vector<std::unique_ptr<AstChild>> body;
     bool isExternal;
 
+    // Defined with `memo func`, the results are cached by the arguments
+    bool memoized = false;
+
+    // Annotated types of the parameters (one per parameter) and of the result, UNKNOWN if
+    // there is no annotation
+    std::vector<StaticType> parameterTypes;
+    StaticType returnType = StaticType::UNKNOWN;
+
     // Constructor requires a name, args and body
-    FunctionDefinitionNode(std::string name, std::vector<std::string> parameters,
+    FunctionDefinitionNode(std::string name, std::vector<Symbol> parameters,
                            std::vector<std::unique_ptr<AstChild>> body, bool isExternal) {
         this->name = std::move(name);
         this->parameters = std::move(parameters);
@@ -400,6 +586,9 @@ public:
 
     std::unique_ptr<AstChild> value;
 
+    // Returning the result of a function call, the call can reuse the frame of the returning function
+    bool tailCall = false;
+
     // Constructor requires a value
     explicit ReturnStatementNode(std::unique_ptr<AstChild> value) {
         this->value = std::move(value);
@@ -492,6 +681,33 @@ public:
     }
 };
 
+class MapNode : public AstChild {
+public:
+    ~MapNode() override = default;
+
+    std::vector<std::pair<std::unique_ptr<AstChild>, std::unique_ptr<AstChild>>> entries;
+
+    // Constructor requires a vector of key value pairs
+    explicit MapNode(std::vector<std::pair<std::unique_ptr<AstChild>, std::unique_ptr<AstChild>>> entries) {
+        this->entries = std::move(entries);
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "Map";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        for (auto &entry: entries) {
+            entry.first->print();
+            std::cout << ": ";
+            entry.second->print();
+            std::cout << " ";
+        }
+        std::cout << ")";
+    }
+};
+
 class SwitchCaseNode : public AstChild {
 public:
     ~SwitchCaseNode() override = default;
@@ -521,19 +737,47 @@ public:
     }
 };
 
+// Dispatch table of a switch whose cases are all literals. Cases are found by the text of
+// their label, the same way the interpreter compares values, and switches over integers
+// also get a jump table (dense labels) or a hash table keyed by the integer.
+struct SwitchTable {
+    // Allows looking up a std::string_view without creating a std::string
+    struct TextHash {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+    };
+
+    std::unordered_map<std::string, SwitchCaseNode *, TextHash, std::equal_to<>> byText;
+
+    // Only used if all labels are integers
+    bool integers = true;
+    int64_t minimum = 0;
+    std::vector<SwitchCaseNode *> jumpTable;
+    std::unordered_map<int64_t, SwitchCaseNode *> byInteger;
+};
+
 class SwitchStatementNode : public AstChild {
 public:
     ~SwitchStatementNode() override = default;
 
     std::unique_ptr<AstChild> condition;
     std::vector<std::unique_ptr<SwitchCaseNode>> cases;
+    SwitchCaseNode *defaultCase = nullptr;
+
+    // Built with the node, nullptr if a label isn't a literal
+    std::unique_ptr<SwitchTable> table;
 
     // Constructor requires a condition and body
     SwitchStatementNode(std::unique_ptr<AstChild> condition, std::vector<std::unique_ptr<SwitchCaseNode>> cases) {
         this->condition = std::move(condition);
         this->cases = std::move(cases);
+        this->buildTable();
     }
 
+    // Finding the default case and building the dispatch table
+    void buildTable();
+
     [[nodiscard]] std::string getIdentifier() override {
         return "SwitchStatement";
     }
@@ -554,14 +798,14 @@ class ClassDefinitionNode : public AstChild {
 public:
     ~ClassDefinitionNode() override = default;
 
-    std::string name;
+    Symbol name;
     std::vector<std::unique_ptr<AstChild>> body;
 
     // Constructor values
-    std::vector<std::string> constructor;
+    std::vector<Symbol> constructor;
 
     // Constructor requires a name and body
-    ClassDefinitionNode(std::string name, std::vector<std::unique_ptr<AstChild>> body, std::vector<std::string> constructor) {
+    ClassDefinitionNode(std::string name, std::vector<std::unique_ptr<AstChild>> body, std::vector<Symbol> constructor) {
         this->name = std::move(name);
         this->body = std::move(body);
         this->constructor = std::move(constructor);
@@ -583,6 +827,93 @@ public:
     }
 };
 
+class MemberAccessNode : public AstChild {
+public:
+    ~MemberAccessNode() override = default;
+
+    std::unique_ptr<AstChild> object;
+    std::string name;
+    InlineCache cache;
+
+    // Constructor requires an object and the name of the field
+    MemberAccessNode(std::unique_ptr<AstChild> object, std::string name) {
+        this->object = std::move(object);
+        this->name = std::move(name);
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "MemberAccess";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        object->print();
+        std::cout << " " << name << ")";
+    }
+};
+
+class MemberAssignmentNode : public AstChild {
+public:
+    ~MemberAssignmentNode() override = default;
+
+    std::unique_ptr<AstChild> object;
+    std::string name;
+    std::unique_ptr<AstChild> value;
+    InlineCache cache;
+
+    // Constructor requires an object, the name of the field and a value
+    MemberAssignmentNode(std::unique_ptr<AstChild> object, std::string name, std::unique_ptr<AstChild> value) {
+        this->object = std::move(object);
+        this->name = std::move(name);
+        this->value = std::move(value);
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "MemberAssignment";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        object->print();
+        std::cout << " " << name << " ";
+        value->print();
+        std::cout << ")";
+    }
+};
+
+class MethodCallNode : public AstChild {
+public:
+    ~MethodCallNode() override = default;
+
+    std::unique_ptr<AstChild> object;
+    std::string name;
+    std::vector<std::unique_ptr<AstChild>> args;
+    int selector;
+    PolymorphicInlineCache cache;
+
+    // Constructor requires an object, the name of the method and a vector of arguments
+    MethodCallNode(std::unique_ptr<AstChild> object, std::string name, std::vector<std::unique_ptr<AstChild>> args) {
+        this->object = std::move(object);
+        this->name = std::move(name);
+        this->args = std::move(args);
+        this->selector = getMethodSelector(this->name);
+    }
+
+    [[nodiscard]] std::string getIdentifier() override {
+        return "MethodCall";
+    }
+
+    void print() override {
+        std::cout << this->getIdentifier() << "(";
+        object->print();
+        std::cout << " " << name << " ";
+        for (auto &arg: args) {
+            arg->print();
+        }
+        std::cout << ")";
+    }
+};
+
 class AbstractSyntaxTree {
 public:
     virtual ~AbstractSyntaxTree() = default;
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "inference.h"
+
+void TypeInference::inferTypes(AbstractSyntaxTree *ast) {
+    this->collectFunctions(ast->children);
+
+    this->scopes.clear();
+    this->scopes.emplace_back();
+
+    for (auto child: ast->children)
+        this->statement(child);
+}
+
+void TypeInference::collectFunctions(std::vector<AstChild *> &children) {
+    for (auto child: children) {
+        if (child->getIdentifier() == "FunctionDefinition") {
+            auto function = dynamic_cast<FunctionDefinitionNode *>(child);
+
+            if (function->isExternal)
+                continue;
+
+            // A function defined twice can return either result
+            auto known = this->userFunctions.find(function->name);
+
+            if (known == this->userFunctions.end())
+                this->userFunctions[function->name] = function->returnType;
+            else
+                known->second = join(known->second, function->returnType);
+        }
+    }
+}
+
+StaticType TypeInference::join(StaticType a, StaticType b) {
+    return a == b ? a : StaticType::UNKNOWN;
+}
+
+void TypeInference::join(Environment &into, const Environment &other) {
+    for (size_t i = 0; i < into.size() && i < other.size(); i++) {
+        for (auto &[name, variable]: into[i]) {
+            auto found = other[i].find(name);
+
+            variable.type = found == other[i].end() ? variable.annotation : join(variable.type, found->second.type);
+        }
+    }
+}
+
+StaticType TypeInference::lookup(const Symbol &name) {
+    for (auto scope = this->scopes.rbegin(); scope != this->scopes.rend(); scope++) {
+        auto found = scope->find(name);
+
+        if (found != scope->end())
+            return found->second.type;
+    }
+
+    return StaticType::UNKNOWN;
+}
+
+void TypeInference::assign(const Symbol &name, StaticType type) {
+    // Variables which aren't tracked (e.g. those of the file, inside of a function) stay unknown
+    for (auto scope = this->scopes.rbegin(); scope != this->scopes.rend(); scope++) {
+        auto found = scope->find(name);
+
+        if (found != scope->end()) {
+            if (found->second.annotation == StaticType::UNKNOWN)
+                found->second.type = type;
+
+            return;
+        }
+    }
+}
+
+void TypeInference::forgetAll() {
+    for (auto &scope: this->scopes)
+        for (auto &[name, variable]: scope)
+            variable.type = variable.annotation;
+}
+
+void TypeInference::block(std::vector<std::unique_ptr<AstChild>> &body) {
+    for (auto &item: body)
+        this->statement(item.get());
+}
+
+void TypeInference::scopedBlock(std::vector<std::unique_ptr<AstChild>> &body) {
+    this->scopes.emplace_back();
+    this->block(body);
+    this->scopes.pop_back();
+}
+
+void TypeInference::statement(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "VariableDefinition") {
+        auto realNode = dynamic_cast<VariableDefinitionNode *>(node);
+        auto type = this->expression(realNode->value.get());
+
+        if (realNode->type != StaticType::UNKNOWN)
+            type = realNode->type;
+
+        this->scopes.back()[realNode->name] = {type, realNode->type};
+    } else if (identifier == "VariableAssignment") {
+        auto realNode = dynamic_cast<VariableAssignmentNode *>(node);
+
+        for (auto &index: realNode->indices)
+            this->expression(index.get());
+
+        auto type = this->expression(realNode->value.get());
+
+        // Assigning to an element doesn't change the type of the variable
+        if (realNode->indices.empty())
+            this->assign(realNode->name, type);
+    } else if (identifier == "MemberAssignment") {
+        auto realNode = dynamic_cast<MemberAssignmentNode *>(node);
+
+        this->expression(realNode->object.get());
+        this->expression(realNode->value.get());
+    } else if (identifier == "IfStatement") {
+        auto realNode = dynamic_cast<IfStatementNode *>(node);
+
+        this->expression(realNode->condition.get());
+
+        auto entry = this->scopes;
+
+        this->scopedBlock(realNode->thenBranch);
+
+        auto afterThen = std::move(this->scopes);
+        this->scopes = std::move(entry);
+
+        this->scopedBlock(realNode->elseBranch);
+
+        join(this->scopes, afterThen);
+    } else if (identifier == "SwitchStatement") {
+        auto realNode = dynamic_cast<SwitchStatementNode *>(node);
+
+        this->expression(realNode->condition.get());
+
+        for (auto &caseNode: realNode->cases)
+            if (caseNode->condition != nullptr)
+                this->expression(caseNode->condition.get());
+
+        // Without a matching case nothing runs
+        auto entry = this->scopes;
+        auto result = this->scopes;
+
+        for (auto &caseNode: realNode->cases) {
+            this->scopes = entry;
+            this->scopedBlock(caseNode->body);
+
+            join(result, this->scopes);
+        }
+
+        this->scopes = std::move(result);
+    } else if (identifier == "WhileStatement") {
+        auto realNode = dynamic_cast<WhileStatementNode *>(node);
+
+        this->loop(realNode->condition.get(), realNode->body, nullptr, StaticType::UNKNOWN);
+    } else if (identifier == "ForStatement") {
+        auto realNode = dynamic_cast<ForStatementNode *>(node);
+        auto elementType = StaticType::UNKNOWN;
+
+        this->expression(realNode->location.get());
+
+        // Only range() is known to produce ints
+        if (realNode->location->getIdentifier() == "FunctionCall") {
+            auto call = dynamic_cast<FunctionCallNode *>(realNode->location.get());
+
+            if (call->name == Symbol("range") && !this->userFunctions.contains(call->name))
+                elementType = StaticType::INT;
+        }
+
+        this->loop(nullptr, realNode->body, &realNode->initializer, elementType);
+    } else if (identifier == "BreakStatement" || identifier == "ContinueStatement") {
+        auto targets = identifier == "BreakStatement" ? this->breaks : this->continues;
+
+        // Only the scopes outside of the loop matter after it
+        if (targets != nullptr)
+            targets->emplace_back(this->scopes.begin(), this->scopes.begin() + (long) this->loopDepth);
+    } else if (identifier == "ReturnStatement") {
+        auto realNode = dynamic_cast<ReturnStatementNode *>(node);
+
+        if (realNode->value != nullptr)
+            this->expression(realNode->value.get());
+    } else if (identifier == "FunctionDefinition") {
+        auto realNode = dynamic_cast<FunctionDefinitionNode *>(node);
+
+        // A function defined in a function can assign to the variables around it whenever it is called
+        if (this->scopes.size() > 1)
+            this->callsChangeVariables = true;
+
+        if (!realNode->isExternal)
+            this->function(realNode);
+    } else if (identifier == "ClassDefinition") {
+        auto realNode = dynamic_cast<ClassDefinitionNode *>(node);
+
+        // Fields aren't tracked, every method can change them
+        for (auto &item: realNode->body) {
+            if (item->getIdentifier() == "FunctionDefinition") {
+                this->function(dynamic_cast<FunctionDefinitionNode *>(item.get()));
+            } else if (item->getIdentifier() == "VariableDefinition") {
+                this->expression(dynamic_cast<VariableDefinitionNode *>(item.get())->value.get());
+            }
+        }
+    } else if (identifier != "ImportStatement") {
+        this->expression(node);
+    }
+}
+
+void TypeInference::loop(AstChild *condition, std::vector<std::unique_ptr<AstChild>> &body, const Symbol *variable,
+                         StaticType variableType) {
+    auto outerBreaks = this->breaks;
+    auto outerContinues = this->continues;
+    auto outerDepth = this->loopDepth;
+
+    std::vector<Environment> breaks, continues;
+
+    this->breaks = &breaks;
+    this->continues = &continues;
+    this->loopDepth = this->scopes.size();
+
+    // Types can only become unknown, so this ends after at most one round per variable. The
+    // expressions are marked with the types of the last round, which hold for every iteration.
+    while (true) {
+        auto head = this->scopes;
+
+        breaks.clear();
+        continues.clear();
+
+        if (condition != nullptr)
+            this->expression(condition);
+
+        // The loop body has its own scope, the loop variable is the first variable in it
+        this->scopes.emplace_back();
+
+        if (variable != nullptr)
+            this->scopes.back()[*variable] = {variableType};
+
+        this->block(body);
+        this->scopes.pop_back();
+
+        for (auto &environment: continues)
+            join(this->scopes, environment);
+
+        join(this->scopes, head);
+
+        if (this->scopes == head)
+            break;
+    }
+
+    // After the loop the condition was false, or a break left it
+    if (condition != nullptr)
+        this->expression(condition);
+
+    for (auto &environment: breaks)
+        join(this->scopes, environment);
+
+    this->breaks = outerBreaks;
+    this->continues = outerContinues;
+    this->loopDepth = outerDepth;
+}
+
+void TypeInference::function(FunctionDefinitionNode *node) {
+    auto outerScopes = std::move(this->scopes);
+    auto outerBreaks = this->breaks;
+    auto outerContinues = this->continues;
+    auto outerCalls = this->callsChangeVariables;
+
+    // The variables around the function aren't tracked inside of it, the parameters can be anything
+    // unless they are annotated
+    this->scopes.clear();
+    this->scopes.emplace_back();
+
+    for (size_t i = 0; i < node->parameters.size(); i++)
+        this->scopes.back()[node->parameters[i]] = {node->parameterTypes[i], node->parameterTypes[i]};
+
+    // Outside of the function the local variables can't be seen, so calls can't change them
+    this->scopes.emplace_back();
+    this->breaks = nullptr;
+    this->continues = nullptr;
+    this->callsChangeVariables = false;
+
+    this->block(node->body);
+
+    this->scopes = std::move(outerScopes);
+    this->breaks = outerBreaks;
+    this->continues = outerContinues;
+    this->callsChangeVariables = outerCalls;
+}
+
+bool TypeInference::unboxable(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "IntegerLiteral")
+        return dynamic_cast<IntegerLiteralNode *>(node)->digits.empty();
+
+    if (identifier == "FloatLiteral" || identifier == "VariableReference" || identifier == "Invariant")
+        return true;
+
+    if (identifier == "InlinedCall")
+        return unboxable(dynamic_cast<InlinedCallNode *>(node)->body.get());
+
+    if (identifier == "Unary") {
+        auto realNode = dynamic_cast<UnaryExpressionNode *>(node);
+
+        return realNode->op == "-" && unboxable(realNode->child.get());
+    }
+
+    return identifier == "Expression" && dynamic_cast<ExpressionNode *>(node)->unboxed != StaticType::UNKNOWN;
+}
+
+StaticType TypeInference::expression(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "IntegerLiteral") {
+        // Literals too large for 64 bits are big integers
+        return dynamic_cast<IntegerLiteralNode *>(node)->digits.empty() ? StaticType::INT : StaticType::UNKNOWN;
+    } else if (identifier == "FloatLiteral") {
+        return StaticType::FLOAT;
+    } else if (identifier == "StringLiteral") {
+        return StaticType::STRING;
+    } else if (identifier == "VariableReference") {
+        return this->lookup(dynamic_cast<VariableReferenceNode *>(node)->name);
+    } else if (identifier == "Unary") {
+        auto realNode = dynamic_cast<UnaryExpressionNode *>(node);
+        auto type = this->expression(realNode->child.get());
+
+        if (realNode->op != "-")
+            return type;
+
+        return type == StaticType::INT || type == StaticType::FLOAT ? type : StaticType::UNKNOWN;
+    } else if (identifier == "Expression") {
+        auto realNode = dynamic_cast<ExpressionNode *>(node);
+        auto left = this->expression(realNode->left.get());
+        auto right = this->expression(realNode->right.get());
+
+        realNode->operands = left == right && (left == StaticType::INT || left == StaticType::FLOAT)
+                             ? left : StaticType::UNKNOWN;
+        realNode->unboxed = StaticType::UNKNOWN;
+
+        // Float comparisons give ints, floats have no other operators than the arithmetic ones
+        if (unboxable(realNode->left.get()) && unboxable(realNode->right.get())) {
+            if (realNode->operands == StaticType::INT && realNode->opcode != Operator::UNKNOWN)
+                realNode->unboxed = StaticType::INT;
+            else if (realNode->operands == StaticType::FLOAT && isComparison(realNode->opcode))
+                realNode->unboxed = StaticType::INT;
+            else if (realNode->operands == StaticType::FLOAT && (realNode->opcode == Operator::ADD ||
+                                                                 realNode->opcode == Operator::SUBTRACT ||
+                                                                 realNode->opcode == Operator::MULTIPLY ||
+                                                                 realNode->opcode == Operator::DIVIDE))
+                realNode->unboxed = StaticType::FLOAT;
+        }
+
+        switch (realNode->opcode) {
+            // Comparisons always give 0 or 1
+            case Operator::EQUAL:
+            case Operator::NOT_EQUAL:
+            case Operator::LESS:
+            case Operator::GREATER:
+            case Operator::LESS_EQUAL:
+            case Operator::GREATER_EQUAL:
+            case Operator::AND:
+            case Operator::OR:
+                return StaticType::INT;
+            case Operator::ADD:
+                // Anything known added to a string is a string
+                if ((left == StaticType::STRING && right != StaticType::UNKNOWN) ||
+                    (right == StaticType::STRING && left != StaticType::UNKNOWN))
+                    return StaticType::STRING;
+
+                [[fallthrough]];
+            case Operator::SUBTRACT:
+            case Operator::MULTIPLY:
+            case Operator::DIVIDE:
+                return realNode->operands;
+            case Operator::MODULO:
+                return realNode->operands == StaticType::INT ? StaticType::INT : StaticType::UNKNOWN;
+            default:
+                return StaticType::UNKNOWN;
+        }
+    } else if (identifier == "FunctionCall") {
+        auto realNode = dynamic_cast<FunctionCallNode *>(node);
+
+        for (auto &argument: realNode->args)
+            this->expression(argument.get());
+
+        if (this->callsChangeVariables)
+            this->forgetAll();
+
+        auto function = this->userFunctions.find(realNode->name);
+
+        // The interpreter checks the results of annotated functions
+        if (function != this->userFunctions.end())
+            return function->second;
+
+        if (realNode->name == Symbol("len"))
+            return StaticType::INT;
+
+        return StaticType::UNKNOWN;
+    } else if (identifier == "InlinedCall") {
+        auto realNode = dynamic_cast<InlinedCallNode *>(node);
+
+        // The call is only made if the function was replaced, e.g. by an import
+        for (auto &argument: realNode->call->args)
+            this->expression(argument.get());
+
+        return this->expression(realNode->body.get());
+    } else if (identifier == "Invariant") {
+        return this->expression(dynamic_cast<InvariantNode *>(node)->value.get());
+    } else if (identifier == "MethodCall") {
+        auto realNode = dynamic_cast<MethodCallNode *>(node);
+
+        this->expression(realNode->object.get());
+
+        for (auto &argument: realNode->args)
+            this->expression(argument.get());
+
+        if (this->callsChangeVariables)
+            this->forgetAll();
+    } else if (identifier == "MemberAccess") {
+        this->expression(dynamic_cast<MemberAccessNode *>(node)->object.get());
+    } else if (identifier == "ArrayAccess") {
+        auto realNode = dynamic_cast<ArrayAccessNode *>(node);
+
+        this->expression(realNode->array.get());
+        this->expression(realNode->index.get());
+    } else if (identifier == "Array") {
+        for (auto &element: dynamic_cast<ArrayNode *>(node)->elements)
+            this->expression(element.get());
+    } else if (identifier == "Map") {
+        for (auto &[key, value]: dynamic_cast<MapNode *>(node)->entries) {
+            this->expression(key.get());
+            this->expression(value.get());
+        }
+    }
+
+    return StaticType::UNKNOWN;
+}
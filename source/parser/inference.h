@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_INFERENCE_H
+#define ACL_INFERENCE_H
+
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+
+// Flow-sensitive type inference over a parsed file. It follows the types of the variables a
+// function (or the file) defines through assignments, branches and loops, and marks binary
+// expressions whose operands are always ints or always floats, so the interpreter can apply
+// the operator directly instead of dispatching on the types.
+//
+// Int results are assumed to stay ints. The rare result which overflows into a big integer
+// fails the tag check the interpreter does before using the int operators, and takes the
+// generic path.
+class TypeInference {
+public:
+    void inferTypes(AbstractSyntaxTree *ast);
+
+private:
+    // What is known about a tracked variable. The interpreter checks every value assigned to an
+    // annotated variable, so those always have their annotated type.
+    struct VariableType {
+        StaticType type = StaticType::UNKNOWN;
+        StaticType annotation = StaticType::UNKNOWN;
+
+        bool operator==(const VariableType &) const = default;
+    };
+
+    // Types of the tracked variables, one map per scope, innermost last
+    using Environment = std::vector<std::unordered_map<Symbol, VariableType>>;
+
+    Environment scopes;
+
+    // Environments at the break and continue statements of the innermost loop, and the number of
+    // scopes outside of it
+    std::vector<Environment> *breaks = nullptr;
+    std::vector<Environment> *continues = nullptr;
+    size_t loopDepth = 0;
+
+    // Whether calls can change the tracked variables. Functions can assign to the variables of
+    // the file and to those of functions they are defined in.
+    bool callsChangeVariables = true;
+
+    // Functions defined in the file and their annotated result types. They can replace builtins like len().
+    std::unordered_map<Symbol, StaticType> userFunctions;
+
+    static StaticType join(StaticType a, StaticType b);
+
+    // Joining the types of another environment with the same scopes into an environment
+    static void join(Environment &into, const Environment &other);
+
+    StaticType lookup(const Symbol &name);
+
+    void assign(const Symbol &name, StaticType type);
+
+    // Forgetting the types of all variables, after a call which may have changed them
+    void forgetAll();
+
+    void block(std::vector<std::unique_ptr<AstChild>> &body);
+
+    void scopedBlock(std::vector<std::unique_ptr<AstChild>> &body);
+
+    void statement(AstChild *node);
+
+    // Running the body until the types at the start of an iteration don't change anymore
+    void loop(AstChild *condition, std::vector<std::unique_ptr<AstChild>> &body, const Symbol *variable,
+              StaticType variableType);
+
+    void function(FunctionDefinitionNode *node);
+
+    StaticType expression(AstChild *node);
+
+    // Whether the interpreter can evaluate a node without boxing its value: literals, variables and
+    // expressions made of those
+    static bool unboxable(AstChild *node);
+
+    void collectFunctions(std::vector<AstChild *> &children);
+};
+
+#endif //ACL_INFERENCE_H
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "optimizer.h"
+#include "../interpreter/functions.h"
+
+// Bodies of inlined functions are copied into every call, so only small ones are inlined
+const int MAX_INLINED_NODES = 32;
+
+// Arguments used more than once in the body of an inlined function are evaluated every time
+const int MAX_REPEATED_NODES = 5;
+
+void Optimizer::optimize(AbstractSyntaxTree *ast) {
+    std::unordered_map<Symbol, int> definitions;
+
+    for (auto child: ast->children)
+        this->collectDefinitions(child, definitions);
+
+    // Functions defined more than once (or in another function) could be replaced at runtime. Calls in
+    // a function are inlined first, so functions only calling inlinable functions become inlinable too.
+    for (auto child: ast->children) {
+        if (child->getIdentifier() != "FunctionDefinition")
+            continue;
+
+        auto function = dynamic_cast<FunctionDefinitionNode *>(child);
+
+        this->inlineCalls(function);
+
+        if (definitions[function->name] == 1 && this->canInline(function))
+            this->inlinable[function->name] = function;
+    }
+
+    for (auto child: ast->children)
+        this->inlineCalls(child);
+
+    for (auto child: ast->children)
+        this->hoistInvariants(child);
+}
+
+void Optimizer::forEachChild(AstChild *node, const std::function<void(std::unique_ptr<AstChild> &, bool)> &visit) {
+    const auto identifier = node->getIdentifier();
+
+    auto body = [&visit](std::vector<std::unique_ptr<AstChild>> &statements) {
+        for (auto &statement: statements)
+            visit(statement, true);
+    };
+
+    if (identifier == "Expression") {
+        auto realNode = dynamic_cast<ExpressionNode *>(node);
+
+        visit(realNode->left, false);
+        visit(realNode->right, false);
+    } else if (identifier == "Unary") {
+        visit(dynamic_cast<UnaryExpressionNode *>(node)->child, false);
+    } else if (identifier == "VariableDefinition") {
+        visit(dynamic_cast<VariableDefinitionNode *>(node)->value, false);
+    } else if (identifier == "VariableAssignment") {
+        auto realNode = dynamic_cast<VariableAssignmentNode *>(node);
+
+        for (auto &index: realNode->indices)
+            visit(index, false);
+
+        visit(realNode->value, false);
+    } else if (identifier == "FunctionCall") {
+        for (auto &argument: dynamic_cast<FunctionCallNode *>(node)->args)
+            visit(argument, false);
+    } else if (identifier == "IfStatement") {
+        auto realNode = dynamic_cast<IfStatementNode *>(node);
+
+        visit(realNode->condition, false);
+        body(realNode->thenBranch);
+        body(realNode->elseBranch);
+    } else if (identifier == "WhileStatement") {
+        auto realNode = dynamic_cast<WhileStatementNode *>(node);
+
+        visit(realNode->condition, false);
+        body(realNode->body);
+    } else if (identifier == "ForStatement") {
+        auto realNode = dynamic_cast<ForStatementNode *>(node);
+
+        visit(realNode->location, false);
+        body(realNode->body);
+    } else if (identifier == "FunctionDefinition") {
+        body(dynamic_cast<FunctionDefinitionNode *>(node)->body);
+    } else if (identifier == "ReturnStatement") {
+        auto realNode = dynamic_cast<ReturnStatementNode *>(node);
+
+        if (realNode->value != nullptr)
+            visit(realNode->value, false);
+    } else if (identifier == "Array") {
+        for (auto &element: dynamic_cast<ArrayNode *>(node)->elements)
+            visit(element, false);
+    } else if (identifier == "ArrayAccess") {
+        auto realNode = dynamic_cast<ArrayAccessNode *>(node);
+
+        visit(realNode->array, false);
+        visit(realNode->index, false);
+    } else if (identifier == "Map") {
+        for (auto &[key, value]: dynamic_cast<MapNode *>(node)->entries) {
+            visit(key, false);
+            visit(value, false);
+        }
+    } else if (identifier == "SwitchStatement") {
+        auto realNode = dynamic_cast<SwitchStatementNode *>(node);
+
+        visit(realNode->condition, false);
+
+        for (auto &caseNode: realNode->cases) {
+            if (caseNode->condition != nullptr)
+                visit(caseNode->condition, false);
+
+            body(caseNode->body);
+        }
+    } else if (identifier == "ClassDefinition") {
+        body(dynamic_cast<ClassDefinitionNode *>(node)->body);
+    } else if (identifier == "MemberAccess") {
+        visit(dynamic_cast<MemberAccessNode *>(node)->object, false);
+    } else if (identifier == "MemberAssignment") {
+        auto realNode = dynamic_cast<MemberAssignmentNode *>(node);
+
+        visit(realNode->object, false);
+        visit(realNode->value, false);
+    } else if (identifier == "MethodCall") {
+        auto realNode = dynamic_cast<MethodCallNode *>(node);
+
+        visit(realNode->object, false);
+
+        for (auto &argument: realNode->args)
+            visit(argument, false);
+    } else if (identifier == "InlinedCall") {
+        // The arguments of the call are copied into the body, so the body is all there is to visit
+        visit(dynamic_cast<InlinedCallNode *>(node)->body, false);
+    } else if (identifier == "Invariant") {
+        visit(dynamic_cast<InvariantNode *>(node)->value, false);
+    }
+}
+
+int Optimizer::countNodes(AstChild *node) {
+    auto count = 1;
+
+    forEachChild(node, [&count](std::unique_ptr<AstChild> &child, bool) {
+        count += countNodes(child.get());
+    });
+
+    return count;
+}
+
+bool Optimizer::isPureBuiltin(const Symbol &name) const {
+    return function_is_pure(name) && !this->definedNames.contains(name);
+}
+
+void Optimizer::collectDefinitions(AstChild *node, std::unordered_map<Symbol, int> &definitions) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "FunctionDefinition") {
+        auto function = dynamic_cast<FunctionDefinitionNode *>(node);
+
+        // External functions are how the builtins are declared
+        definitions[function->name]++;
+
+        if (!function->isExternal)
+            this->definedNames.insert(function->name);
+    } else if (identifier == "ClassDefinition") {
+        this->definedNames.insert(dynamic_cast<ClassDefinitionNode *>(node)->name);
+    }
+
+    forEachChild(node, [this, &definitions](std::unique_ptr<AstChild> &child, bool) {
+        this->collectDefinitions(child.get(), definitions);
+    });
+}
+
+bool Optimizer::canInline(FunctionDefinitionNode *function) {
+    if (function->isExternal || function->memoized || function->body.size() != 1 ||
+        function->body[0]->getIdentifier() != "ReturnStatement")
+        return false;
+
+    // Annotated functions check their arguments and result, the inlined body wouldn't
+    if (function->returnType != StaticType::UNKNOWN)
+        return false;
+
+    for (auto type: function->parameterTypes)
+        if (type != StaticType::UNKNOWN)
+            return false;
+
+    auto parameters = std::unordered_set<Symbol>(function->parameters.begin(), function->parameters.end());
+
+    if (parameters.size() != function->parameters.size())
+        return false;
+
+    auto value = dynamic_cast<ReturnStatementNode *>(function->body[0].get())->value.get();
+
+    // Using only the parameters, the body means the same wherever it is copied to. Without calls of
+    // user functions (other than inlined ones) the function can't be recursive.
+    return value != nullptr && countNodes(value) <= MAX_INLINED_NODES && this->usesOnly(value, function->parameters);
+}
+
+bool Optimizer::usesOnly(AstChild *node, const std::vector<Symbol> &parameters) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "IntegerLiteral" || identifier == "FloatLiteral" || identifier == "StringLiteral")
+        return true;
+
+    if (identifier == "VariableReference") {
+        auto name = dynamic_cast<VariableReferenceNode *>(node)->name;
+
+        return std::find(parameters.begin(), parameters.end(), name) != parameters.end();
+    }
+
+    if (identifier == "FunctionCall" && !this->isPureBuiltin(dynamic_cast<FunctionCallNode *>(node)->name))
+        return false;
+
+    if (identifier != "Expression" && identifier != "Unary" && identifier != "ArrayAccess" &&
+        identifier != "MemberAccess" && identifier != "FunctionCall" && identifier != "InlinedCall")
+        return false;
+
+    auto result = true;
+
+    forEachChild(node, [this, &parameters, &result](std::unique_ptr<AstChild> &child, bool) {
+        result = result && this->usesOnly(child.get(), parameters);
+    });
+
+    return result;
+}
+
+bool Optimizer::isPure(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "IntegerLiteral" || identifier == "FloatLiteral" || identifier == "StringLiteral" ||
+        identifier == "VariableReference")
+        return true;
+
+    if (identifier == "FunctionCall" && !this->isPureBuiltin(dynamic_cast<FunctionCallNode *>(node)->name))
+        return false;
+
+    if (identifier != "Expression" && identifier != "Unary" && identifier != "ArrayAccess" &&
+        identifier != "MemberAccess" && identifier != "FunctionCall" && identifier != "InlinedCall")
+        return false;
+
+    auto result = true;
+
+    forEachChild(node, [this, &result](std::unique_ptr<AstChild> &child, bool) {
+        result = result && this->isPure(child.get());
+    });
+
+    return result;
+}
+
+bool Optimizer::isCheap(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier != "IntegerLiteral" && identifier != "FloatLiteral" && identifier != "StringLiteral" &&
+        identifier != "VariableReference" && identifier != "Expression" && identifier != "Unary")
+        return false;
+
+    auto result = countNodes(node) <= MAX_REPEATED_NODES;
+
+    forEachChild(node, [&result](std::unique_ptr<AstChild> &child, bool) {
+        result = result && isCheap(child.get());
+    });
+
+    return result;
+}
+
+std::unique_ptr<AstChild> Optimizer::clone(AstChild *node, const std::unordered_map<Symbol, AstChild *> &arguments) {
+    const auto identifier = node->getIdentifier();
+    std::unique_ptr<AstChild> copy;
+
+    if (identifier == "IntegerLiteral") {
+        auto realNode = dynamic_cast<IntegerLiteralNode *>(node);
+        auto literal = std::make_unique<IntegerLiteralNode>(realNode->value);
+
+        literal->digits = realNode->digits;
+        copy = std::move(literal);
+    } else if (identifier == "FloatLiteral") {
+        copy = std::make_unique<FloatLiteralNode>(dynamic_cast<FloatLiteralNode *>(node)->value);
+    } else if (identifier == "StringLiteral") {
+        copy = std::make_unique<StringLiteralNode>(dynamic_cast<StringLiteralNode *>(node)->value.str());
+    } else if (identifier == "VariableReference") {
+        auto name = dynamic_cast<VariableReferenceNode *>(node)->name;
+        auto argument = arguments.find(name);
+
+        if (argument != arguments.end())
+            return clone(argument->second, {});
+
+        copy = std::make_unique<VariableReferenceNode>(name);
+    } else if (identifier == "Expression") {
+        auto realNode = dynamic_cast<ExpressionNode *>(node);
+
+        copy = std::make_unique<ExpressionNode>(clone(realNode->left.get(), arguments),
+                                                clone(realNode->right.get(), arguments), realNode->op);
+    } else if (identifier == "Unary") {
+        auto realNode = dynamic_cast<UnaryExpressionNode *>(node);
+
+        copy = std::make_unique<UnaryExpressionNode>(clone(realNode->child.get(), arguments), realNode->op);
+    } else if (identifier == "FunctionCall") {
+        auto realNode = dynamic_cast<FunctionCallNode *>(node);
+        std::vector<std::unique_ptr<AstChild>> args;
+
+        for (auto &argument: realNode->args)
+            args.push_back(clone(argument.get(), arguments));
+
+        copy = std::make_unique<FunctionCallNode>(realNode->name, std::move(args));
+    } else if (identifier == "ArrayAccess") {
+        auto realNode = dynamic_cast<ArrayAccessNode *>(node);
+
+        copy = std::make_unique<ArrayAccessNode>(clone(realNode->array.get(), arguments),
+                                                 clone(realNode->index.get(), arguments));
+    } else if (identifier == "MemberAccess") {
+        auto realNode = dynamic_cast<MemberAccessNode *>(node);
+
+        copy = std::make_unique<MemberAccessNode>(clone(realNode->object.get(), arguments), realNode->name);
+    } else if (identifier == "InlinedCall") {
+        auto realNode = dynamic_cast<InlinedCallNode *>(node);
+        auto call = clone(realNode->call.get(), arguments);
+
+        copy = std::make_unique<InlinedCallNode>(
+                std::unique_ptr<FunctionCallNode>(dynamic_cast<FunctionCallNode *>(call.release())),
+                clone(realNode->body.get(), arguments), realNode->function);
+    } else {
+        throw std::runtime_error("Cannot copy " + identifier);
+    }
+
+    copy->line = node->line;
+
+    return copy;
+}
+
+void Optimizer::countUses(AstChild *node, std::unordered_map<Symbol, int> &uses) {
+    if (node->getIdentifier() == "VariableReference")
+        uses[dynamic_cast<VariableReferenceNode *>(node)->name]++;
+
+    forEachChild(node, [&uses](std::unique_ptr<AstChild> &child, bool) {
+        countUses(child.get(), uses);
+    });
+}
+
+void Optimizer::inlineCalls(AstChild *node) {
+    forEachChild(node, [this](std::unique_ptr<AstChild> &child, bool statement) {
+        this->inlineCalls(child.get());
+
+        // Calls whose result isn't used aren't worth it
+        if (!statement && child->getIdentifier() == "FunctionCall")
+            this->inlineCall(child);
+    });
+
+    // `return f(x)` isn't a tail call anymore once f is inlined
+    if (node->getIdentifier() == "ReturnStatement") {
+        auto realNode = dynamic_cast<ReturnStatementNode *>(node);
+
+        realNode->tailCall = realNode->tailCall && realNode->value->getIdentifier() == "FunctionCall";
+    }
+}
+
+void Optimizer::inlineCall(std::unique_ptr<AstChild> &slot) {
+    auto call = dynamic_cast<FunctionCallNode *>(slot.get());
+    auto found = this->inlinable.find(call->name);
+
+    if (found == this->inlinable.end())
+        return;
+
+    auto function = found->second;
+
+    if (function->parameters.size() != call->args.size())
+        return;
+
+    auto value = dynamic_cast<ReturnStatementNode *>(function->body[0].get())->value.get();
+    std::unordered_map<Symbol, int> uses;
+    std::unordered_map<Symbol, AstChild *> arguments;
+
+    countUses(value, uses);
+
+    // The arguments are evaluated where the parameters are used, so they may be evaluated more or
+    // less often. Only arguments where that makes no difference can be put in place of a parameter,
+    // and only cheap ones are evaluated more than once.
+    for (size_t i = 0; i < call->args.size(); i++) {
+        auto argument = call->args[i].get();
+        auto count = uses[function->parameters[i]];
+        auto identifier = argument->getIdentifier();
+        auto literal = identifier == "IntegerLiteral" || identifier == "FloatLiteral" || identifier == "StringLiteral";
+
+        if (!this->isPure(argument) || (count == 0 && !literal) || (count > 1 && !isCheap(argument)))
+            return;
+
+        arguments[function->parameters[i]] = argument;
+    }
+
+    auto body = clone(value, arguments);
+    auto line = call->line;
+
+    slot.release();
+    slot = std::make_unique<InlinedCallNode>(std::unique_ptr<FunctionCallNode>(call), std::move(body), function);
+    slot->line = line;
+}
+
+void Optimizer::hoistInvariants(AstChild *node) {
+    const auto identifier = node->getIdentifier();
+
+    auto visit = [this](std::unique_ptr<AstChild> &child, bool statement) {
+        this->hoistInvariants(child, statement);
+    };
+
+    if (identifier == "WhileStatement" || identifier == "ForStatement") {
+        Loop loop;
+
+        if (identifier == "WhileStatement") {
+            auto realNode = dynamic_cast<WhileStatementNode *>(node);
+
+            loop.invariants = &realNode->invariants;
+            this->summarize(node, loop);
+            this->loops.push_back(std::move(loop));
+
+            forEachChild(node, visit);
+        } else {
+            auto realNode = dynamic_cast<ForStatementNode *>(node);
+
+            // The location is evaluated once before the loop runs
+            this->hoistInvariants(realNode->location, false);
+
+            loop.invariants = &realNode->invariants;
+            loop.written.insert(realNode->initializer);
+
+            for (auto &statement: realNode->body)
+                this->summarize(statement.get(), loop);
+
+            this->loops.push_back(std::move(loop));
+
+            for (auto &statement: realNode->body)
+                this->hoistInvariants(statement, true);
+        }
+
+        this->loops.pop_back();
+    } else if (identifier == "FunctionDefinition" || identifier == "ClassDefinition") {
+        // Functions run when they are called, not in the iterations of the loops around their definition
+        auto outerLoops = std::move(this->loops);
+
+        this->loops.clear();
+        forEachChild(node, visit);
+        this->loops = std::move(outerLoops);
+    } else {
+        forEachChild(node, visit);
+    }
+
+    if (identifier == "ReturnStatement") {
+        auto realNode = dynamic_cast<ReturnStatementNode *>(node);
+
+        realNode->tailCall = realNode->tailCall && realNode->value->getIdentifier() == "FunctionCall";
+    }
+}
+
+void Optimizer::hoistInvariants(std::unique_ptr<AstChild> &slot, bool statement) {
+    if (!statement && !this->loops.empty() && slot->getIdentifier() == "FunctionCall" &&
+        this->isPureBuiltin(dynamic_cast<FunctionCallNode *>(slot.get())->name)) {
+        std::unordered_set<Symbol> reads;
+        std::vector<Symbol> builtins;
+
+        if (this->readsOnly(slot.get(), reads, builtins)) {
+            // The outermost loop which changes none of the variables. Loops inside of it change even less.
+            for (auto &loop: this->loops) {
+                auto changed = loop.effects;
+
+                for (auto &name: reads)
+                    changed = changed || loop.written.contains(name);
+
+                if (changed)
+                    continue;
+
+                auto invariant = std::make_unique<InvariantNode>(std::move(slot));
+                invariant->builtins = std::move(builtins);
+
+                loop.invariants->push_back(invariant.get());
+                slot = std::move(invariant);
+                return;
+            }
+        }
+    }
+
+    this->hoistInvariants(slot.get());
+}
+
+bool Optimizer::readsOnly(AstChild *node, std::unordered_set<Symbol> &reads, std::vector<Symbol> &builtins) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "IntegerLiteral" || identifier == "FloatLiteral" || identifier == "StringLiteral")
+        return true;
+
+    if (identifier == "VariableReference") {
+        reads.insert(dynamic_cast<VariableReferenceNode *>(node)->name);
+        return true;
+    }
+
+    if (identifier == "FunctionCall") {
+        auto name = dynamic_cast<FunctionCallNode *>(node)->name;
+
+        if (!this->isPureBuiltin(name))
+            return false;
+
+        builtins.push_back(name);
+    } else if (identifier != "Expression" && identifier != "Unary" && identifier != "ArrayAccess" &&
+               identifier != "MemberAccess" && identifier != "Array" && identifier != "Map") {
+        return false;
+    }
+
+    auto result = true;
+
+    forEachChild(node, [this, &reads, &builtins, &result](std::unique_ptr<AstChild> &child, bool) {
+        result = result && this->readsOnly(child.get(), reads, builtins);
+    });
+
+    return result;
+}
+
+void Optimizer::summarize(AstChild *node, Loop &loop) {
+    const auto identifier = node->getIdentifier();
+
+    if (identifier == "VariableDefinition") {
+        loop.written.insert(dynamic_cast<VariableDefinitionNode *>(node)->name);
+    } else if (identifier == "VariableAssignment") {
+        auto realNode = dynamic_cast<VariableAssignmentNode *>(node);
+
+        loop.written.insert(realNode->name);
+
+        // Maps and arrays are shared, an element can be changed through any variable referencing them
+        if (!realNode->indices.empty())
+            loop.effects = true;
+    } else if (identifier == "ForStatement") {
+        loop.written.insert(dynamic_cast<ForStatementNode *>(node)->initializer);
+    } else if (identifier == "FunctionCall") {
+        auto name = dynamic_cast<FunctionCallNode *>(node)->name;
+
+        // Builtins without side effects, or with side effects the program can't see (e.g. printing)
+        if (this->definedNames.contains(name) || !function_exists(name) || function_changes_arguments(name))
+            loop.effects = true;
+    } else if (identifier == "MethodCall" || identifier == "MemberAssignment" || identifier == "FunctionDefinition" ||
+               identifier == "ClassDefinition" || identifier == "ImportStatement") {
+        loop.effects = true;
+    }
+
+    forEachChild(node, [this, &loop](std::unique_ptr<AstChild> &child, bool) {
+        this->summarize(child.get(), loop);
+    });
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_OPTIMIZER_H
+#define ACL_OPTIMIZER_H
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ast.h"
+
+// Rewriting a parsed file before it runs:
+//
+// - Calls of small functions, whose body is a single return of an expression over their parameters,
+//   are replaced by that expression. The call doesn't create a scope and doesn't bind parameters.
+// - Calls of pure builtins (e.g. len()) in a loop, whose arguments don't change while the loop runs,
+//   are evaluated once per run of the loop instead of once per iteration.
+//
+// Both rely on knowing which builtins have side effects, see function_is_pure().
+class Optimizer {
+public:
+    void optimize(AbstractSyntaxTree *ast);
+
+    // Calling visit for every child of a node, with whether the child is a statement of a body
+    static void forEachChild(AstChild *node, const std::function<void(std::unique_ptr<AstChild> &, bool)> &visit);
+
+private:
+    // What a loop changes while it runs
+    struct Loop {
+        // Variables the loop defines or assigns to, in its body or in loops inside of it
+        std::unordered_set<Symbol> written;
+
+        // Whether the loop calls user functions or methods, or changes lists in place, maps, fields or elements
+        bool effects = false;
+
+        std::vector<InvariantNode *> *invariants;
+    };
+
+    // Names of all functions and classes defined in the file, calling them doesn't call a builtin
+    std::unordered_set<Symbol> definedNames;
+
+    // Functions whose calls are replaced by their bodies
+    std::unordered_map<Symbol, FunctionDefinitionNode *> inlinable;
+
+    // Loops around the node being optimized, outermost first
+    std::vector<Loop> loops;
+
+    static int countNodes(AstChild *node);
+
+    [[nodiscard]] bool isPureBuiltin(const Symbol &name) const;
+
+    void collectDefinitions(AstChild *node, std::unordered_map<Symbol, int> &definitions);
+
+    bool canInline(FunctionDefinitionNode *function);
+
+    // Whether an expression only uses the given parameters, literals, operators, pure builtins and inlined calls
+    bool usesOnly(AstChild *node, const std::vector<Symbol> &parameters);
+
+    // Whether evaluating an expression can't change anything, so it can be evaluated more or less often
+    bool isPure(AstChild *node);
+
+    // Whether an expression is just a few operators on variables and literals, evaluating it again costs
+    // less than binding it to a parameter
+    static bool isCheap(AstChild *node);
+
+    // Copying an expression, with the parameters replaced by copies of the arguments
+    static std::unique_ptr<AstChild> clone(AstChild *node, const std::unordered_map<Symbol, AstChild *> &arguments);
+
+    static void countUses(AstChild *node, std::unordered_map<Symbol, int> &uses);
+
+    void inlineCalls(AstChild *node);
+
+    void inlineCall(std::unique_ptr<AstChild> &slot);
+
+    void hoistInvariants(AstChild *node);
+
+    void hoistInvariants(std::unique_ptr<AstChild> &slot, bool statement);
+
+    // Whether an expression is pure and only reads variables, collecting them and the builtins it calls
+    bool readsOnly(AstChild *node, std::unordered_set<Symbol> &reads, std::vector<Symbol> &builtins);
+
+    // Collecting what a loop changes
+    void summarize(AstChild *node, Loop &loop);
+};
+
+#endif //ACL_OPTIMIZER_H
@@ -15,6 +15,8 @@
  */
 
 #include "parser.h"
+#include "optimizer.h"
+#include "../interpreter/functions.h"
 #include <memory>
 
 std::unique_ptr<AstChild> Parser::importStatement() {
@@ -34,21 +36,47 @@ std::unique_ptr<AstChild> Parser::returnStatement() {
 
     if (currentToken.type == Token::Type::INT || currentToken.type == Token::Type::FLOAT ||
         currentToken.type == Token::Type::STRING || currentToken.type == Token::Type::IDENTIFIER ||
-        currentToken.type == Token::Type::LEFT_PAREN) {
-        return std::make_unique<ReturnStatementNode>(this->expression());
+        currentToken.type == Token::Type::LEFT_PAREN || currentToken.type == Token::Type::LEFT_BRACE ||
+        currentToken.type == Token::Type::LEFT_BRACKET ||
+        (currentToken.type == Token::Type::OPERATOR && (currentToken.raw == "-" || currentToken.raw == "+"))) {
+        auto node = std::make_unique<ReturnStatementNode>(this->expression());
+        node->tailCall = node->value->getIdentifier() == "FunctionCall";
+
+        return node;
     }
 
     return std::make_unique<ReturnStatementNode>();
 }
 
+// Memoized functions can't have side effects, their results are cached. Calls of other functions doing
+// I/O are only noticed when they run.
+static void checkMemoizedBody(const std::string &function, AstChild *node) {
+    if (node->getIdentifier() == "FunctionCall") {
+        auto call = dynamic_cast<FunctionCallNode *>(node);
+
+        if (function_performs_io(call->name))
+            throw std::runtime_error(call->name + "() can't be called in memoized function " + function +
+                                     ", its result would be cached, line: " + std::to_string(call->line + 1));
+    }
+
+    Optimizer::forEachChild(node, [&function](std::unique_ptr<AstChild> &child, bool) {
+        checkMemoizedBody(function, child.get());
+    });
+}
 
 std::unique_ptr<AstChild> Parser::functionDefinition() {
     auto isExternal = this->tokens[this->currentTokenIndex].raw == "external";
+    auto isMemoized = this->tokens[this->currentTokenIndex].raw == "memo";
 
     this->currentTokenIndex++;
 
-    if (isExternal)
+    if (isExternal || isMemoized) {
+        if (this->tokens[this->currentTokenIndex].raw != "func")
+            throw std::runtime_error("Expected func after " + this->tokens[this->currentTokenIndex - 1].raw +
+                                     ", line: " + std::to_string(this->tokens[this->currentTokenIndex].line + 1));
+
         this->currentTokenIndex++;
+    }
 
     auto functionName = this->tokens[this->currentTokenIndex].raw;
 
@@ -56,7 +84,8 @@ std::unique_ptr<AstChild> Parser::functionDefinition() {
 
     this->expect(Token::Type::LEFT_PAREN);
 
-    std::vector<std::string> parameters;
+    std::vector<Symbol> parameters;
+    std::vector<StaticType> parameterTypes;
     std::vector<std::unique_ptr<AstChild>> body;
 
     while (this->currentTokenIndex < this->tokens.size() &&
@@ -71,6 +100,13 @@ std::unique_ptr<AstChild> Parser::functionDefinition() {
 
         this->currentTokenIndex++;
 
+        // `name: type`
+        if (this->currentTokenIndex < this->tokens.size() &&
+            this->tokens[this->currentTokenIndex].type == Token::Type::COLON) {
+            this->currentTokenIndex++;
+            parameterTypes.push_back(this->typeAnnotation());
+        } else parameterTypes.push_back(StaticType::UNKNOWN);
+
         if (this->currentTokenIndex != this->tokens.size())
             if (this->tokens[this->currentTokenIndex].type != Token::Type::RIGHT_PAREN)
                 this->expect(Token::Type::COMMA);
@@ -78,6 +114,14 @@ std::unique_ptr<AstChild> Parser::functionDefinition() {
 
     this->expect(Token::Type::RIGHT_PAREN);
 
+    auto returnType = StaticType::UNKNOWN;
+
+    if (this->currentTokenIndex < this->tokens.size() &&
+        this->tokens[this->currentTokenIndex].type == Token::Type::ARROW) {
+        this->currentTokenIndex++;
+        returnType = this->typeAnnotation();
+    }
+
     if (!isExternal) {
         this->expect(Token::Type::LEFT_BRACE);
 
@@ -93,8 +137,16 @@ std::unique_ptr<AstChild> Parser::functionDefinition() {
         throw std::runtime_error("External functions can't have a body. Line: " +
                                  std::to_string(this->tokens[this->currentTokenIndex].line + 1));
 
-    return std::make_unique<FunctionDefinitionNode>(std::move(functionName), std::move(parameters), std::move(body),
-                                                    isExternal);
+    auto node = std::make_unique<FunctionDefinitionNode>(std::move(functionName), std::move(parameters),
+                                                         std::move(body), isExternal);
+    node->memoized = isMemoized;
+    node->parameterTypes = std::move(parameterTypes);
+    node->returnType = returnType;
+
+    if (isMemoized)
+        checkMemoizedBody(node->name, node.get());
+
+    return node;
 }
 
 std::unique_ptr<AstChild> Parser::forStatement() {
@@ -208,29 +260,66 @@ std::unique_ptr<AstChild> Parser::identifier(bool allowArrayAccess) {
 
         this->currentTokenIndex++;
 
-        return std::make_unique<FunctionCallNode>(currentToken.raw, std::move(arguments));
+        auto call = std::make_unique<FunctionCallNode>(currentToken.raw, std::move(arguments));
+        call->line = currentToken.line;
+
+        return this->checkMemberAccess(std::move(call));
 
         // Variable Assignment
     } else if (this->tokens[this->currentTokenIndex].type == Token::Type::EQUALS) {
         this->currentTokenIndex++;
 
         auto value = this->expression();
+        auto assignment = std::make_unique<VariableAssignmentNode>(currentToken.raw, std::move(value));
+        assignment->line = currentToken.line;
 
-        return std::make_unique<VariableAssignmentNode>(currentToken.raw, std::move(value));
+        return assignment;
     } else if (this->tokens[this->currentTokenIndex].type == Token::Type::LEFT_BRACKET) {
         if (allowArrayAccess) {
             this->currentTokenIndex--;
 
             // The last token has to be the array
             auto array = this->expression(false);
+            auto access = this->checkArrayAccess(std::move(array));
 
-            return this->checkArrayAccess(std::move(array));
+            if (this->currentTokenIndex < this->tokens.size() &&
+                this->tokens[this->currentTokenIndex].type == Token::Type::EQUALS &&
+                access->getIdentifier() == "ArrayAccess")
+                return this->indexAssignment(std::move(access));
+
+            return access;
         }
     }
 
     auto res = std::make_unique<VariableReferenceNode>(currentToken.raw);
     res->line = currentToken.line;
-    return res;
+    return this->checkMemberAccess(std::move(res));
+}
+
+std::unique_ptr<AstChild> Parser::indexAssignment(std::unique_ptr<AstChild> access) {
+    auto line = this->tokens[this->currentTokenIndex].line;
+
+    // Unwrapping `a[i][j]` from the outside in, the innermost node has to be the variable
+    std::vector<std::unique_ptr<AstChild>> indices;
+
+    while (access->getIdentifier() == "ArrayAccess") {
+        auto realNode = dynamic_cast<ArrayAccessNode *>(access.get());
+
+        indices.insert(indices.begin(), std::move(realNode->index));
+        access = std::move(realNode->array);
+    }
+
+    if (access->getIdentifier() != "VariableReference")
+        throw std::runtime_error("Only variables can be assigned by index, line: " + std::to_string(line + 1));
+
+    this->expect(Token::Type::EQUALS);
+
+    auto name = dynamic_cast<VariableReferenceNode *>(access.get())->name;
+    auto node = std::make_unique<VariableAssignmentNode>(name, this->expression());
+    node->indices = std::move(indices);
+    node->line = line;
+
+    return node;
 }
 
 std::unique_ptr<AstChild> Parser::variableDefinition(bool constant) {
@@ -239,24 +328,65 @@ std::unique_ptr<AstChild> Parser::variableDefinition(bool constant) {
     auto variableName = this->tokens[this->currentTokenIndex].raw;
 
     this->expect(Token::Type::IDENTIFIER);
-    this->expect(Token::Type::EQUALS);
 
-    auto node = std::make_unique<VariableDefinitionNode>(variableName, std::move(this->expression()), constant);
-    node->line = this->tokens[this->currentTokenIndex].line;
+    auto type = StaticType::UNKNOWN;
+
+    if (this->currentTokenIndex < this->tokens.size() &&
+        this->tokens[this->currentTokenIndex].type == Token::Type::COLON) {
+        this->currentTokenIndex++;
+        type = this->typeAnnotation();
+    }
+
+    std::unique_ptr<AstChild> value;
+
+    // Annotated variables without a value start out as zero or the empty string
+    if (type != StaticType::UNKNOWN && (this->currentTokenIndex >= this->tokens.size() ||
+                                        this->tokens[this->currentTokenIndex].type != Token::Type::EQUALS)) {
+        if (type == StaticType::INT) value = std::make_unique<IntegerLiteralNode>(0);
+        else if (type == StaticType::FLOAT) value = std::make_unique<FloatLiteralNode>(0.0);
+        else value = std::make_unique<StringLiteralNode>("");
+    } else {
+        this->expect(Token::Type::EQUALS);
+        value = this->expression();
+    }
+
+    auto node = std::make_unique<VariableDefinitionNode>(variableName, std::move(value), constant);
+    node->type = type;
+    node->line = this->tokens[this->currentTokenIndex - 1].line;
     return node;
 }
 
+StaticType Parser::typeAnnotation() {
+    auto token = this->getCurrentToken();
+    auto type = decodeType(token.raw);
+
+    if (token.type != Token::Type::IDENTIFIER || type == StaticType::UNKNOWN)
+        throw std::runtime_error("Unknown type: " + token.raw + ", the types are int, float and string, line: " +
+                                 std::to_string(token.line + 1));
+
+    return type;
+}
+
 std::unique_ptr<AstChild> Parser::factor(bool allowArrayAccess) {
     auto currentToken = this->tokens[this->currentTokenIndex];
 
     switch (currentToken.type) {
         case Token::Type::INT:
             this->currentTokenIndex++;
-            return std::make_unique<IntegerLiteralNode>(std::stoi(currentToken.raw));
+
+            // Literals larger than 64 bits are kept as digits
+            try {
+                return std::make_unique<IntegerLiteralNode>(std::stoll(currentToken.raw));
+            } catch (const std::out_of_range &) {
+                auto literal = std::make_unique<IntegerLiteralNode>(0);
+                literal->digits = currentToken.raw;
+
+                return literal;
+            }
 
         case Token::Type::FLOAT:
             this->currentTokenIndex++;
-            return std::make_unique<FloatLiteralNode>(std::stof(currentToken.raw));
+            return std::make_unique<FloatLiteralNode>(std::stod(currentToken.raw));
 
         case Token::Type::STRING:
             this->currentTokenIndex++;
@@ -304,6 +434,32 @@ std::unique_ptr<AstChild> Parser::factor(bool allowArrayAccess) {
             return checkArrayAccess(std::move(thing));
         }
 
+        case Token::Type::LEFT_BRACE: {
+            // Map literal: {key: value, ...}
+            std::vector<std::pair<std::unique_ptr<AstChild>, std::unique_ptr<AstChild>>> entries;
+
+            this->currentTokenIndex++;
+
+            while (this->currentTokenIndex < this->tokens.size() &&
+                   this->tokens[this->currentTokenIndex].type != Token::Type::RIGHT_BRACE) {
+                auto key = this->expression();
+
+                this->expect(Token::Type::COLON);
+
+                entries.emplace_back(std::move(key), this->expression());
+
+                if (this->tokens[this->currentTokenIndex].type == Token::Type::COMMA)
+                    this->currentTokenIndex++;
+            }
+
+            this->expect(Token::Type::RIGHT_BRACE);
+
+            auto map = std::make_unique<MapNode>(std::move(entries));
+            map->line = currentToken.line;
+
+            return checkArrayAccess(std::move(map));
+        }
+
         default:
             break;
     }
@@ -321,6 +477,7 @@ std::unique_ptr<AstChild> Parser::term(bool allowArrayAccess) {
         this->expect(Token::Type::OPERATOR);
 
         left = std::make_unique<ExpressionNode>(std::move(left), std::move(this->factor(allowArrayAccess)), currentToken.raw);
+        left->line = currentToken.line;
     }
 
     return left;
@@ -353,9 +510,12 @@ std::unique_ptr<AstChild> Parser::expression(bool allowArrayAccess) {
     // && and ||
     if (this->currentTokenIndex < this->tokens.size() &&
         (currentRaw == "||" || currentRaw == "&&")) {
+        auto line = this->tokens[this->currentTokenIndex].line;
+
         this->expect(Token::Type::OPERATOR);
 
         left = std::make_unique<ExpressionNode>(std::move(left), std::move(this->expression()), currentRaw);
+        left->line = line;
     }
 
     return left;
@@ -431,7 +591,8 @@ std::unique_ptr<AstChild> Parser::parseChild() {
             else if (token.raw == "if") result = this->ifStatement();
             else if (token.raw == "while") result = this->whileStatement();
             else if (token.raw == "for") result = this->forStatement();
-            else if (token.raw == "func" || token.raw == "external") result = this->functionDefinition();
+            else if (token.raw == "func" || token.raw == "external" || token.raw == "memo")
+                result = this->functionDefinition();
             else if (token.raw == "return") result = this->returnStatement();
             else if (token.raw == "import") result = this->importStatement();
             else if (token.raw == "switch") result = this->switchStatement();
@@ -472,11 +633,63 @@ std::unique_ptr<AstChild> Parser::checkArrayAccess(std::unique_ptr<AstChild> chi
 
     this->expect(Token::Type::RIGHT_BRACKET);
 
+    auto access = std::make_unique<ArrayAccessNode>(std::move(child), std::move(expr));
+    access->line = token.line;
+
     if (this->tokens[this->currentTokenIndex].type == Token::Type::LEFT_BRACKET) {
-        return this->checkArrayAccess(std::make_unique<ArrayAccessNode>(std::move(child), std::move(expr)));
+        return this->checkArrayAccess(std::move(access));
+    }
+
+    return this->checkMemberAccess(std::move(access));
+}
+
+std::unique_ptr<AstChild> Parser::checkMemberAccess(std::unique_ptr<AstChild> child) {
+    while (this->currentTokenIndex < this->tokens.size() &&
+           this->tokens[this->currentTokenIndex].type == Token::Type::DOT) {
+        this->currentTokenIndex++;
+
+        auto token = this->tokens[this->currentTokenIndex];
+
+        this->expect(Token::Type::IDENTIFIER);
+
+        if (this->currentTokenIndex < this->tokens.size() &&
+            this->tokens[this->currentTokenIndex].type == Token::Type::LEFT_PAREN) {
+            // Method call
+            this->currentTokenIndex++;
+
+            auto arguments = std::vector<std::unique_ptr<AstChild>>();
+
+            while (this->tokens[this->currentTokenIndex].type != Token::Type::RIGHT_PAREN) {
+                arguments.push_back(this->expression());
+
+                if (this->tokens[this->currentTokenIndex].type == Token::Type::COMMA)
+                    this->currentTokenIndex++;
+            }
+
+            this->currentTokenIndex++;
+
+            child = std::make_unique<MethodCallNode>(std::move(child), token.raw, std::move(arguments));
+        } else if (this->currentTokenIndex < this->tokens.size() &&
+                   this->tokens[this->currentTokenIndex].type == Token::Type::EQUALS) {
+            // Member assignment, nothing can follow it
+            this->currentTokenIndex++;
+
+            auto assignment = std::make_unique<MemberAssignmentNode>(std::move(child), token.raw, this->expression());
+            assignment->line = token.line;
+
+            return assignment;
+        } else {
+            child = std::make_unique<MemberAccessNode>(std::move(child), token.raw);
+        }
+
+        child->line = token.line;
+
+        if (this->currentTokenIndex < this->tokens.size() &&
+            this->tokens[this->currentTokenIndex].type == Token::Type::LEFT_BRACKET)
+            return this->checkArrayAccess(std::move(child));
     }
 
-    return std::make_unique<ArrayAccessNode>(std::move(child), std::move(expr));
+    return child;
 }
 
 std::unique_ptr<AstChild> Parser::switchStatement() {
@@ -529,7 +742,7 @@ std::unique_ptr<AstChild> Parser::classDefinition() {
     this->expect(Token::Type::IDENTIFIER);
     this->expect(Token::Type::LEFT_PAREN);
 
-    auto params = std::vector<std::string>();
+    auto params = std::vector<Symbol>();
 
     while (this->tokens[this->currentTokenIndex].type != Token::Type::RIGHT_PAREN) {
         auto token = this->tokens[this->currentTokenIndex];
@@ -37,6 +37,7 @@ class Parser {
      * Statements
      */
     std::unique_ptr<AstChild> variableDefinition(bool constant);
+    std::unique_ptr<AstChild> indexAssignment(std::unique_ptr<AstChild> access);
     std::unique_ptr<AstChild> ifStatement();
     std::unique_ptr<AstChild> whileStatement();
     std::unique_ptr<AstChild> forStatement();
@@ -46,6 +47,11 @@ class Parser {
     std::unique_ptr<AstChild> switchStatement();
     std::unique_ptr<AstChild> classDefinition();
 
+    /**
+     * The type after `:` or `->` in an annotation
+     */
+    StaticType typeAnnotation();
+
     /**
      * Identifier
      */
@@ -56,6 +62,11 @@ class Parser {
      */
     std::unique_ptr<AstChild> checkArrayAccess(std::unique_ptr<AstChild> child);
 
+    /**
+     * Checking for member access, method calls and member assignment
+     */
+    std::unique_ptr<AstChild> checkMemberAccess(std::unique_ptr<AstChild> child);
+
     /**
      * Important functions
      */
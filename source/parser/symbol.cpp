@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "symbol.h"
+#include <memory>
+#include <unordered_map>
+
+// The entries are never freed, so the keys can point into them
+std::unordered_map<std::string_view, std::unique_ptr<Symbol::Entry>> &getSymbolTable() {
+    static std::unordered_map<std::string_view, std::unique_ptr<Symbol::Entry>> table;
+
+    return table;
+}
+
+Symbol::Symbol() : Symbol(std::string_view()) {}
+
+Symbol::Symbol(std::string_view text) {
+    auto &table = getSymbolTable();
+    auto found = table.find(text);
+
+    if (found != table.end()) {
+        this->entry = found->second.get();
+        return;
+    }
+
+    auto entry = std::make_unique<Entry>(Entry{std::string(text), std::hash<std::string_view>()(text)});
+    this->entry = entry.get();
+
+    table.emplace(this->entry->text, std::move(entry));
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_SYMBOL_H
+#define ACL_SYMBOL_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// An interned string, used for identifiers. Every distinct text is stored only once in a
+// global table, together with its hash. Comparing two symbols is a pointer compare.
+class Symbol {
+public:
+    struct Entry {
+        std::string text;
+        size_t hash;
+    };
+
+    // The empty symbol
+    Symbol();
+
+    // Looking up the text in the intern table, and adding it if it isn't there yet
+    Symbol(std::string_view text);
+
+    Symbol(const std::string &text) : Symbol(std::string_view(text)) {}
+
+    Symbol(const char *text) : Symbol(std::string_view(text)) {}
+
+    [[nodiscard]] const std::string &str() const { return this->entry->text; }
+
+    [[nodiscard]] size_t hash() const { return this->entry->hash; }
+
+    [[nodiscard]] size_t size() const { return this->entry->text.size(); }
+
+    operator const std::string &() const { return this->entry->text; }
+
+    bool operator==(const Symbol &other) const { return this->entry == other.entry; }
+
+    bool operator!=(const Symbol &other) const { return this->entry != other.entry; }
+
+private:
+    const Entry *entry;
+};
+
+inline std::string operator+(const std::string &left, const Symbol &right) { return left + right.str(); }
+
+inline std::string operator+(const char *left, const Symbol &right) { return left + right.str(); }
+
+inline std::string operator+(const Symbol &left, const std::string &right) { return left.str() + right; }
+
+inline std::string operator+(const Symbol &left, const char *right) { return left.str() + right; }
+
+inline std::ostream &operator<<(std::ostream &stream, const Symbol &symbol) { return stream << symbol.str(); }
+
+template<>
+struct std::hash<Symbol> {
+    size_t operator()(const Symbol &symbol) const { return symbol.hash(); }
+};
+
+#endif //ACL_SYMBOL_H
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "runtime.h"
+#include <filesystem>
+#include <sstream>
+#include <pthread.h>
+#include "main.h"
+#include "utils.h"
+#include "interpreter/file.h"
+#include "parser/inference.h"
+#include "parser/optimizer.h"
+
+// A list of all parsed files.
+std::vector<std::pair<std::string, AbstractSyntaxTree *>> parsed_files;
+
+std::unordered_map<std::string, std::string> parsed_sources;
+
+// The default path to the source directory.
+std::string source_path;
+
+// Whether parsed files are optimized before they run, turned off with --no-optimize
+bool optimize_files = true;
+
+// The files of a built program by their path, and the files its imports resolved to
+static bool embedded = false;
+static std::unordered_map<std::string, std::string> embedded_sources;
+static std::vector<std::pair<std::string, std::string>> embedded_imports;
+
+static std::vector<AbstractSyntaxTree *> parse_embedded(const std::string &file_path);
+
+// Native stack reserved per allowed ACL call, the interpreter recurses for every call and expression
+const size_t NATIVE_STACK_PER_CALL = 16 * 1024;
+
+const char *RUN_OPTIONS_USAGE = "[--max-stack <calls>] [--stats] [--no-optimize] [--no-jit] [--jit-diff] "
+                                "[--jit-call-threshold <calls>] [--jit-loop-threshold <iterations>] "
+                                "[--profile-in <file>] [--profile-out <file>] [--profile <file>]";
+
+struct InterpreterRun {
+    Interpreter *interpreter;
+    size_t stackSize;
+    int status;
+};
+
+bool parseRunOption(int count, char **args, int &index, RunOptions &options) {
+    auto argument = std::string(args[index]);
+
+    if (argument == "--max-stack" && index + 1 < count) {
+        options.maxStack = std::stoul(args[++index]);
+    } else if (argument == "--stats") {
+        options.stats = true;
+    } else if (argument == "--no-optimize") {
+        options.optimize = false;
+    } else if (argument == "--jit") {
+        options.jit = jit::SUPPORTED;
+    } else if (argument == "--no-jit") {
+        options.jit = false;
+    } else if (argument == "--jit-diff") {
+        options.jitDiff = jit::SUPPORTED;
+    } else if (argument == "--jit-call-threshold" && index + 1 < count) {
+        options.callThreshold = std::max<int64_t>(std::stoll(args[++index]), 1);
+    } else if (argument == "--jit-loop-threshold" && index + 1 < count) {
+        options.loopThreshold = std::max<int64_t>(std::stoll(args[++index]), 1);
+    } else if (argument == "--profile-out" && index + 1 < count) {
+        options.profileOut = args[++index];
+    } else if (argument == "--profile-in" && index + 1 < count) {
+        options.profileIn = args[++index];
+    } else if (argument == "--profile" && index + 1 < count) {
+        options.samplesOut = args[++index];
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void printError(const std::string &message) {
+    std::cerr << getColor(Color::FG_RED) << "ERROR" << getColor(Color::RESET) << ": " << message << std::endl;
+}
+
+static void *runInterpreter(void *data) {
+    auto run = static_cast<InterpreterRun *>(data);
+    char marker;
+
+    // A bit of the stack is kept free for the error handling
+    run->interpreter->nativeStackBase = &marker;
+    run->interpreter->nativeStackSize = (long) (run->stackSize - 256 * 1024);
+
+    try {
+        // Interpret the AST
+        run->interpreter->interpret();
+        run->status = 0;
+    } catch (const std::exception &error) {
+        printError(error.what());
+        run->status = 1;
+    }
+
+    return nullptr;
+}
+
+int runProgram(AbstractSyntaxTree *code, const RunOptions &options) {
+    Interpreter interpreter(code);
+    interpreter.maxStackDepth = options.maxStack;
+
+    // Hot code is compiled unless --no-jit is given, --jit-diff checks every result of compiled code
+    // against the interpreter
+    if (options.jit || options.jitDiff)
+        interpreter.enableJit(options.jitDiff, options.callThreshold, options.loopThreshold);
+
+    if (!options.profileIn.empty() || !options.profileOut.empty()) {
+        interpreter.profile = std::make_unique<Profile>();
+        interpreter.profile->recording = !options.profileOut.empty();
+    }
+
+    // A missing profile isn't an error, the first run of a script doesn't have one
+    if (!options.profileIn.empty()) {
+        std::ifstream stream(options.profileIn);
+
+        try {
+            if (stream.is_open())
+                interpreter.profile->read(stream);
+        } catch (const std::exception &error) {
+            printError(options.profileIn + ": " + error.what());
+            return 1;
+        }
+
+        interpreter.profile->apply(code, interpreter.jit.get());
+    }
+
+    // The interpreter runs on its own thread, with a stack large enough for the maximum number of calls
+    InterpreterRun run{&interpreter, std::max<size_t>(options.maxStack * NATIVE_STACK_PER_CALL, 8 * 1024 * 1024),
+                       1};
+
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, run.stackSize);
+
+    if (!options.samplesOut.empty()) {
+        interpreter.sampler = std::make_unique<Sampler>();
+        interpreter.sampler->start();
+    }
+
+    if (pthread_create(&thread, &attributes, runInterpreter, &run) != 0) {
+        printError("Could not reserve a stack for " + std::to_string(options.maxStack) +
+                   " calls, try a lower --max-stack");
+        return 1;
+    }
+
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+
+    // The scope of the file is never destroyed, its handles are written out here, even after an error
+    try {
+        FileHandle::flushAll();
+    } catch (const std::exception &error) {
+        printError(error.what());
+        run.status = 1;
+    }
+
+    if (interpreter.sampler != nullptr) {
+        interpreter.sampler->stop();
+        interpreter.takeSamples();
+
+        std::ofstream stream(options.samplesOut);
+
+        if (!stream.is_open()) {
+            printError("Could not write the samples to " + options.samplesOut);
+            return 1;
+        }
+
+        interpreter.sampler->writeCollapsed(stream);
+        interpreter.sampler->printSummary(std::cerr);
+    }
+
+    if (!options.profileOut.empty()) {
+        std::ofstream stream(options.profileOut);
+
+        if (!stream.is_open()) {
+            printError("Could not write the profile to " + options.profileOut);
+            return 1;
+        }
+
+        interpreter.profile->write(stream);
+    }
+
+    if (options.stats)
+        interpreter.printStats(std::cerr);
+
+    return run.status;
+}
+
+int runEmbedded(int count, char **args, const EmbeddedFile *files, size_t fileCount, const EmbeddedImport *imports,
+                size_t importCount, RunOptions options) {
+    for (int i = 1; i < count; i++)
+        parseRunOption(count, args, i, options);
+
+    embedded = true;
+    optimize_files = options.optimize;
+
+    for (size_t i = 0; i < fileCount; i++)
+        embedded_sources[files[i].path] = files[i].source;
+
+    for (size_t i = 0; i < importCount; i++)
+        embedded_imports.emplace_back(imports[i].path, imports[i].file);
+
+    AbstractSyntaxTree *code;
+
+    try {
+        code = parse_file(files[0].path, true)[0];
+    } catch (const std::exception &error) {
+        printError(error.what());
+        return 1;
+    }
+
+    return runProgram(code, options);
+}
+
+std::vector<AbstractSyntaxTree *> parse_file(std::string file_path, bool is_main_file) {
+    vector<AbstractSyntaxTree *> trees;
+    if (!file_path.ends_with(".acl"))
+        file_path += ".acl";
+
+    // Checking if we already have the file parsed in out files vector
+    for (auto &file: parsed_files) {
+        if (file.first == file_path) {
+            trees.push_back(file.second);
+            return trees;
+        }
+    }
+
+    // Built programs only have the files they were built with
+    if (embedded)
+        return parse_embedded(file_path);
+
+    // Checking if it's a file from the default
+    std::string std_path_raw = std::string(getenv("HOME")) + "/.acl/std/" + file_path;
+    std::ifstream std_path(std_path_raw);
+
+
+    // We have an absolute path, because of the home directory, so we can check if it exists
+    if (std_path.good() || std_path.is_open()) {
+        std_path.close();
+        return parse_file(std_path_raw, true);
+    }
+
+    std::ifstream file((is_main_file ? "" : source_path + "/") + file_path);
+
+    if (!file.is_open()) {
+        auto splitPath = splitString(file_path, "/");
+        auto fileName = splitPath[splitPath.size() - 1];
+        if (!fileName.starts_with("*")) {
+            throw std::runtime_error("File not found: " + (is_main_file ? "" : source_path + "/") + file_path);
+        }
+        splitPath.pop_back();
+        std::string restPath;
+        for (const auto &item: splitPath)
+            restPath += item + "/";
+
+        for (const auto &entry: std::filesystem::directory_iterator(source_path + "/" + restPath)) {
+            string foundFile = entry.path();
+            trees.push_back(parse_file(foundFile, true)[0]);
+        }
+        return trees;
+    }
+
+    //   /test/test/*   /test/test/utils.acl /test/test/main.acl
+
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    file.close();
+    trees.push_back(parse_source(file_path, source));
+    return trees;
+}
+
+AbstractSyntaxTree *parse_source(const std::string &file_path, const std::string &source) {
+    std::istringstream input(source);
+    std::vector<Token> tokens = Lexer::tokenize(input);
+
+    // Parsing
+    Parser parser(tokens);
+
+    // Parse the tokens
+    auto ast = parser.parse();
+
+    // Inlining small functions and hoisting loop invariants, before the types of the results are inferred
+    if (optimize_files)
+        Optimizer().optimize(ast);
+
+    // Marking the expressions whose operand types are known
+    TypeInference().inferTypes(ast);
+
+    parsed_files.emplace_back(file_path, ast);
+    parsed_sources[file_path] = source;
+
+    return ast;
+}
+
+static std::vector<AbstractSyntaxTree *> parse_embedded(const std::string &file_path) {
+    std::vector<std::string> files;
+
+    // Imports were resolved when the program was built, the main file isn't imported
+    for (auto &[path, file]: embedded_imports)
+        if (path == file_path)
+            files.push_back(file);
+
+    if (files.empty())
+        files.push_back(file_path);
+
+    std::vector<AbstractSyntaxTree *> trees;
+
+    for (auto &file: files) {
+        auto parsed = std::find_if(parsed_files.begin(), parsed_files.end(),
+                                   [&file](auto &item) { return item.first == file; });
+
+        if (parsed != parsed_files.end()) {
+            trees.push_back(parsed->second);
+            continue;
+        }
+
+        auto source = embedded_sources.find(file);
+
+        if (source == embedded_sources.end())
+            throw std::runtime_error("File not found: " + file_path + ", it wasn't imported when the program was built");
+
+        trees.push_back(parse_source(file, source->second));
+    }
+
+    return trees;
+}
\ No newline at end of file
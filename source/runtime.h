@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021/2022 BergerAPI.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACL_RUNTIME_H
+#define ACL_RUNTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Running ACL programs, shared by the ACL command and the programs built with `ACL build`. Programs
+// built by it include this header and link the runtime library, so it doesn't include anything else.
+
+class AbstractSyntaxTree;
+
+// How a program runs, set with the flags parseRunOption knows
+struct RunOptions {
+    // Maximum number of nested calls, --max-stack
+    size_t maxStack = 10000;
+
+    // Printing statistics to stderr at the end, --stats
+    bool stats = false;
+
+    // Optimizing the files before they run, turned off with --no-optimize
+    bool optimize = true;
+
+    // Compiling hot code, turned off with --no-jit. --jit-diff compares compiled code with the interpreter.
+    bool jit = true;
+    bool jitDiff = false;
+    int64_t callThreshold = 100;
+    int64_t loopThreshold = 1000;
+
+    // Writing type feedback at the end, and starting with the feedback of an earlier run
+    std::string profileOut;
+    std::string profileIn;
+
+    // Writing sampled call stacks in the collapsed format of flamegraph tools, --profile
+    std::string samplesOut;
+};
+
+// Reading the flag at args[index] (and its value) into the options. Returns false if it isn't one.
+bool parseRunOption(int count, char **args, int &index, RunOptions &options);
+
+// The flags parseRunOption knows, for the usage line
+extern const char *RUN_OPTIONS_USAGE;
+
+void printError(const std::string &message);
+
+// Running a parsed program on a thread with a stack for the maximum number of calls, returns the exit
+// status
+int runProgram(AbstractSyntaxTree *code, const RunOptions &options);
+
+// A file built into a program, by the path it was parsed with when the program was built
+struct EmbeddedFile {
+    const char *path;
+    const char *source;
+};
+
+// The file an import of a built program resolved to when it was built. Imports of directories have
+// one entry per file.
+struct EmbeddedImport {
+    const char *path;
+    const char *file;
+};
+
+// Running a built program, its main file comes first. Imports are only looked up in the built files,
+// the arguments can change the options it was built with.
+int runEmbedded(int count, char **args, const EmbeddedFile *files, size_t fileCount, const EmbeddedImport *imports,
+                size_t importCount, RunOptions options);
+
+#endif //ACL_RUNTIME_H